@@ -0,0 +1,234 @@
+#ifndef I3D_LINE3D_ASSOCIATIONINDEX_H_
+#define I3D_LINE3D_ASSOCIATIONINDEX_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// std
+#include <string>
+#include <cstring>
+#include <stdint.h>
+
+// POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Line3D - 2D/3D Association Index
+ * ====================
+ * Binary file that links 2D segments to the
+ * 3D lines they belong to (and vice versa).
+ * Written by Line3D::save2D3DAssociationIndex(),
+ * designed to be memory-mapped by downstream
+ * tools (no parsing needed, O(1) lookups).
+ *
+ * File layout (uint32, little endian):
+ * [header]
+ * [camera table]   num_cameras x (offset,num_segments)
+ * [segment->line]  num_segments x lineID (L3D_ASSOC_NO_LINE if unused)
+ * [line offsets]   (num_lines+1) x offset into references (CSR)
+ * [references]     num_refs x (camID,segID)
+ *
+ * The camera table is indexed directly by camID,
+ * lineIDs are identical to the line numbers in the
+ * .txt result file.
+ * ====================
+ */
+
+#define L3D_ASSOC_MAGIC "L3DASSOC"
+#define L3D_ASSOC_VERSION 1
+#define L3D_ASSOC_NO_LINE 0xFFFFFFFF
+
+namespace L3D
+{
+    // file header
+    struct L3DAssocHeader
+    {
+        char magic_[8];
+        uint32_t version_;
+        uint32_t num_cameras_;
+        uint32_t num_lines_;
+        uint32_t num_segments_;
+        uint32_t num_refs_;
+        uint32_t reserved_;
+    };
+
+    // camera table entry
+    struct L3DAssocCamera
+    {
+        uint32_t offset_;
+        uint32_t num_segments_;
+    };
+
+    // 2D reference of a 3D line
+    struct L3DAssocSegmentRef
+    {
+        uint32_t camID_;
+        uint32_t segID_;
+    };
+
+    // read-only (memory mapped) access
+    class L3DAssociationIndex
+    {
+    public:
+        L3DAssociationIndex()
+        {
+            data_ = NULL;
+            size_ = 0;
+            header_ = NULL;
+            cameras_ = NULL;
+            seg2line_ = NULL;
+            line_offsets_ = NULL;
+            refs_ = NULL;
+        }
+
+        ~L3DAssociationIndex()
+        {
+            close();
+        }
+
+        // map file into memory
+        bool open(const std::string filename)
+        {
+            close();
+
+            int fd = ::open(filename.c_str(),O_RDONLY);
+            if(fd < 0)
+                return false;
+
+            struct stat st;
+            if(fstat(fd,&st) != 0 || size_t(st.st_size) < sizeof(L3DAssocHeader))
+            {
+                ::close(fd);
+                return false;
+            }
+
+            void* data = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+            ::close(fd);
+
+            if(data == MAP_FAILED)
+                return false;
+
+            data_ = (char*)data;
+            size_ = st.st_size;
+
+            // check header
+            header_ = (const L3DAssocHeader*)data_;
+            if(memcmp(header_->magic_,L3D_ASSOC_MAGIC,8) != 0 ||
+                    header_->version_ != L3D_ASSOC_VERSION)
+            {
+                close();
+                return false;
+            }
+
+            size_t expected = sizeof(L3DAssocHeader)+
+                    size_t(header_->num_cameras_)*sizeof(L3DAssocCamera)+
+                    size_t(header_->num_segments_)*sizeof(uint32_t)+
+                    size_t(header_->num_lines_+1)*sizeof(uint32_t)+
+                    size_t(header_->num_refs_)*sizeof(L3DAssocSegmentRef);
+
+            if(size_ < expected)
+            {
+                close();
+                return false;
+            }
+
+            // set pointers
+            const char* pos = data_+sizeof(L3DAssocHeader);
+            cameras_ = (const L3DAssocCamera*)pos;
+            pos += size_t(header_->num_cameras_)*sizeof(L3DAssocCamera);
+            seg2line_ = (const uint32_t*)pos;
+            pos += size_t(header_->num_segments_)*sizeof(uint32_t);
+            line_offsets_ = (const uint32_t*)pos;
+            pos += size_t(header_->num_lines_+1)*sizeof(uint32_t);
+            refs_ = (const L3DAssocSegmentRef*)pos;
+
+            return true;
+        }
+
+        // unmap
+        void close()
+        {
+            if(data_ != NULL)
+                munmap(data_,size_);
+
+            data_ = NULL;
+            size_ = 0;
+            header_ = NULL;
+            cameras_ = NULL;
+            seg2line_ = NULL;
+            line_offsets_ = NULL;
+            refs_ = NULL;
+        }
+
+        bool isOpen() const {return (data_ != NULL);}
+
+        // data access
+        unsigned int numCameras() const {return header_ ? header_->num_cameras_ : 0;}
+        unsigned int numLines() const {return header_ ? header_->num_lines_ : 0;}
+
+        unsigned int numSegments(const unsigned int camID) const
+        {
+            if(header_ == NULL || camID >= header_->num_cameras_)
+                return 0;
+
+            return cameras_[camID].num_segments_;
+        }
+
+        // 3D line for a 2D segment (L3D_ASSOC_NO_LINE if not part of the model)
+        uint32_t lineID(const unsigned int camID, const unsigned int segID) const
+        {
+            if(header_ == NULL || camID >= header_->num_cameras_ ||
+                    segID >= cameras_[camID].num_segments_)
+                return L3D_ASSOC_NO_LINE;
+
+            return seg2line_[cameras_[camID].offset_+segID];
+        }
+
+        // 2D segments of a 3D line
+        unsigned int numReferences(const unsigned int lineID) const
+        {
+            if(header_ == NULL || lineID >= header_->num_lines_)
+                return 0;
+
+            return line_offsets_[lineID+1]-line_offsets_[lineID];
+        }
+
+        const L3DAssocSegmentRef* references(const unsigned int lineID) const
+        {
+            if(header_ == NULL || lineID >= header_->num_lines_)
+                return NULL;
+
+            return refs_+line_offsets_[lineID];
+        }
+
+    private:
+        char* data_;
+        size_t size_;
+
+        const L3DAssocHeader* header_;
+        const L3DAssocCamera* cameras_;
+        const uint32_t* seg2line_;
+        const uint32_t* line_offsets_;
+        const L3DAssocSegmentRef* refs_;
+    };
+}
+
+#endif //I3D_LINE3D_ASSOCIATIONINDEX_H_
@@ -0,0 +1,640 @@
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Backend equivalence harness. Runs a synthetic scene (and optionally
+// a recorded VisualSfM dataset) through every available backend
+// (CUDA if a device is present, CPU for each given thread count),
+// compares all runs against the first one and writes a timing table.
+// Returns a non-zero exit code if any comparison exceeds its tolerance.
+
+// EXTERNAL
+#include <tclap/CmdLine.h>
+#include <tclap/CmdLineInterface.h>
+#include <boost/filesystem.hpp>
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+#include "eigen3/Eigen/Eigen"
+
+// std
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <limits>
+
+// lib
+#include "line3D.h"
+#include "synthetic.h"
+
+// input image (same format as Line3D::addImage)
+struct HarnessImage
+{
+    cv::Mat image_;
+    Eigen::Matrix3d K_;
+    Eigen::Matrix3d R_;
+    Eigen::Vector3d t_;
+    std::list<unsigned int> worldpoints_;
+};
+
+// result of a single run
+struct HarnessRun
+{
+    std::string name_;
+    L3D::L3DStatistics stats_;
+    std::map<L3D::L3DSegment2D,L3D::L3DSegment2D> corrs_;
+    std::list<L3D::L3DFinalLine3D> lines_;
+};
+
+// reads a VisualSfM file (see main_vsfm.cpp)
+bool loadNVM(const std::string nvmFile, const std::string inputFolder,
+             std::vector<HarnessImage>& images)
+{
+    std::ifstream nvm_file;
+    nvm_file.open(nvmFile.c_str());
+    if(!nvm_file.is_open())
+        return false;
+
+    std::string nvm_line;
+    std::getline(nvm_file,nvm_line); // ignore first line...
+    std::getline(nvm_file,nvm_line); // ignore second line...
+
+    // read number of images
+    std::getline(nvm_file,nvm_line);
+    std::stringstream nvm_stream(nvm_line);
+    unsigned int num_cams = 0;
+    nvm_stream >> num_cams;
+
+    if(num_cams == 0)
+        return false;
+
+    std::vector<std::string> cams_imgFilenames(num_cams);
+    std::vector<float> cams_focals(num_cams);
+    std::vector<float> cams_distortion(num_cams);
+    images.resize(num_cams);
+    for(unsigned int i=0; i<num_cams; ++i)
+    {
+        std::getline(nvm_file,nvm_line);
+
+        std::string filename;
+        double focal_length,quat0,quat1,quat2,quat3;
+        double Cx,Cy,Cz,dist;
+
+        nvm_stream.str("");
+        nvm_stream.clear();
+        nvm_stream.str(nvm_line);
+        nvm_stream >> filename >> focal_length >> quat3 >> quat0 >> quat1 >> quat2;
+        nvm_stream >> Cx >> Cy >> Cz >> dist;
+
+        cams_imgFilenames[i] = filename;
+        cams_focals[i] = focal_length;
+        cams_distortion[i] = dist;
+
+        // rotation
+        Eigen::Matrix3d R;
+        R(0,0) = 1.0-2.0*quat1*quat1-2.0*quat2*quat2;
+        R(0,1) = 2.0*quat0*quat1-2.0*quat2*quat3;
+        R(0,2) = 2.0*quat0*quat2+2.0*quat1*quat3;
+
+        R(1,0) = 2.0*quat0*quat1+2.0*quat2*quat3;
+        R(1,1) = 1.0-2.0*quat0*quat0-2.0*quat2*quat2;
+        R(1,2) = 2.0*quat1*quat2-2.0*quat0*quat3;
+
+        R(2,0) = 2.0*quat0*quat2-2.0*quat1*quat3;
+        R(2,1) = 2.0*quat1*quat2+2.0*quat0*quat3;
+        R(2,2) = 1.0-2.0*quat0*quat0-2.0*quat1*quat1;
+
+        images[i].R_ = R;
+        images[i].t_ = -R*Eigen::Vector3d(Cx,Cy,Cz);
+    }
+
+    // worldpoints
+    std::getline(nvm_file,nvm_line); // ignore line...
+    std::getline(nvm_file,nvm_line);
+    nvm_stream.str("");
+    nvm_stream.clear();
+    nvm_stream.str(nvm_line);
+    unsigned int num_points = 0;
+    nvm_stream >> num_points;
+
+    for(unsigned int i=0; i<num_points; ++i)
+    {
+        std::getline(nvm_file,nvm_line);
+        std::istringstream iss_point3D(nvm_line);
+        double px,py,pz,colR,colG,colB;
+        iss_point3D >> px >> py >> pz;
+        iss_point3D >> colR >> colG >> colB;
+
+        unsigned int num_views;
+        iss_point3D >> num_views;
+
+        unsigned int camID,siftID;
+        float posX,posY;
+        for(unsigned int j=0; j<num_views; ++j)
+        {
+            iss_point3D >> camID >> siftID;
+            iss_point3D >> posX >> posY;
+            images[camID].worldpoints_.push_back(i);
+        }
+    }
+    nvm_file.close();
+
+    // images (loaded once, shared by all runs)
+    for(unsigned int i=0; i<num_cams; ++i)
+    {
+        cv::Mat image = cv::imread(inputFolder+"/"+cams_imgFilenames[i]);
+        if(image.rows == 0 || image.cols == 0)
+            return false;
+
+        Eigen::Matrix3d K = Eigen::Matrix3d::Zero();
+        K(0,0) = cams_focals[i];
+        K(1,1) = cams_focals[i];
+        K(0,2) = float(image.cols)/2.0f;
+        K(1,2) = float(image.rows)/2.0f;
+        K(2,2) = 1.0;
+
+        // undistort (if necessary)
+        float d = cams_distortion[i];
+        if(fabs(d) > L3D_EPS)
+        {
+            cv::Mat I = cv::Mat_<double>::eye(3,3);
+            cv::Mat cvK = cv::Mat_<double>::zeros(3,3);
+            cvK.at<double>(0,0) = K(0,0);
+            cvK.at<double>(1,1) = K(1,1);
+            cvK.at<double>(0,2) = K(0,2);
+            cvK.at<double>(1,2) = K(1,2);
+            cvK.at<double>(2,2) = 1.0;
+
+            cv::Mat cvDistCoeffs(4,1,CV_64FC1,cv::Scalar(0));
+            cvDistCoeffs.at<double>(0) = -d;
+
+            cv::Mat undistort_map_x;
+            cv::Mat undistort_map_y;
+
+            cv::initUndistortRectifyMap(cvK,cvDistCoeffs,I,cvK,cv::Size(image.cols, image.rows),
+                                        undistort_map_x.type(), undistort_map_x, undistort_map_y );
+            cv::remap(image,image,undistort_map_x,undistort_map_y,cv::INTER_LINEAR,cv::BORDER_CONSTANT);
+        }
+
+        images[i].image_ = image;
+        images[i].K_ = K;
+    }
+
+    return true;
+}
+
+// runs the whole pipeline with the given backend
+void runPipeline(std::vector<HarnessImage>& images, const std::string data_directory,
+                 const int backend, const int num_threads, const int max_width,
+                 const bool diffusion, const bool deterministic, HarnessRun& run)
+{
+    L3D::Line3D* line3D = new L3D::Line3D(data_directory);
+    line3D->setComputeBackend(backend,num_threads);
+    line3D->setDeterministic(deterministic);
+
+    for(unsigned int i=0; i<images.size(); ++i)
+    {
+        line3D->addImage(i,images[i].image_,images[i].K_,images[i].R_,
+                         images[i].t_,images[i].worldpoints_,max_width,false);
+    }
+
+    line3D->compute3Dmodel(diffusion);
+
+    line3D->getResult(run.lines_);
+    line3D->getSelectedCorrespondences(run.corrs_);
+    run.stats_ = line3D->getStatistics();
+
+    delete line3D;
+    boost::filesystem::remove_all(boost::filesystem::path(data_directory));
+}
+
+// relative difference of two counts
+float relativeDiff(const unsigned int a, const unsigned int b)
+{
+    if(a == b)
+        return 0.0f;
+
+    return fabs(float(a)-float(b))/float(std::max(a,b));
+}
+
+// jaccard index of the selected correspondences
+float correspondenceJaccard(std::map<L3D::L3DSegment2D,L3D::L3DSegment2D>& A,
+                            std::map<L3D::L3DSegment2D,L3D::L3DSegment2D>& B)
+{
+    if(A.size() == 0 && B.size() == 0)
+        return 1.0f;
+
+    unsigned int common = 0;
+    std::map<L3D::L3DSegment2D,L3D::L3DSegment2D>::iterator it = A.begin();
+    for(; it!=A.end(); ++it)
+    {
+        std::map<L3D::L3DSegment2D,L3D::L3DSegment2D>::iterator f = B.find(it->first);
+        if(f != B.end() && f->second == it->second)
+            ++common;
+    }
+
+    return float(common)/float(A.size()+B.size()-common);
+}
+
+// fraction of 2D segments that are clustered like in the reference
+// (majority vote per cluster)
+float clusterPurity(std::list<L3D::L3DFinalLine3D>& reference,
+                    std::list<L3D::L3DFinalLine3D>& candidate)
+{
+    std::map<L3D::L3DSegment2D,unsigned int> ref_label;
+    unsigned int label = 0;
+    std::list<L3D::L3DFinalLine3D>::iterator it = reference.begin();
+    for(; it!=reference.end(); ++it,++label)
+    {
+        std::list<L3D::L3DSegment2D>::iterator s = it->segments2D()->begin();
+        for(; s!=it->segments2D()->end(); ++s)
+            ref_label[*s] = label;
+    }
+
+    unsigned int total = 0;
+    unsigned int pure = 0;
+    for(it=candidate.begin(); it!=candidate.end(); ++it)
+    {
+        std::map<unsigned int,unsigned int> votes;
+        unsigned int majority = 0;
+        std::list<L3D::L3DSegment2D>::iterator s = it->segments2D()->begin();
+        for(; s!=it->segments2D()->end(); ++s)
+        {
+            std::map<L3D::L3DSegment2D,unsigned int>::iterator f = ref_label.find(*s);
+            if(f != ref_label.end())
+            {
+                ++votes[f->second];
+                majority = std::max(majority,votes[f->second]);
+            }
+        }
+
+        total += it->segments2D()->size();
+        pure += majority;
+    }
+
+    if(total == 0)
+        return (reference.size() == 0) ? 1.0f : 0.0f;
+
+    return float(pure)/float(total);
+}
+
+// all 3D segments of a result
+void collectSegments3D(std::list<L3D::L3DFinalLine3D>& lines,
+                       std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> >& segs)
+{
+    std::list<L3D::L3DFinalLine3D>::iterator it = lines.begin();
+    for(; it!=lines.end(); ++it)
+    {
+        std::list<std::pair<Eigen::Vector3d,Eigen::Vector3d> >::iterator s = it->segments3D()->begin();
+        for(; s!=it->segments3D()->end(); ++s)
+            segs.push_back(*s);
+    }
+}
+
+// directed Hausdorff distance (sampled along the segments of A)
+double directedHausdorff(std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> >& A,
+                         std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> >& B)
+{
+    if(A.size() == 0)
+        return 0.0;
+    if(B.size() == 0)
+        return std::numeric_limits<double>::max();
+
+    double hd = 0.0;
+    for(unsigned int i=0; i<A.size(); ++i)
+    {
+        for(unsigned int k=0; k<=10; ++k)
+        {
+            Eigen::Vector3d P = A[i].first+double(k)/10.0*(A[i].second-A[i].first);
+
+            double min_dist = std::numeric_limits<double>::max();
+            for(unsigned int j=0; j<B.size() && min_dist > hd; ++j)
+                min_dist = std::min(min_dist,L3D::L3DSyntheticScene::distancePointSegment3D(P,B[j]));
+
+            hd = std::max(hd,min_dist);
+        }
+    }
+    return hd;
+}
+
+// symmetric Hausdorff distance between two results
+double hausdorff3D(std::list<L3D::L3DFinalLine3D>& A, std::list<L3D::L3DFinalLine3D>& B)
+{
+    std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> > segsA,segsB;
+    collectSegments3D(A,segsA);
+    collectSegments3D(B,segsB);
+
+    return std::max(directedHausdorff(segsA,segsB),
+                    directedHausdorff(segsB,segsA));
+}
+
+// bit-identical results (same lines, same order)
+bool identicalResults(std::list<L3D::L3DFinalLine3D>& A, std::list<L3D::L3DFinalLine3D>& B)
+{
+    if(A.size() != B.size())
+        return false;
+
+    std::list<L3D::L3DFinalLine3D>::iterator a = A.begin();
+    std::list<L3D::L3DFinalLine3D>::iterator b = B.begin();
+    for(; a!=A.end(); ++a,++b)
+    {
+        if(*(a->segments2D()) != *(b->segments2D()))
+            return false;
+
+        if(a->segments3D()->size() != b->segments3D()->size())
+            return false;
+
+        std::list<std::pair<Eigen::Vector3d,Eigen::Vector3d> >::iterator sa = a->segments3D()->begin();
+        std::list<std::pair<Eigen::Vector3d,Eigen::Vector3d> >::iterator sb = b->segments3D()->begin();
+        for(; sa!=a->segments3D()->end(); ++sa,++sb)
+        {
+            if(sa->first != sb->first || sa->second != sb->second)
+                return false;
+        }
+    }
+    return true;
+}
+
+// scene extent (for relative tolerances)
+double sceneDiameter(std::list<L3D::L3DFinalLine3D>& lines)
+{
+    std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> > segs;
+    collectSegments3D(lines,segs);
+    if(segs.size() == 0)
+        return 1.0;
+
+    Eigen::Vector3d bmin = segs[0].first;
+    Eigen::Vector3d bmax = segs[0].first;
+    for(unsigned int i=0; i<segs.size(); ++i)
+    {
+        bmin = bmin.cwiseMin(segs[i].first).cwiseMin(segs[i].second);
+        bmax = bmax.cwiseMax(segs[i].first).cwiseMax(segs[i].second);
+    }
+    return std::max((bmax-bmin).norm(),double(L3D_EPS));
+}
+
+// runs all backends on one dataset, returns the number of failed comparisons
+unsigned int evaluateDataset(const std::string dataset, std::vector<HarnessImage>& images,
+                             std::vector<int>& thread_counts, const std::string outputFolder,
+                             const int max_width, const bool diffusion,
+                             const float count_t, const float hausdorff_t,
+                             const bool deterministic, std::ostream& table)
+{
+    std::string prefix = "[HARNESS] ";
+    std::vector<HarnessRun> runs;
+    std::vector<HarnessRun> det_runs;
+
+    // CUDA (if available)
+    int num_devices = 0;
+    if(cudaGetDeviceCount(&num_devices) == cudaSuccess && num_devices > 0)
+    {
+        HarnessRun run;
+        run.name_ = "cuda";
+        std::cout << prefix << dataset << ": running " << run.name_ << std::endl;
+        runPipeline(images,outputFolder+"/"+dataset+"_cuda/",L3D_BACKEND_CUDA,
+                    L3D_DEF_NUM_THREADS,max_width,diffusion,false,run);
+        runs.push_back(run);
+    }
+    else
+    {
+        std::cout << prefix << "no CUDA device found, CPU backend only" << std::endl;
+    }
+
+    // CPU
+    for(unsigned int i=0; i<thread_counts.size(); ++i)
+    {
+        std::stringstream str;
+        str << "cpu_" << thread_counts[i] << "t";
+
+        HarnessRun run;
+        run.name_ = str.str();
+        std::cout << prefix << dataset << ": running " << run.name_ << std::endl;
+        runPipeline(images,outputFolder+"/"+dataset+"_"+run.name_+"/",L3D_BACKEND_CPU,
+                    thread_counts[i],max_width,diffusion,false,run);
+        runs.push_back(run);
+
+        if(deterministic)
+        {
+            HarnessRun det;
+            det.name_ = run.name_+"_det";
+            std::cout << prefix << dataset << ": running " << det.name_ << std::endl;
+            runPipeline(images,outputFolder+"/"+dataset+"_"+det.name_+"/",L3D_BACKEND_CPU,
+                        thread_counts[i],max_width,diffusion,true,det);
+            det_runs.push_back(det);
+        }
+    }
+
+    if(runs.size() == 0)
+        return 0;
+
+    // timing table
+    table << dataset << std::endl;
+    table << std::setw(12) << std::left << "backend";
+    table << std::setw(12) << std::right << "detection" << std::setw(12) << "neighbors";
+    table << std::setw(12) << "matching" << std::setw(12) << "selection";
+    table << std::setw(12) << "clustering" << std::setw(12) << "total";
+    table << std::setw(10) << "matches" << std::setw(8) << "lines" << std::endl;
+    for(unsigned int i=0; i<runs.size(); ++i)
+    {
+        L3D::L3DStatistics& s = runs[i].stats_;
+        table << std::setw(12) << std::left << runs[i].name_ << std::right;
+        table << std::fixed << std::setprecision(1);
+        table << std::setw(12) << s.time_detection_ << std::setw(12) << s.time_neighbors_;
+        table << std::setw(12) << s.time_matching_ << std::setw(12) << s.time_selection_;
+        table << std::setw(12) << s.time_clustering_ << std::setw(12) << s.time_total_;
+        table << std::setw(10) << s.num_matches_ << std::setw(8) << s.num_lines_ << std::endl;
+    }
+    for(unsigned int i=0; i<det_runs.size(); ++i)
+    {
+        L3D::L3DStatistics& s = det_runs[i].stats_;
+        table << std::setw(12) << std::left << det_runs[i].name_ << std::right;
+        table << std::fixed << std::setprecision(1);
+        table << std::setw(12) << s.time_detection_ << std::setw(12) << s.time_neighbors_;
+        table << std::setw(12) << s.time_matching_ << std::setw(12) << s.time_selection_;
+        table << std::setw(12) << s.time_clustering_ << std::setw(12) << s.time_total_;
+        table << std::setw(10) << s.num_matches_ << std::setw(8) << s.num_lines_ << std::endl;
+    }
+
+    // throughput cost of the deterministic mode (matching+selection+clustering)
+    for(unsigned int i=0; i<det_runs.size(); ++i)
+    {
+        L3D::L3DStatistics& s = runs[runs.size()-det_runs.size()+i].stats_;
+        L3D::L3DStatistics& d = det_runs[i].stats_;
+        double t = s.time_matching_+s.time_selection_+s.time_clustering_;
+        double t_det = d.time_matching_+d.time_selection_+d.time_clustering_;
+        table << "deterministic cost (" << det_runs[i].name_ << "): ";
+        table << std::setprecision(3) << ((t > 0.0) ? t_det/t : 1.0) << "x" << std::endl;
+    }
+    table << std::endl;
+
+    // compare against reference (first run)
+    HarnessRun& ref = runs[0];
+    double diameter = sceneDiameter(ref.lines_);
+    unsigned int failed = 0;
+    for(unsigned int i=1; i<runs.size(); ++i)
+    {
+        HarnessRun& run = runs[i];
+
+        float d_raw = relativeDiff(ref.stats_.num_raw_matches_,run.stats_.num_raw_matches_);
+        float d_matches = relativeDiff(ref.stats_.num_matches_,run.stats_.num_matches_);
+        float d_clusters = relativeDiff(ref.stats_.num_clusters_,run.stats_.num_clusters_);
+        float jaccard = correspondenceJaccard(ref.corrs_,run.corrs_);
+        float purity = clusterPurity(ref.lines_,run.lines_);
+        double hd = hausdorff3D(ref.lines_,run.lines_)/diameter;
+
+        bool ok = (d_raw <= count_t && d_matches <= count_t && d_clusters <= count_t &&
+                   jaccard >= 1.0f-count_t && purity >= 1.0f-count_t && hd <= hausdorff_t);
+
+        std::cout << prefix << dataset << ": " << run.name_ << " vs. " << ref.name_ << std::endl;
+        std::cout << prefix << "  raw matches:     " << ref.stats_.num_raw_matches_ << " / " << run.stats_.num_raw_matches_ << std::endl;
+        std::cout << prefix << "  matches:         " << ref.stats_.num_matches_ << " / " << run.stats_.num_matches_ << std::endl;
+        std::cout << prefix << "  correspondences: jaccard=" << jaccard << std::endl;
+        std::cout << prefix << "  clusters:        " << ref.stats_.num_clusters_ << " / " << run.stats_.num_clusters_ << ", purity=" << purity << std::endl;
+        std::cout << prefix << "  lines:           hausdorff=" << hd << " (relative)" << std::endl;
+        std::cout << prefix << "  --> " << (ok ? "OK" : "FAILED") << std::endl;
+
+        if(!ok)
+            ++failed;
+    }
+
+    // deterministic mode: bit-identical for all thread counts
+    for(unsigned int i=1; i<det_runs.size(); ++i)
+    {
+        bool ok = identicalResults(det_runs[0].lines_,det_runs[i].lines_);
+
+        std::cout << prefix << dataset << ": " << det_runs[i].name_ << " vs. " << det_runs[0].name_;
+        std::cout << " (bit-identical) --> " << (ok ? "OK" : "FAILED") << std::endl;
+
+        if(!ok)
+            ++failed;
+    }
+
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    TCLAP::CmdLine cmd("LINE3D_BENCH_BACKENDS");
+
+    TCLAP::ValueArg<int> viewsArg("n", "num_views", "number of synthetic views", false, 12, "int");
+    cmd.add(viewsArg);
+
+    TCLAP::ValueArg<int> boxesArg("b", "num_boxes", "number of synthetic boxes", false, 6, "int");
+    cmd.add(boxesArg);
+
+    TCLAP::ValueArg<int> widthArg("w", "image_width", "synthetic image width (height = 3/4 width)", false, 1280, "int");
+    cmd.add(widthArg);
+
+    TCLAP::ValueArg<std::string> nvmArg("m", "nvm_file", "optional recorded dataset (VisualSfM .nvm)", false, "", "string");
+    cmd.add(nvmArg);
+
+    TCLAP::ValueArg<std::string> imgArg("i", "input_folder", "image folder of the recorded dataset", false, ".", "string");
+    cmd.add(imgArg);
+
+    TCLAP::ValueArg<std::string> threadsArg("t", "threads", "comma separated CPU thread counts", false, "1,2,4", "string");
+    cmd.add(threadsArg);
+
+    TCLAP::ValueArg<std::string> outputArg("o", "output_folder", "folder for temporary data and the timing table", false, "./L3D_harness/", "string");
+    cmd.add(outputArg);
+
+    TCLAP::ValueArg<bool> diffusionArg("d", "diffusion", "perform Replicator Dynamics Diffusion before clustering", false, L3D_DEF_PERFORM_RDD, "bool");
+    cmd.add(diffusionArg);
+
+    TCLAP::ValueArg<float> hausdorffArg("x", "hausdorff_tolerance", "max Hausdorff distance between 3D results (relative to scene diameter)", false, 0.01f, "float");
+    cmd.add(hausdorffArg);
+
+    TCLAP::ValueArg<float> countArg("c", "count_tolerance", "max relative deviation of counts (1-min jaccard/purity)", false, 0.01f, "float");
+    cmd.add(countArg);
+
+    TCLAP::ValueArg<int> seedArg("s", "seed", "random seed (synthetic scene)", false, 42, "int");
+    cmd.add(seedArg);
+
+    TCLAP::ValueArg<bool> deterministicArg("r", "deterministic", "also run the deterministic mode (bit-identical results, throughput cost)", false, true, "bool");
+    cmd.add(deterministicArg);
+
+    // read arguments
+    cmd.parse(argc,argv);
+    std::string outputFolder = outputArg.getValue();
+    bool diffusion = diffusionArg.getValue();
+    float hausdorff_t = fabs(hausdorffArg.getValue());
+    float count_t = fabs(countArg.getValue());
+    bool deterministic = deterministicArg.getValue();
+    unsigned int width = std::max(widthArg.getValue(),64);
+
+    std::vector<int> thread_counts;
+    std::stringstream tstr(threadsArg.getValue());
+    std::string token;
+    while(std::getline(tstr,token,','))
+    {
+        int t = atoi(token.c_str());
+        if(t > 0)
+            thread_counts.push_back(t);
+    }
+
+    boost::filesystem::create_directory(boost::filesystem::path(outputFolder));
+    std::stringstream table;
+    unsigned int failed = 0;
+
+    // synthetic scene
+    L3D::L3DSyntheticScene scene(std::max(viewsArg.getValue(),2),
+                                 std::max(boxesArg.getValue(),1),
+                                 width,width*3/4,seedArg.getValue());
+
+    std::vector<HarnessImage> synthetic(scene.views()->size());
+    for(unsigned int i=0; i<scene.views()->size(); ++i)
+    {
+        L3D::L3DSyntheticView& v = scene.views()->at(i);
+        synthetic[i].image_ = v.image_;
+        synthetic[i].K_ = v.K_;
+        synthetic[i].R_ = v.R_;
+        synthetic[i].t_ = v.t_;
+        synthetic[i].worldpoints_ = v.worldpoints_;
+    }
+
+    failed += evaluateDataset("synthetic",synthetic,thread_counts,outputFolder,
+                              width,diffusion,count_t,hausdorff_t,deterministic,table);
+
+    // recorded dataset
+    if(nvmArg.getValue().length() > 0)
+    {
+        std::vector<HarnessImage> recorded;
+        if(loadNVM(nvmArg.getValue(),imgArg.getValue(),recorded))
+        {
+            failed += evaluateDataset("recorded",recorded,thread_counts,outputFolder,
+                                      L3D_DEF_MAX_IMG_WIDTH,diffusion,count_t,hausdorff_t,
+                                      deterministic,table);
+        }
+        else
+        {
+            std::cerr << "[HARNESS] could not load " << nvmArg.getValue() << std::endl;
+            ++failed;
+        }
+    }
+
+    // timing table [ms]
+    std::ofstream file;
+    file.open((outputFolder+"/timings.txt").c_str());
+    file << table.str();
+    file.close();
+
+    std::cout << std::endl << table.str();
+    std::cout << "[HARNESS] " << (failed == 0 ? "all backends equivalent" : "backends differ!") << std::endl;
+
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,296 @@
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Clustering benchmark. Compares the graph clustering (performClustering)
+// with the label propagation (performLabelPropagation):
+// 1) on synthetic affinity graphs with planted clusters (sizes similar to
+//    clustered 2D segments, plus weak noise edges between them), reporting
+//    the time and the pairwise precision/recall w.r.t. the planted clusters,
+// 2) on a synthetic scene (synthetic.h) through the whole pipeline, with and
+//    without the top-k sparsification of the affinities, reporting the
+//    clustering time, the number of 3D lines and their recall.
+
+// EXTERNAL
+#include <tclap/CmdLine.h>
+#include <tclap/CmdLineInterface.h>
+#include <boost/filesystem.hpp>
+#include <opencv/cv.h>
+#include "eigen3/Eigen/Eigen"
+
+// std
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <cstdlib>
+
+// lib
+#include "line3D.h"
+#include "clustering.h"
+#include "synthetic.h"
+#include "timer.h"
+
+// planted partition: clusters of 2-30 nodes, ~degree intra-cluster
+// edges per node (weights 0.5-1) and a fraction of noise edges (0.25-0.5)
+void createGraph(const unsigned int num_nodes, const unsigned int degree,
+                 const float noise, unsigned int seed,
+                 std::list<L3D::CLEdge>& edges, std::vector<int>& truth)
+{
+    edges.clear();
+    truth.assign(num_nodes,0);
+
+    std::vector<std::pair<unsigned int,unsigned int> > clusters;
+    unsigned int start = 0;
+    while(start < num_nodes)
+    {
+        unsigned int size = std::min(num_nodes-start,(unsigned int)(L3D::L3DSyntheticScene::uniform(seed,2.0,30.0)));
+        for(unsigned int i=start; i<start+size; ++i)
+            truth[i] = clusters.size();
+
+        clusters.push_back(std::pair<unsigned int,unsigned int>(start,size));
+        start += size;
+    }
+
+    for(unsigned int c=0; c<clusters.size(); ++c)
+    {
+        unsigned int first = clusters[c].first;
+        unsigned int size = clusters[c].second;
+        float p = std::min(1.0f,float(degree)/float(size-1));
+
+        for(unsigned int i=first; i<first+size; ++i)
+        {
+            for(unsigned int j=i+1; j<first+size; ++j)
+            {
+                if(L3D::L3DSyntheticScene::uniform(seed,0.0,1.0) > p)
+                    continue;
+
+                L3D::CLEdge e;
+                e.i_ = i;
+                e.j_ = j;
+                e.w_ = L3D::L3DSyntheticScene::uniform(seed,0.5,1.0);
+                edges.push_back(e);
+                std::swap(e.i_,e.j_);
+                edges.push_back(e);
+            }
+
+            if(L3D::L3DSyntheticScene::uniform(seed,0.0,1.0) < noise)
+            {
+                L3D::CLEdge e;
+                e.i_ = i;
+                e.j_ = std::min(num_nodes-1,(unsigned int)(L3D::L3DSyntheticScene::uniform(seed,0.0,double(num_nodes))));
+                e.w_ = L3D::L3DSyntheticScene::uniform(seed,L3D_MIN_AFFINITY,0.5);
+                if(truth[e.i_] != truth[e.j_])
+                {
+                    edges.push_back(e);
+                    std::swap(e.i_,e.j_);
+                    edges.push_back(e);
+                }
+            }
+        }
+    }
+}
+
+// pairwise precision and recall of a clustering w.r.t. the planted clusters
+void pairwiseScores(L3D::CLUniverse* U, std::vector<int>& truth,
+                    double& precision, double& recall, unsigned int& num_clusters)
+{
+    std::map<std::pair<int,int>,double> joint;
+    std::map<int,double> predicted;
+    std::map<int,double> planted;
+    for(unsigned int i=0; i<truth.size(); ++i)
+    {
+        int c = U->find(i);
+        joint[std::pair<int,int>(c,truth[i])] += 1.0;
+        predicted[c] += 1.0;
+        planted[truth[i]] += 1.0;
+    }
+
+    double tp = 0.0;
+    std::map<std::pair<int,int>,double>::iterator jit = joint.begin();
+    for(; jit!=joint.end(); ++jit)
+        tp += 0.5*jit->second*(jit->second-1.0);
+
+    double pred_pairs = 0.0;
+    std::map<int,double>::iterator it = predicted.begin();
+    for(; it!=predicted.end(); ++it)
+        pred_pairs += 0.5*it->second*(it->second-1.0);
+
+    double true_pairs = 0.0;
+    for(it=planted.begin(); it!=planted.end(); ++it)
+        true_pairs += 0.5*it->second*(it->second-1.0);
+
+    precision = (pred_pairs > 0.0) ? tp/pred_pairs : 1.0;
+    recall = (true_pairs > 0.0) ? tp/true_pairs : 1.0;
+    num_clusters = predicted.size();
+}
+
+int main(int argc, char *argv[])
+{
+    TCLAP::CmdLine cmd("LINE3D_BENCH_CLUSTERING");
+
+    TCLAP::ValueArg<std::string> nodesArg("n", "num_nodes", "comma separated graph sizes (planted clusters)", false, "100000,1000000", "string");
+    cmd.add(nodesArg);
+
+    TCLAP::ValueArg<int> degreeArg("k", "degree", "avg. number of intra-cluster edges per node", false, 8, "int");
+    cmd.add(degreeArg);
+
+    TCLAP::ValueArg<float> noiseArg("e", "noise", "noise edges per node", false, 0.05f, "float");
+    cmd.add(noiseArg);
+
+    TCLAP::ValueArg<std::string> threadsArg("t", "threads", "comma separated thread counts (label propagation)", false, "1,4", "string");
+    cmd.add(threadsArg);
+
+    TCLAP::ValueArg<std::string> topkArg("a", "affinity_top_k", "comma separated top-k sparsifications (scene, 0: all affinities)", false, "0,4,8,16", "string");
+    cmd.add(topkArg);
+
+    TCLAP::ValueArg<int> viewsArg("v", "num_views", "number of synthetic views (0: no scene)", false, 16, "int");
+    cmd.add(viewsArg);
+
+    TCLAP::ValueArg<float> toleranceArg("x", "tolerance", "max distance of a recalled line (world space)", false, 0.1f, "float");
+    cmd.add(toleranceArg);
+
+    TCLAP::ValueArg<std::string> outputArg("o", "output_folder", "folder for temporary data and the result table", false, "./L3D_clustering/", "string");
+    cmd.add(outputArg);
+
+    TCLAP::ValueArg<int> seedArg("s", "seed", "random seed", false, 42, "int");
+    cmd.add(seedArg);
+
+    // read arguments
+    cmd.parse(argc,argv);
+    std::string outputFolder = outputArg.getValue();
+
+    std::vector<unsigned int> sizes;
+    std::stringstream nstr(nodesArg.getValue());
+    std::string token;
+    while(std::getline(nstr,token,','))
+        sizes.push_back(std::max(atoi(token.c_str()),2));
+
+    std::vector<int> threads;
+    std::stringstream tstr(threadsArg.getValue());
+    while(std::getline(tstr,token,','))
+        threads.push_back(std::max(atoi(token.c_str()),1));
+
+    std::vector<int> top_k;
+    std::stringstream kstr(topkArg.getValue());
+    while(std::getline(kstr,token,','))
+        top_k.push_back(std::max(atoi(token.c_str()),0));
+
+    boost::filesystem::create_directory(boost::filesystem::path(outputFolder));
+    std::stringstream table;
+    table << std::fixed;
+
+    // 1) planted clusters
+    table << std::setw(10) << "nodes" << std::setw(12) << "edges" << std::setw(8) << "  engine";
+    table << std::setw(8) << "threads" << std::setw(12) << "time" << std::setw(6) << "iter";
+    table << std::setw(10) << "clusters" << std::setw(10) << "planted";
+    table << std::setw(11) << "precision" << std::setw(10) << "recall" << std::endl;
+
+    for(unsigned int n=0; n<sizes.size(); ++n)
+    {
+        std::list<L3D::CLEdge> edges;
+        std::vector<int> truth;
+        createGraph(sizes[n],std::max(degreeArg.getValue(),1),fabs(noiseArg.getValue()),
+                    seedArg.getValue(),edges,truth);
+        unsigned int planted = truth.back()+1;
+
+        for(int r=-1; r<int(threads.size()); ++r)
+        {
+            L3D::L3DTimer timer;
+            L3D::CLUniverse* U;
+            unsigned int iterations = 0;
+            if(r < 0)
+                U = L3D::performClustering(edges,sizes[n],1.0f);
+            else
+                U = L3D::performLabelPropagation(edges,sizes[n],threads[r],
+                                                 L3D_DEF_LP_MAX_ITERATIONS,false,&iterations);
+            double t = timer.elapsedMS();
+
+            double precision = 0.0, recall = 0.0;
+            unsigned int clusters = 0;
+            if(U != NULL)
+                pairwiseScores(U,truth,precision,recall,clusters);
+            delete U;
+
+            table << std::setw(10) << sizes[n] << std::setw(12) << edges.size();
+            table << std::setw(8) << ((r < 0) ? "graph" : "lp");
+            table << std::setw(8) << ((r < 0) ? 1 : threads[r]);
+            table << std::setprecision(1) << std::setw(12) << t << std::setw(6) << iterations;
+            table << std::setw(10) << clusters << std::setw(10) << planted;
+            table << std::setprecision(3) << std::setw(11) << precision << std::setw(10) << recall << std::endl;
+        }
+    }
+
+    // 2) synthetic scene
+    if(viewsArg.getValue() > 1)
+    {
+        table << std::endl << std::setw(8) << "engine" << std::setw(6) << "top_k";
+        table << std::setw(12) << "affinities" << std::setw(12) << "clustering";
+        table << std::setw(12) << "total" << std::setw(10) << "clusters";
+        table << std::setw(8) << "lines" << std::setw(10) << "recall" << std::endl;
+
+        unsigned int width = 1280;
+        L3D::L3DSyntheticScene scene(viewsArg.getValue(),6,width,width*3/4,seedArg.getValue());
+
+        for(unsigned int r=0; r<2*top_k.size(); ++r)
+        {
+            int engine = (r%2 == 0) ? L3D_CLUSTERING_GRAPH : L3D_CLUSTERING_LABEL_PROPAGATION;
+            int k = top_k[r/2];
+            std::string name = (engine == L3D_CLUSTERING_GRAPH) ? "graph" : "lp";
+            std::cout << "[CLUSTERING] running " << name << ", top_k: " << k << std::endl;
+            std::string data_directory = outputFolder+"/"+name+"/";
+
+            L3D::Line3D* line3D = new L3D::Line3D(data_directory);
+            line3D->setComputeBackend(L3D_BACKEND_CPU);
+            line3D->setClusteringEngine(engine);
+            line3D->setAffinityTopK(k);
+
+            for(unsigned int i=0; i<scene.views()->size(); ++i)
+            {
+                L3D::L3DSyntheticView& v = scene.views()->at(i);
+                line3D->addImage(i,v.image_,v.K_,v.R_,v.t_,v.worldpoints_,width,false);
+            }
+
+            line3D->compute3Dmodel();
+
+            std::list<L3D::L3DFinalLine3D> lines;
+            line3D->getResult(lines);
+            L3D::L3DStatistics s = line3D->getStatistics();
+            float recall = L3D::L3DSyntheticScene::lineRecall(*scene.lines(),lines,fabs(toleranceArg.getValue()));
+
+            table << std::setw(8) << name << std::setw(6) << k;
+            table << std::setw(12) << s.num_affinities_kept_ << std::setprecision(1);
+            table << std::setw(12) << s.time_partitioning_ << std::setw(12) << s.time_total_;
+            table << std::setw(10) << s.num_clusters_ << std::setw(8) << s.num_lines_;
+            table << std::setprecision(3) << std::setw(10) << recall << std::endl;
+
+            delete line3D;
+            boost::filesystem::remove_all(boost::filesystem::path(data_directory));
+        }
+    }
+
+    // result table [ms]
+    std::ofstream file;
+    file.open((outputFolder+"/clustering.txt").c_str());
+    file << table.str();
+    file.close();
+
+    std::cout << std::endl << table.str();
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Micro benchmark for the geometric core functions (geometry.h).
+// Built once per instruction set (scalar, SSE, AVX2, AVX-512),
+// measures the time per call on random two-view geometry.
+
+// EXTERNAL
+#include <tclap/CmdLine.h>
+#include <tclap/CmdLineInterface.h>
+#include "eigen3/Eigen/Eigen"
+
+// std
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+
+// lib
+#include "geometry.h"
+#include "timer.h"
+
+#if defined(L3D_BENCH_SCALAR)
+    #define L3D_BENCH_ISA "scalar"
+#elif defined(__AVX512F__)
+    #define L3D_BENCH_ISA "avx512"
+#elif defined(__AVX2__)
+    #define L3D_BENCH_ISA "avx2"
+#elif defined(__SSE4_2__)
+    #define L3D_BENCH_ISA "sse4.2"
+#else
+    #define L3D_BENCH_ISA "default"
+#endif
+
+// random number in [a,b]
+float uniform(const float a, const float b)
+{
+    return a+(b-a)*float(rand())/float(RAND_MAX);
+}
+
+// camera in bench format
+struct BenchCamera
+{
+    Eigen::Matrix3d K_;
+    Eigen::Matrix3d R_;
+    Eigen::Vector3d t_;
+    Eigen::Vector3d C_;
+
+    float P_[12];
+    float RtKinv_[9];
+    float3 center_;
+};
+
+void initCamera(BenchCamera& cam, const Eigen::Matrix3d& K,
+                const Eigen::Matrix3d& R, const Eigen::Vector3d& C)
+{
+    cam.K_ = K;
+    cam.R_ = R;
+    cam.C_ = C;
+    cam.t_ = -R*C;
+
+    Eigen::Matrix<double,3,4> Rt;
+    Rt.block<3,3>(0,0) = R;
+    Rt.block<3,1>(0,3) = cam.t_;
+    Eigen::Matrix<double,3,4> P = K*Rt;
+    Eigen::Matrix3d RtKinv = R.transpose()*K.inverse();
+
+    for(int r=0; r<3; ++r)
+    {
+        for(int c=0; c<4; ++c)
+            cam.P_[r*4+c] = P(r,c);
+
+        for(int c=0; c<3; ++c)
+            cam.RtKinv_[r*3+c] = RtKinv(r,c);
+    }
+
+    cam.center_ = make_float3(C.x(),C.y(),C.z());
+}
+
+// projection with pixel noise
+float3 project(const BenchCamera& cam, const Eigen::Vector3d& X, const float noise)
+{
+    Eigen::Vector3d p = cam.K_*(cam.R_*X+cam.t_);
+    return make_float3(p.x()/p.z()+uniform(-noise,noise),
+                       p.y()/p.z()+uniform(-noise,noise),1.0f);
+}
+
+int main(int argc, char *argv[])
+{
+    TCLAP::CmdLine cmd("LINE3D_BENCH_GEOMETRY");
+
+    TCLAP::ValueArg<int> samplesArg("n", "num_samples", "number of random segment pairs", false, 65536, "int");
+    cmd.add(samplesArg);
+
+    TCLAP::ValueArg<int> repArg("r", "repetitions", "number of passes over the samples", false, 20, "int");
+    cmd.add(repArg);
+
+    TCLAP::ValueArg<float> noiseArg("e", "pixel_noise", "noise added to the projections [px]", false, 1.0f, "float");
+    cmd.add(noiseArg);
+
+    TCLAP::ValueArg<int> seedArg("s", "seed", "random seed", false, 42, "int");
+    cmd.add(seedArg);
+
+    // read arguments
+    cmd.parse(argc,argv);
+    unsigned int N = std::max(samplesArg.getValue(),1);
+    unsigned int R = std::max(repArg.getValue(),1);
+    float noise = fabs(noiseArg.getValue());
+    srand(seedArg.getValue());
+
+    // two cameras (1920x1080, f=1500, small rotation, baseline 1)
+    Eigen::Matrix3d K = Eigen::Matrix3d::Identity();
+    K(0,0) = 1500.0; K(1,1) = 1500.0;
+    K(0,2) = 960.0; K(1,2) = 540.0;
+
+    BenchCamera cam1,cam2;
+    initCamera(cam1,K,Eigen::Matrix3d::Identity(),Eigen::Vector3d(0,0,0));
+    Eigen::Matrix3d R2(Eigen::AngleAxisd(-0.08,Eigen::Vector3d::UnitY()));
+    initCamera(cam2,K,R2,Eigen::Vector3d(1.0,0.05,0.0));
+
+    // fundamental matrix (x2^T F x1 = 0)
+    Eigen::Matrix3d R_rel = cam2.R_*cam1.R_.transpose();
+    Eigen::Vector3d t_rel = cam2.t_-R_rel*cam1.t_;
+    Eigen::Matrix3d tx;
+    tx << 0,-t_rel.z(),t_rel.y(),
+          t_rel.z(),0,-t_rel.x(),
+          -t_rel.y(),t_rel.x(),0;
+    Eigen::Matrix3d F = cam2.K_.inverse().transpose()*tx*R_rel*cam1.K_.inverse();
+    F /= F.norm();
+
+    // F maps points of the tgt view to lines in the src view
+    float F_tgt2src[9];
+    for(int r=0; r<3; ++r)
+        for(int c=0; c<3; ++c)
+            F_tgt2src[r*3+c] = F(c,r);
+
+    // random 3D segments in front of both cameras
+    std::vector<float3> p1(N),p2(N),q1(N),q2(N);
+    std::vector<float3> P1(N),P2(N),Q1(N),Q2(N);
+    for(unsigned int i=0; i<N; ++i)
+    {
+        Eigen::Vector3d X1(uniform(-4.0f,4.0f),uniform(-2.5f,2.5f),uniform(5.0f,20.0f));
+        Eigen::Vector3d dir(uniform(-1.0f,1.0f),uniform(-1.0f,1.0f),uniform(-1.0f,1.0f));
+        Eigen::Vector3d X2 = X1+dir.normalized()*uniform(0.2f,2.0f);
+
+        p1[i] = project(cam1,X1,noise);
+        p2[i] = project(cam1,X2,noise);
+        q1[i] = project(cam2,X1,noise);
+        q2[i] = project(cam2,X2,noise);
+
+        P1[i] = make_float3(X1.x(),X1.y(),X1.z());
+        P2[i] = make_float3(X2.x(),X2.y(),X2.z());
+        Q1[i] = make_float3(X1.x()+uniform(-0.01f,0.01f),X1.y(),X1.z());
+        Q2[i] = make_float3(X2.x(),X2.y()+uniform(-0.01f,0.01f),X2.z());
+    }
+
+    // precompute epipolar intersections (input for overlap/triangulation)
+    std::vector<float3> l2_p1(N),l1_q1(N),l1_q2(N);
+    for(unsigned int i=0; i<N; ++i)
+    {
+        float3 line1 = cross(p1[i],p2[i]);
+        float3 line2 = cross(q1[i],q2[i]);
+        l2_p1[i] = L3D::HD_normalize_hom_coords_2D(cross(line2,L3D::HD_epipolar_line(p1[i],F_tgt2src,true)));
+        l1_q1[i] = L3D::HD_normalize_hom_coords_2D(cross(line1,L3D::HD_epipolar_line(q1[i],F_tgt2src,false)));
+        l1_q2[i] = L3D::HD_normalize_hom_coords_2D(cross(line1,L3D::HD_epipolar_line(q2[i],F_tgt2src,false)));
+    }
+
+    std::cout << "[L3D_BENCH] isa: " << L3D_BENCH_ISA << ", samples: " << N;
+    std::cout << ", repetitions: " << R << std::endl;
+    std::cout << std::setw(28) << std::left << "function" << std::setw(12) << std::right << "ns/call" << std::endl;
+
+    volatile float sink = 0.0f;
+    float acc;
+    L3D::L3DTimer timer;
+
+    // epipolar line
+    acc = 0.0f;
+    timer.start();
+    for(unsigned int r=0; r<R; ++r)
+        for(unsigned int i=0; i<N; ++i)
+            acc += L3D::HD_epipolar_line(p1[i],F_tgt2src,(i&1)).z;
+    sink += acc;
+    std::cout << std::setw(28) << std::left << "epipolar_line" << std::setw(12) << std::right;
+    std::cout << std::fixed << std::setprecision(2) << timer.elapsedNS()/double(N*R) << std::endl;
+
+    // segment overlap
+    acc = 0.0f;
+    timer.start();
+    for(unsigned int r=0; r<R; ++r)
+        for(unsigned int i=0; i<N; ++i)
+            acc += L3D::HD_segment_overlap_2D(p1[i],p2[i],l1_q1[i],l1_q2[i]);
+    sink += acc;
+    std::cout << std::setw(28) << std::left << "segment_overlap_2D" << std::setw(12) << std::right;
+    std::cout << timer.elapsedNS()/double(N*R) << std::endl;
+
+    // triangulation
+    acc = 0.0f;
+    timer.start();
+    for(unsigned int r=0; r<R; ++r)
+        for(unsigned int i=0; i<N; ++i)
+            acc += L3D::HD_get_triangulation_depth(p1[i],l2_p1[i],cam1.center_,cam2.center_,
+                                                   cam1.RtKinv_,3,cam2.RtKinv_,3,true);
+    sink += acc;
+    std::cout << std::setw(28) << std::left << "get_triangulation_depth" << std::setw(12) << std::right;
+    std::cout << timer.elapsedNS()/double(N*R) << std::endl;
+
+    // projection
+    acc = 0.0f;
+    timer.start();
+    for(unsigned int r=0; r<R; ++r)
+        for(unsigned int i=0; i<N; ++i)
+            acc += L3D::HD_project_point(P1[i],cam2.P_,4).x;
+    sink += acc;
+    std::cout << std::setw(28) << std::left << "project_point" << std::setw(12) << std::right;
+    std::cout << timer.elapsedNS()/double(N*R) << std::endl;
+
+    // hypothesis confidence
+    acc = 0.0f;
+    timer.start();
+    for(unsigned int r=0; r<R; ++r)
+        for(unsigned int i=0; i<N; ++i)
+            acc += L3D::HD_hypothesis_confidence(q1[i],q2[i],q1[(i+1)%N],q2[(i+1)%N],
+                                                 P1[i],P2[i],Q1[i],Q2[i],cam1.center_,
+                                                 2.5f,10.0f,(i&1) ? 0.05f : 0.0f);
+    sink += acc;
+    std::cout << std::setw(28) << std::left << "hypothesis_confidence" << std::setw(12) << std::right;
+    std::cout << timer.elapsedNS()/double(N*R) << std::endl;
+
+    std::cout << "[L3D_BENCH] checksum: " << sink << std::endl;
+    return 0;
+}
@@ -0,0 +1,355 @@
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// High segment count benchmark. Projects random 3D lines into the views
+// of a synthetic high resolution camera rig (100MP by default) and runs
+// the collinearity and the CPU matching for increasing numbers of
+// segments per image: indexed (sparse collinearity, epipolar index) and,
+// up to a given size, brute force for comparison. Optionally the indexed
+// matching is repeated in the NUMA aware mode (multi-socket machines).
+
+// EXTERNAL
+#include <tclap/CmdLine.h>
+#include <tclap/CmdLineInterface.h>
+#include "eigen3/Eigen/Eigen"
+
+// std
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+// lib
+#include "commons.h"
+#include "cpuwrapper.h"
+#include "cudawrapper.h"
+#include "l3dnuma.h"
+#include "synthetic.h"
+#include "timer.h"
+
+// synthetic camera (x = K*(R*X+t))
+struct BenchCamera
+{
+    Eigen::Matrix3d K_;
+    Eigen::Matrix3d R_;
+    Eigen::Vector3d t_;
+    Eigen::Vector3d C_;
+};
+
+// cameras on a line (aerial strip), looking down
+std::vector<BenchCamera> createRig(const unsigned int num_cams, const unsigned int width,
+                                   const unsigned int height)
+{
+    std::vector<BenchCamera> cams(num_cams);
+    for(unsigned int i=0; i<num_cams; ++i)
+    {
+        BenchCamera& c = cams[i];
+        c.K_ << width, 0.0, 0.5*width,
+                0.0, width, 0.5*height,
+                0.0, 0.0, 1.0;
+
+        // looking down (-z)
+        c.R_ << 1.0, 0.0, 0.0,
+                0.0, -1.0, 0.0,
+                0.0, 0.0, -1.0;
+
+        c.C_ = Eigen::Vector3d(double(i)*10.0,0.0,100.0);
+        c.t_ = -c.R_*c.C_;
+    }
+    return cams;
+}
+
+// projects random 3D lines (ground area below the rig), keeps those
+// which are completely visible in all views
+unsigned int createSegments(std::vector<BenchCamera>& cams, const unsigned int num_lines,
+                            const unsigned int width, const unsigned int height,
+                            unsigned int seed, std::vector<std::vector<float4> >& segments)
+{
+    segments.assign(cams.size(),std::vector<float4>());
+    unsigned int tries = 0;
+    while(segments[0].size() < num_lines && tries < 20*num_lines)
+    {
+        ++tries;
+        Eigen::Vector3d P(L3D::L3DSyntheticScene::uniform(seed,-30.0,40.0),L3D::L3DSyntheticScene::uniform(seed,-25.0,25.0),L3D::L3DSyntheticScene::uniform(seed,0.0,20.0));
+        Eigen::Vector3d d(L3D::L3DSyntheticScene::uniform(seed,-1.0,1.0),L3D::L3DSyntheticScene::uniform(seed,-1.0,1.0),L3D::L3DSyntheticScene::uniform(seed,-0.2,0.2));
+        Eigen::Vector3d Q = P+d.normalized()*L3D::L3DSyntheticScene::uniform(seed,0.5,4.0);
+
+        std::vector<float4> proj(cams.size());
+        bool visible = true;
+        for(unsigned int c=0; c<cams.size() && visible; ++c)
+        {
+            Eigen::Vector3d p = cams[c].K_*(cams[c].R_*P+cams[c].t_);
+            Eigen::Vector3d q = cams[c].K_*(cams[c].R_*Q+cams[c].t_);
+            p /= p.z();
+            q /= q.z();
+
+            if(p.x() < 0 || p.y() < 0 || p.x() >= width || p.y() >= height ||
+                    q.x() < 0 || q.y() < 0 || q.x() >= width || q.y() >= height)
+                visible = false;
+
+            // detection noise
+            proj[c] = make_float4(p.x()+L3D::L3DSyntheticScene::uniform(seed,-0.5,0.5),p.y()+L3D::L3DSyntheticScene::uniform(seed,-0.5,0.5),
+                                  q.x()+L3D::L3DSyntheticScene::uniform(seed,-0.5,0.5),q.y()+L3D::L3DSyntheticScene::uniform(seed,-0.5,0.5));
+        }
+
+        if(visible)
+        {
+            for(unsigned int c=0; c<cams.size(); ++c)
+                segments[c].push_back(proj[c]);
+        }
+    }
+    return segments[0].size();
+}
+
+// fundamental matrix (see Line3D::fundamental)
+Eigen::Matrix3d fundamental(BenchCamera& c1, BenchCamera& c2)
+{
+    Eigen::Matrix3d R = c2.R_*c1.R_.transpose();
+    Eigen::Vector3d t = c2.t_-R*c1.t_;
+
+    Eigen::Matrix3d T;
+    T << 0.0, -t.z(), t.y(),
+         t.z(), 0.0, -t.x(),
+         -t.y(), t.x(), 0.0;
+
+    return c2.K_.transpose().inverse()*T*R*c1.K_.inverse();
+}
+
+// matches view 0 with all others (same data layout as Line3D::performMatching)
+double runMatching(std::vector<BenchCamera>& cams, std::vector<std::vector<float4> >& segments,
+                   const int threads, const int index_min_segments, unsigned int& num_raw,
+                   const bool numa_aware=false)
+{
+    unsigned int num_nb = cams.size()-1;
+    L3D::DataArray<float>* fundamentals = new L3D::DataArray<float>(3,3*num_nb);
+    L3D::DataArray<float>* RtKinvs = new L3D::DataArray<float>(3,3*num_nb);
+    L3D::DataArray<float>* projections = new L3D::DataArray<float>(4,3*num_nb);
+    L3D::DataArray<int2>* offsets = new L3D::DataArray<int2>(num_nb,1);
+    L3D::DataArray<float>* camCenters = new L3D::DataArray<float>(3,num_nb);
+    std::vector<float4> features_tgt_vec;
+    std::list<unsigned int> toBeMatched;
+    std::map<unsigned int,unsigned int> local2global;
+
+    for(unsigned int n=0; n<num_nb; ++n)
+    {
+        BenchCamera& c = cams[n+1];
+        Eigen::Matrix3d F = fundamental(cams[0],c);
+        Eigen::Matrix3d RtKinv = c.R_.transpose()*c.K_.inverse();
+        Eigen::MatrixXd Rt(3,4);
+        Rt.block<3,3>(0,0) = c.R_;
+        Rt.block<3,1>(0,3) = c.t_;
+        Eigen::MatrixXd P = c.K_*Rt;
+
+        for(int r=0; r<3; ++r)
+        {
+            for(int k=0; k<3; ++k)
+            {
+                fundamentals->dataCPU(k,n*3+r)[0] = F(r,k);
+                RtKinvs->dataCPU(k,n*3+r)[0] = RtKinv(r,k);
+            }
+            for(int k=0; k<4; ++k)
+                projections->dataCPU(k,n*3+r)[0] = P(r,k);
+
+            camCenters->dataCPU(r,n)[0] = c.C_(r);
+        }
+
+        offsets->dataCPU(n,0)[0] = make_int2(features_tgt_vec.size(),segments[n+1].size());
+        features_tgt_vec.insert(features_tgt_vec.end(),segments[n+1].begin(),segments[n+1].end());
+        toBeMatched.push_back(n);
+        local2global[n] = n+1;
+    }
+
+    L3D::DataArray<float4>* features_tgt = L3D::target_segments_array(features_tgt_vec,false);
+    L3D::DataArray<float>* segments_src = new L3D::DataArray<float>(4,segments[0].size());
+    for(unsigned int i=0; i<segments[0].size(); ++i)
+    {
+        segments_src->dataCPU(0,i)[0] = segments[0][i].x;
+        segments_src->dataCPU(1,i)[0] = segments[0][i].y;
+        segments_src->dataCPU(2,i)[0] = segments[0][i].z;
+        segments_src->dataCPU(3,i)[0] = segments[0][i].w;
+    }
+
+    L3D::DataArray<float>* RtKinv_src = new L3D::DataArray<float>(3,3);
+    Eigen::Matrix3d RtKinv = cams[0].R_.transpose()*cams[0].K_.inverse();
+    for(int r=0; r<3; ++r)
+        for(int k=0; k<3; ++k)
+            RtKinv_src->dataCPU(k,r)[0] = RtKinv(r,k);
+
+    float3 centerSrc = make_float3(cams[0].C_.x(),cams[0].C_.y(),cams[0].C_.z());
+
+    std::list<L3D::L3DMatchingPair> matches;
+    float median_depth = 1.0f;
+    L3D::L3DTimer timer;
+    L3D::compute_pairwise_matches_cpu(segments_src,RtKinv_src,features_tgt,RtKinvs,camCenters,
+                                      centerSrc,fundamentals,projections,offsets,
+                                      toBeMatched,matches,local2global,0,
+                                      L3D_DEF_UNCERTAINTY_UPPER_T,L3D_DEF_UNCERTAINTY_LOWER_T,
+                                      L3D_DEF_SIGMA_P,L3D_DEF_SIGMA_A,0.0f,
+                                      median_depth,num_raw,0,NULL,threads,false,"",
+                                      index_min_segments,numa_aware);
+    double t = timer.elapsedMS();
+
+    delete fundamentals;
+    delete RtKinvs;
+    delete projections;
+    delete offsets;
+    delete camCenters;
+    delete features_tgt;
+    delete segments_src;
+    delete RtKinv_src;
+    return t;
+}
+
+int main(int argc, char *argv[])
+{
+    TCLAP::CmdLine cmd("LINE3D_BENCH_HIGHRES");
+
+    TCLAP::ValueArg<float> mpArg("m", "megapixels", "image size [MP] (4:3)", false, 100.0f, "float");
+    cmd.add(mpArg);
+
+    TCLAP::ValueArg<std::string> sizesArg("n", "num_segments", "comma separated numbers of segments per image", false, "5000,10000,20000,50000", "string");
+    cmd.add(sizesArg);
+
+    TCLAP::ValueArg<int> camsArg("c", "num_cams", "number of views (view 0 is matched with all others)", false, 3, "int");
+    cmd.add(camsArg);
+
+    TCLAP::ValueArg<int> bruteArg("b", "brute_force_max", "max. number of segments for the brute force comparison", false, 10000, "int");
+    cmd.add(bruteArg);
+
+    TCLAP::ValueArg<int> threadsArg("t", "threads", "number of CPU threads (<= 0 --> all cores)", false, -1, "int");
+    cmd.add(threadsArg);
+
+    TCLAP::ValueArg<bool> numaArg("u", "numa", "repeat the indexed matching in the NUMA aware mode", false, false, "bool");
+    cmd.add(numaArg);
+
+    TCLAP::ValueArg<std::string> outputArg("o", "output_file", "result table", false, "./highres.txt", "string");
+    cmd.add(outputArg);
+
+    TCLAP::ValueArg<int> seedArg("s", "seed", "random seed", false, 42, "int");
+    cmd.add(seedArg);
+
+    // read arguments
+    cmd.parse(argc,argv);
+    unsigned int width = sqrt(fabs(mpArg.getValue())*1e6*4.0/3.0);
+    unsigned int height = width*3/4;
+    unsigned int brute_max = std::max(bruteArg.getValue(),0);
+    int threads = threadsArg.getValue();
+
+    std::vector<unsigned int> sizes;
+    std::stringstream nstr(sizesArg.getValue());
+    std::string token;
+    while(std::getline(nstr,token,','))
+    {
+        int n = atoi(token.c_str());
+        if(n > 0)
+            sizes.push_back(n);
+    }
+
+    std::vector<BenchCamera> cams = createRig(std::max(camsArg.getValue(),2),width,height);
+
+    std::stringstream table;
+    table << "image: " << width << "x" << height << ", " << cams.size() << " views";
+    table << ", NUMA nodes: " << L3D::L3DNumaTopology::system().numNodes() << std::endl;
+    table << std::setw(10) << std::left << "segments" << std::right;
+    table << std::setw(12) << "coll_idx" << std::setw(12) << "coll_dense";
+    table << std::setw(10) << "col_idx" << std::setw(10) << "col_dense";
+    table << std::setw(12) << "match_idx" << std::setw(12) << "match_bf";
+    table << std::setw(12) << "match_numa";
+    table << std::setw(10) << "raw_idx" << std::setw(10) << "raw_bf";
+    table << std::setw(14) << "us/segment" << std::endl;
+
+    for(unsigned int s=0; s<sizes.size(); ++s)
+    {
+        std::vector<std::vector<float4> > segments;
+        unsigned int n = createSegments(cams,sizes[s],width,height,seedArg.getValue(),segments);
+        std::cout << "[HIGHRES] " << n << " segments per image" << std::endl;
+
+        L3D::DataArray<float>* segs = new L3D::DataArray<float>(4,n);
+        for(unsigned int i=0; i<n; ++i)
+        {
+            segs->dataCPU(0,i)[0] = segments[0][i].x;
+            segs->dataCPU(1,i)[0] = segments[0][i].y;
+            segs->dataCPU(2,i)[0] = segments[0][i].z;
+            segs->dataCPU(3,i)[0] = segments[0][i].w;
+        }
+
+        // collinearity
+        L3D::L3DTimer timer;
+        std::map<unsigned int,std::map<unsigned int,float> > coll;
+        L3D::compute_collinearity_cpu_indexed(segs,L3D_DEF_COLLINEARITY_S,threads,coll);
+        double t_coll_idx = timer.elapsedMS();
+
+        unsigned int coll_idx = 0;
+        std::map<unsigned int,std::map<unsigned int,float> >::iterator cit = coll.begin();
+        for(; cit!=coll.end(); ++cit)
+            coll_idx += cit->second.size();
+        coll_idx /= 2;
+
+        double t_coll_dense = -1.0;
+        unsigned int coll_dense = 0;
+        if(n <= brute_max)
+        {
+            timer.start();
+            L3D::DataArray<float>* relation = new L3D::DataArray<float>(n,n);
+            L3D::compute_collinearity_cpu(segs,relation,L3D_DEF_COLLINEARITY_S,threads);
+            t_coll_dense = timer.elapsedMS();
+
+            for(unsigned int y=1; y<n; ++y)
+                for(unsigned int x=0; x<y; ++x)
+                    if(relation->dataCPU(x,y)[0] > 0.0f)
+                        ++coll_dense;
+
+            delete relation;
+        }
+        delete segs;
+
+        // matching
+        unsigned int raw_idx = 0;
+        unsigned int raw_bf = 0;
+        double t_match_idx = runMatching(cams,segments,threads,0,raw_idx);
+        double t_match_bf = -1.0;
+        if(n <= brute_max)
+            t_match_bf = runMatching(cams,segments,threads,-1,raw_bf);
+
+        unsigned int raw_numa = 0;
+        double t_match_numa = -1.0;
+        if(numaArg.getValue())
+            t_match_numa = runMatching(cams,segments,threads,0,raw_numa,true);
+
+        table << std::setw(10) << std::left << n << std::right;
+        table << std::fixed << std::setprecision(1);
+        table << std::setw(12) << t_coll_idx << std::setw(12) << t_coll_dense;
+        table << std::setw(10) << coll_idx << std::setw(10) << coll_dense;
+        table << std::setw(12) << t_match_idx << std::setw(12) << t_match_bf;
+        table << std::setw(12) << t_match_numa;
+        table << std::setw(10) << raw_idx << std::setw(10) << raw_bf;
+        table << std::setprecision(2) << std::setw(14) << 1000.0*(t_coll_idx+t_match_idx)/double(std::max(n,1u));
+        table << std::endl;
+    }
+    table << "times [ms], -1: not run (see -b, -u)" << std::endl;
+
+    std::ofstream file;
+    file.open(outputArg.getValue().c_str());
+    file << table.str();
+    file.close();
+
+    std::cout << std::endl << table.str();
+    return 0;
+}
@@ -0,0 +1,353 @@
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Throughput benchmark for the line segment detection. Runs the LSD
+// (for each refine mode and scale) and Line3D::detectSegments2D (for
+// each max. image width, with and without fragment merging) over
+// generated test patterns of different resolutions and reports MP/s,
+// segments/s, peak memory and the time spent in the individual LSD phases.
+// The LSD is also run with the top part of the image masked (sky), to
+// check that the detection time scales with the unmasked area.
+
+// EXTERNAL
+#include <tclap/CmdLine.h>
+#include <tclap/CmdLineInterface.h>
+#include <boost/filesystem.hpp>
+#include <opencv/cv.h>
+#include "eigen3/Eigen/Eigen"
+
+// std
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+// lib
+#include "line3D.h"
+#include "timer.h"
+
+// parses a comma separated list of numbers
+std::vector<double> parseList(const std::string list)
+{
+    std::vector<double> values;
+    std::stringstream str(list);
+    std::string token;
+    while(std::getline(str,token,','))
+    {
+        if(token.length() > 0)
+            values.push_back(atof(token.c_str()));
+    }
+    return values;
+}
+
+// value of a /proc/self/status entry [kB]
+long readProcStatus(const std::string key)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status,line))
+    {
+        if(line.compare(0,key.length(),key) == 0)
+            return atol(line.substr(key.length()+1).c_str());
+    }
+    return -1;
+}
+
+// resets the peak resident set size (VmHWM), Linux >= 4.0
+void resetPeakMemory()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if(clear_refs.is_open())
+        clear_refs << "5";
+}
+
+// generates a grayscale test pattern
+cv::Mat generatePattern(const std::string pattern, const unsigned int width,
+                        const unsigned int height)
+{
+    cv::Mat img;
+    if(pattern == "grid")
+    {
+        // rectangular grid (long, perfectly straight edges)
+        img = cv::Mat(height,width,CV_8UC1,cv::Scalar(220));
+        for(unsigned int x=16; x<width; x+=48)
+            cv::line(img,cv::Point(x,0),cv::Point(x,height-1),cv::Scalar(30),3);
+        for(unsigned int y=16; y<height; y+=48)
+            cv::line(img,cv::Point(0,y),cv::Point(width-1,y),cv::Scalar(30),3);
+    }
+    else if(pattern == "lines")
+    {
+        // random lines (one per 2000 pixels)
+        img = cv::Mat(height,width,CV_8UC1,cv::Scalar(128));
+        unsigned int num_lines = (width*height)/2000;
+        for(unsigned int i=0; i<num_lines; ++i)
+        {
+            cv::Point p1(rand()%width,rand()%height);
+            cv::Point p2(p1.x+rand()%200-100,p1.y+rand()%200-100);
+            cv::line(img,p1,p2,cv::Scalar(rand()%256),1+rand()%3);
+        }
+    }
+    else if(pattern == "noise")
+    {
+        // gaussian noise (many small regions, worst case for region growing)
+        img = cv::Mat(height,width,CV_8UC1);
+        cv::randn(img,128.0,40.0);
+    }
+    else
+    {
+        // natural texture: sum of upsampled noise octaves (1/f spectrum)
+        cv::Mat acc = cv::Mat::zeros(height,width,CV_32FC1);
+        float weight = 1.0f;
+        for(unsigned int s=256; s>=4; s/=4, weight*=0.5f)
+        {
+            cv::Mat octave(std::max(height/s,2u),std::max(width/s,2u),CV_32FC1);
+            cv::randu(octave,0.0,255.0);
+
+            cv::Mat octave_full;
+            cv::resize(octave,octave_full,cv::Size(width,height),0,0,cv::INTER_CUBIC);
+            acc += octave_full*weight;
+        }
+        cv::normalize(acc,acc,0.0,255.0,cv::NORM_MINMAX);
+        acc.convertTo(img,CV_8UC1);
+    }
+    return img;
+}
+
+// result of a single configuration
+struct BenchResult
+{
+    double time_ms_;
+    double segments_;
+    double peak_mb_;
+    cv::LSDPhaseTimes phases_;
+};
+
+// prints/stores one result row
+void writeRow(std::ostream& out, const std::string pattern, const double mp,
+              const std::string detector, const std::string refine,
+              const std::string scale, BenchResult& res)
+{
+    out << std::setw(8) << std::left << pattern << std::right << std::fixed;
+    out << std::setw(7) << std::setprecision(1) << mp;
+    out << std::setw(10) << detector << std::setw(6) << refine << std::setw(7) << scale;
+    out << std::setw(11) << std::setprecision(1) << res.time_ms_;
+    out << std::setw(8) << std::setprecision(2) << mp/(res.time_ms_*1e-3);
+    out << std::setw(9) << std::setprecision(0) << res.segments_;
+    out << std::setw(10) << res.segments_/(res.time_ms_*1e-3);
+    out << std::setw(9) << std::setprecision(1) << res.peak_mb_;
+    out << std::setw(9) << res.phases_.gradient << std::setw(9) << res.phases_.ordering;
+    out << std::setw(9) << res.phases_.region_growing << std::setw(9) << res.phases_.refinement;
+    out << std::setw(9) << res.phases_.nfa << std::endl;
+}
+
+void writeHeader(std::ostream& out)
+{
+    out << std::setw(8) << std::left << "pattern" << std::right << std::setw(7) << "MP";
+    out << std::setw(10) << "detector" << std::setw(6) << "ref" << std::setw(7) << "scale";
+    out << std::setw(11) << "time[ms]" << std::setw(8) << "MP/s";
+    out << std::setw(9) << "#segs" << std::setw(10) << "segs/s" << std::setw(9) << "peak[MB]";
+    out << std::setw(9) << "grad" << std::setw(9) << "order" << std::setw(9) << "grow";
+    out << std::setw(9) << "refine" << std::setw(9) << "nfa" << std::endl;
+}
+
+// averages the phase times over all repetitions
+void accumulatePhases(cv::LSDPhaseTimes& acc, const cv::LSDPhaseTimes& t, const double w)
+{
+    acc.gradient += t.gradient*w;
+    acc.ordering += t.ordering*w;
+    acc.region_growing += t.region_growing*w;
+    acc.refinement += t.refinement*w;
+    acc.nfa += t.nfa*w;
+}
+
+int main(int argc, char *argv[])
+{
+    TCLAP::CmdLine cmd("LINE3D_BENCH_LSD");
+
+    TCLAP::ValueArg<std::string> mpArg("m", "megapixels", "comma separated image sizes [MP]", false, "1,5,12,24,50", "string");
+    cmd.add(mpArg);
+
+    TCLAP::ValueArg<std::string> patternArg("p", "patterns", "comma separated patterns (grid,lines,noise,texture)", false, "grid,lines,noise,texture", "string");
+    cmd.add(patternArg);
+
+    TCLAP::ValueArg<std::string> scaleArg("c", "lsd_scales", "comma separated LSD scales (0..1]", false, "0.5,0.8,1.0", "string");
+    cmd.add(scaleArg);
+
+    TCLAP::ValueArg<std::string> widthArg("w", "max_image_widths", "comma separated max. widths for Line3D (-1 --> full resolution)", false, "1920,4096,-1", "string");
+    cmd.add(widthArg);
+
+    TCLAP::ValueArg<std::string> maskArg("k", "mask_fractions", "comma separated masked fractions of the image (top rows) for the LSD", false, "0,0.5", "string");
+    cmd.add(maskArg);
+
+    TCLAP::ValueArg<int> repArg("r", "repetitions", "number of runs per configuration", false, 3, "int");
+    cmd.add(repArg);
+
+    TCLAP::ValueArg<std::string> outputArg("o", "output_file", "optional file for the result table", false, "", "string");
+    cmd.add(outputArg);
+
+    TCLAP::ValueArg<int> seedArg("s", "seed", "random seed", false, 42, "int");
+    cmd.add(seedArg);
+
+    // read arguments
+    cmd.parse(argc,argv);
+    std::vector<double> megapixels = parseList(mpArg.getValue());
+    std::vector<double> scales = parseList(scaleArg.getValue());
+    std::vector<double> widths = parseList(widthArg.getValue());
+    std::vector<double> mask_fractions = parseList(maskArg.getValue());
+    unsigned int R = std::max(repArg.getValue(),1);
+    srand(seedArg.getValue());
+
+    std::vector<std::string> patterns;
+    std::stringstream pstr(patternArg.getValue());
+    std::string token;
+    while(std::getline(pstr,token,','))
+        patterns.push_back(token);
+
+    const int refine_modes[3] = {cv::LSD_REFINE_NONE,cv::LSD_REFINE_STD,cv::LSD_REFINE_ADV};
+    const std::string refine_names[3] = {"none","std","adv"};
+
+    // Line3D object (only used for detection)
+    std::string data_directory = "./L3D_bench_lsd/";
+    L3D::Line3D* line3D = new L3D::Line3D(data_directory);
+    line3D->lineSegmentDetector()->setPhaseTiming(true);
+
+    std::stringstream table;
+    writeHeader(std::cout);
+    writeHeader(table);
+
+    L3D::L3DTimer timer;
+    for(unsigned int m=0; m<megapixels.size(); ++m)
+    {
+        // 4:3 images
+        double mp = megapixels[m];
+        unsigned int width = std::max(int(sqrt(mp*1e6*4.0/3.0)),32);
+        unsigned int height = std::max(int(width*3/4),24);
+        double mp_real = double(width*height)*1e-6;
+
+        for(unsigned int p=0; p<patterns.size(); ++p)
+        {
+            cv::Mat image = generatePattern(patterns[p],width,height);
+
+            // LSD (all refine modes, scales and masks)
+            for(unsigned int f=0; f<mask_fractions.size(); ++f)
+            {
+                // masked: top rows
+                cv::Mat mask;
+                int masked_rows = std::min(int(mask_fractions[f]*double(height)),int(height));
+                if(masked_rows > 0)
+                {
+                    mask = cv::Mat(height,width,CV_8UC1,cv::Scalar(255));
+                    mask.rowRange(0,masked_rows).setTo(cv::Scalar(0));
+                }
+
+                std::stringstream det_str;
+                det_str << "lsd";
+                if(masked_rows > 0)
+                    det_str << "_m" << int(100.0*mask_fractions[f]+0.5);
+
+                for(unsigned int r=0; r<3; ++r)
+                {
+                    for(unsigned int s=0; s<scales.size(); ++s)
+                    {
+                        cv::Ptr<cv::LineSegmentDetector> lsd = cv::createLineSegmentDetectorPtr(refine_modes[r],scales[s]);
+                        lsd->setPhaseTiming(true);
+
+                        BenchResult res;
+                        res.time_ms_ = 0.0;
+                        res.segments_ = 0.0;
+                        res.peak_mb_ = 0.0;
+                        for(unsigned int k=0; k<R; ++k)
+                        {
+                            std::vector<cv::Vec4f> lines;
+                            long rss = readProcStatus("VmRSS:");
+                            resetPeakMemory();
+
+                            timer.start();
+                            if(mask.empty())
+                                lsd->detect(image,lines);
+                            else
+                                lsd->detectMasked(image,mask,lines);
+                            res.time_ms_ += timer.elapsedMS()/double(R);
+
+                            res.peak_mb_ = std::max(res.peak_mb_,double(readProcStatus("VmHWM:")-rss)/1024.0);
+                            res.segments_ += double(lines.size())/double(R);
+                            accumulatePhases(res.phases_,lsd->getPhaseTimes(),1.0/double(R));
+                        }
+
+                        std::stringstream scale_str;
+                        scale_str << std::fixed << std::setprecision(2) << scales[s];
+                        writeRow(std::cout,patterns[p],mp_real,det_str.str(),refine_names[r],scale_str.str(),res);
+                        writeRow(table,patterns[p],mp_real,det_str.str(),refine_names[r],scale_str.str(),res);
+                    }
+                }
+            }
+
+            // Line3D (all max. widths, without/with fragment merging)
+            for(unsigned int w=0; w<widths.size()*2; ++w)
+            {
+                bool merge = (w%2 == 1);
+                line3D->setFragmentMerging(merge);
+
+                BenchResult res;
+                res.time_ms_ = 0.0;
+                res.segments_ = 0.0;
+                res.peak_mb_ = 0.0;
+                for(unsigned int k=0; k<R; ++k)
+                {
+                    std::list<float4> segments;
+                    long rss = readProcStatus("VmRSS:");
+                    resetPeakMemory();
+
+                    timer.start();
+                    line3D->detectSegments2D(image,segments,int(widths[w/2]));
+                    res.time_ms_ += timer.elapsedMS()/double(R);
+
+                    res.peak_mb_ = std::max(res.peak_mb_,double(readProcStatus("VmHWM:")-rss)/1024.0);
+                    res.segments_ += double(segments.size())/double(R);
+                    accumulatePhases(res.phases_,line3D->lineSegmentDetector()->getPhaseTimes(),1.0/double(R));
+                }
+
+                std::stringstream width_str;
+                if(widths[w/2] > 0)
+                    width_str << int(widths[w/2]);
+                else
+                    width_str << "full";
+
+                std::string detector = merge ? "l3d_merge" : "line3D";
+                writeRow(std::cout,patterns[p],mp_real,detector,"adv",width_str.str(),res);
+                writeRow(table,patterns[p],mp_real,detector,"adv",width_str.str(),res);
+            }
+        }
+    }
+
+    // cleanup
+    delete line3D;
+    boost::filesystem::remove_all(boost::filesystem::path(data_directory));
+
+    if(outputArg.getValue().length() > 0)
+    {
+        std::ofstream file;
+        file.open(outputArg.getValue().c_str());
+        file << table.str();
+        file.close();
+    }
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Visual neighbor selection benchmark. Reconstructs a synthetic scene
+// with the similarity based selection (for several neighbor counts)
+// and the greedy coverage selection (for several min. gains) and
+// reports the number of matched view pairs, the matching time and the
+// recall of the ground truth lines (box edges).
+
+// EXTERNAL
+#include <tclap/CmdLine.h>
+#include <tclap/CmdLineInterface.h>
+#include <boost/filesystem.hpp>
+#include <opencv/cv.h>
+#include "eigen3/Eigen/Eigen"
+
+// std
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+// lib
+#include "line3D.h"
+#include "synthetic.h"
+
+// selection setting
+struct NeighborConfig
+{
+    std::string name_;
+    int mode_;
+    int neighbors_;
+    float min_gain_;
+};
+
+int main(int argc, char *argv[])
+{
+    TCLAP::CmdLine cmd("LINE3D_BENCH_NEIGHBORS");
+
+    TCLAP::ValueArg<int> viewsArg("n", "num_views", "number of synthetic views", false, 24, "int");
+    cmd.add(viewsArg);
+
+    TCLAP::ValueArg<int> boxesArg("b", "num_boxes", "number of synthetic boxes", false, 6, "int");
+    cmd.add(boxesArg);
+
+    TCLAP::ValueArg<int> widthArg("w", "image_width", "synthetic image width (height = 3/4 width)", false, 1280, "int");
+    cmd.add(widthArg);
+
+    TCLAP::ValueArg<std::string> neighborsArg("k", "neighbors", "comma separated neighbor counts (similarity selection)", false, "4,8,12", "string");
+    cmd.add(neighborsArg);
+
+    TCLAP::ValueArg<std::string> gainsArg("g", "min_gains", "comma separated min. gains (coverage selection)", false, "0.1,0.05,0.02", "string");
+    cmd.add(gainsArg);
+
+    TCLAP::ValueArg<float> toleranceArg("x", "tolerance", "max distance of a recalled line (world space)", false, 0.1f, "float");
+    cmd.add(toleranceArg);
+
+    TCLAP::ValueArg<int> backendArg("c", "backend", "compute backend (0: CUDA, 1: CPU)", false, L3D_BACKEND_CPU, "int");
+    cmd.add(backendArg);
+
+    TCLAP::ValueArg<std::string> outputArg("o", "output_folder", "folder for temporary data and the result table", false, "./L3D_neighbors/", "string");
+    cmd.add(outputArg);
+
+    TCLAP::ValueArg<int> seedArg("s", "seed", "random seed (synthetic scene)", false, 42, "int");
+    cmd.add(seedArg);
+
+    // read arguments
+    cmd.parse(argc,argv);
+    std::string outputFolder = outputArg.getValue();
+    unsigned int width = std::max(widthArg.getValue(),64);
+    double tolerance = fabs(toleranceArg.getValue());
+
+    // settings
+    std::vector<NeighborConfig> configs;
+    std::stringstream kstr(neighborsArg.getValue());
+    std::string token;
+    while(std::getline(kstr,token,','))
+    {
+        NeighborConfig c;
+        c.mode_ = L3D_NEIGHBORS_SIMILARITY;
+        c.neighbors_ = atoi(token.c_str());
+        c.min_gain_ = 0.0f;
+        c.name_ = "sim_k"+token;
+        configs.push_back(c);
+    }
+    std::stringstream gstr(gainsArg.getValue());
+    while(std::getline(gstr,token,','))
+    {
+        NeighborConfig c;
+        c.mode_ = L3D_NEIGHBORS_COVERAGE;
+        c.neighbors_ = -1;
+        c.min_gain_ = fabs(atof(token.c_str()));
+        c.name_ = "cov_g"+token;
+        configs.push_back(c);
+    }
+
+    // synthetic scene
+    L3D::L3DSyntheticScene scene(std::max(viewsArg.getValue(),2),
+                                 std::max(boxesArg.getValue(),1),
+                                 width,width*3/4,seedArg.getValue());
+
+    boost::filesystem::create_directory(boost::filesystem::path(outputFolder));
+    std::stringstream table;
+    table << std::setw(14) << std::left << "selection";
+    table << std::setw(8) << std::right << "pairs" << std::setw(12) << "matching";
+    table << std::setw(12) << "total" << std::setw(10) << "matches";
+    table << std::setw(8) << "lines" << std::setw(10) << "recall" << std::endl;
+
+    for(unsigned int c=0; c<configs.size(); ++c)
+    {
+        std::cout << "[NEIGHBORS] running " << configs[c].name_ << std::endl;
+        std::string data_directory = outputFolder+"/"+configs[c].name_+"/";
+
+        L3D::Line3D* line3D = new L3D::Line3D(data_directory,configs[c].neighbors_);
+        line3D->setComputeBackend(backendArg.getValue());
+        line3D->setNeighborSelection(configs[c].mode_,configs[c].min_gain_);
+
+        for(unsigned int i=0; i<scene.views()->size(); ++i)
+        {
+            L3D::L3DSyntheticView& v = scene.views()->at(i);
+            line3D->addImage(i,v.image_,v.K_,v.R_,v.t_,v.worldpoints_,width,false);
+        }
+
+        line3D->compute3Dmodel();
+
+        std::list<L3D::L3DFinalLine3D> lines;
+        line3D->getResult(lines);
+        L3D::L3DStatistics s = line3D->getStatistics();
+        float recall = L3D::L3DSyntheticScene::lineRecall(*scene.lines(),lines,tolerance);
+
+        table << std::setw(14) << std::left << configs[c].name_ << std::right;
+        table << std::fixed << std::setprecision(1);
+        table << std::setw(8) << s.num_neighbor_pairs_ << std::setw(12) << s.time_matching_;
+        table << std::setw(12) << s.time_total_ << std::setw(10) << s.num_matches_;
+        table << std::setw(8) << s.num_lines_ << std::setprecision(3) << std::setw(10) << recall << std::endl;
+
+        delete line3D;
+        boost::filesystem::remove_all(boost::filesystem::path(data_directory));
+    }
+
+    // result table [ms]
+    std::ofstream file;
+    file.open((outputFolder+"/neighbors.txt").c_str());
+    file << table.str();
+    file.close();
+
+    std::cout << std::endl << table.str();
+    return 0;
+}
@@ -3,13 +3,19 @@
 namespace L3D
 {
     //------------------------------------------------------------------------------
-    CLUniverse* performClustering(std::list<CLEdge> edges, int numNodes, float c)
+    CLUniverse* performClustering(std::list<CLEdge> edges, int numNodes, float c,
+                                  bool deterministic)
     {
+        L3D_TRACE_ZONE("performClustering");
+
         if(edges.size() == 0)
             return NULL;
 
         // sort edges by weight (increasing)
-        edges.sort(L3D::sortEdges);
+        if(deterministic)
+            edges.sort(L3D::sortEdgesDet);
+        else
+            edges.sort(L3D::sortEdges);
 
         // init universe
         CLUniverse *u = new CLUniverse(numNodes);
@@ -45,4 +51,292 @@ namespace L3D
         delete threshold;
         return u;
     }
+
+    //------------------------------------------------------------------------------
+    // edge list --> CSR (row i: edges with i_ == i, in list order)
+    static void edgesToCSR(const std::list<CLEdge>& edges, const int numNodes,
+                           std::vector<int>& row_ptr, std::vector<int>& cols,
+                           std::vector<float>& weights)
+    {
+        row_ptr.assign(numNodes+1,0);
+        std::list<CLEdge>::const_iterator it = edges.begin();
+        for(; it!=edges.end(); ++it)
+            ++row_ptr[it->i_+1];
+
+        for(int i=0; i<numNodes; ++i)
+            row_ptr[i+1] += row_ptr[i];
+
+        cols.resize(edges.size());
+        weights.resize(edges.size());
+        std::vector<int> fill(row_ptr.begin(),row_ptr.end()-1);
+        for(it=edges.begin(); it!=edges.end(); ++it)
+        {
+            int pos = fill[it->i_]++;
+            cols[pos] = it->j_;
+            weights[pos] = it->w_;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // (label, weight) pairs of a node's neighborhood
+    static bool sortLabelWeights(const std::pair<int,float>& a, const std::pair<int,float>& b)
+    {
+        return a.first < b.first;
+    }
+
+    //------------------------------------------------------------------------------
+    CLUniverse* performLabelPropagation(const std::list<CLEdge>& edges, int numNodes,
+                                        int num_threads, unsigned int max_iterations,
+                                        bool deterministic, unsigned int* iterations)
+    {
+        L3D_TRACE_ZONE("performLabelPropagation");
+
+        if(iterations != NULL)
+            *iterations = 0;
+
+        if(edges.size() == 0)
+            return NULL;
+
+        // affinity graph (CSR)
+        std::vector<int> row_ptr,cols;
+        std::vector<float> weights;
+        edgesToCSR(edges,numNodes,row_ptr,cols,weights);
+
+        // every node starts with its own label
+        std::vector<int> labels(numNodes);
+        for(int i=0; i<numNodes; ++i)
+            labels[i] = i;
+
+        std::vector<int> labels_next;
+        if(deterministic)
+            labels_next = labels;
+
+        int min_changes = int(L3D_LP_MIN_CHANGES*float(numNodes));
+        unsigned int iter = 0;
+        int changes = numNodes;
+        while(iter < max_iterations && changes > min_changes)
+        {
+            changes = 0;
+
+            #pragma omp parallel num_threads(num_threads) reduction(+:changes)
+            {
+                std::vector<std::pair<int,float> > lw;
+
+                #pragma omp for schedule(dynamic,256)
+                for(int i=0; i<numNodes; ++i)
+                {
+                    if(row_ptr[i] == row_ptr[i+1])
+                        continue;
+
+                    int current;
+                    if(deterministic)
+                    {
+                        current = labels[i];
+                    }
+                    else
+                    {
+                        #pragma omp atomic read
+                        current = labels[i];
+                    }
+
+                    // labels of the neighbors, the node itself counts
+                    // as its strongest neighbor (avoids oscillations)
+                    lw.clear();
+                    float self_w = 0.0f;
+                    for(int k=row_ptr[i]; k<row_ptr[i+1]; ++k)
+                    {
+                        int l;
+                        if(deterministic)
+                        {
+                            l = labels[cols[k]];
+                        }
+                        else
+                        {
+                            #pragma omp atomic read
+                            l = labels[cols[k]];
+                        }
+                        lw.push_back(std::pair<int,float>(l,weights[k]));
+                        self_w = std::max(self_w,weights[k]);
+                    }
+                    lw.push_back(std::pair<int,float>(current,self_w));
+                    std::sort(lw.begin(),lw.end(),sortLabelWeights);
+
+                    // strongest label (ties: smallest one)
+                    int best = current;
+                    float best_w = -1.0f;
+                    unsigned int k = 0;
+                    while(k < lw.size())
+                    {
+                        int l = lw[k].first;
+                        float w = 0.0f;
+                        for(; k<lw.size() && lw[k].first == l; ++k)
+                            w += lw[k].second;
+
+                        if(w > best_w)
+                        {
+                            best = l;
+                            best_w = w;
+                        }
+                    }
+
+                    if(best != current)
+                        ++changes;
+
+                    if(deterministic)
+                    {
+                        labels_next[i] = best;
+                    }
+                    else if(best != current)
+                    {
+                        #pragma omp atomic write
+                        labels[i] = best;
+                    }
+                }
+            }
+
+            if(deterministic)
+                labels.swap(labels_next);
+
+            ++iter;
+        }
+
+        if(iterations != NULL)
+            *iterations = iter;
+
+        // nodes with the same label form a cluster
+        CLUniverse *u = new CLUniverse(numNodes);
+        std::vector<int> representative(numNodes,-1);
+        for(int i=0; i<numNodes; ++i)
+        {
+            int l = labels[i];
+            if(representative[l] < 0)
+            {
+                representative[l] = i;
+            }
+            else
+            {
+                int a = u->find(representative[l]);
+                int b = u->find(i);
+                if(a != b)
+                    u->join(a,b);
+            }
+        }
+
+        return u;
+    }
+
+    //------------------------------------------------------------------------------
+    // strongest first (ties: smaller node ID)
+    struct CLStrongerEdge
+    {
+        CLStrongerEdge(const std::vector<int>& cols, const std::vector<float>& weights) :
+            cols_(cols), weights_(weights){}
+
+        bool operator()(const int a, const int b) const
+        {
+            if(weights_[a] != weights_[b])
+                return weights_[a] > weights_[b];
+            return cols_[a] < cols_[b];
+        }
+
+        const std::vector<int>& cols_;
+        const std::vector<float>& weights_;
+    };
+
+    //------------------------------------------------------------------------------
+    void sparsifyAffinities(std::list<CLEdge>& edges, int numNodes,
+                            unsigned int k, int num_threads)
+    {
+        L3D_TRACE_ZONE("sparsifyAffinities");
+
+        if(k == 0 || edges.size() == 0)
+            return;
+
+        std::vector<int> row_ptr,cols;
+        std::vector<float> weights;
+        edgesToCSR(edges,numNodes,row_ptr,cols,weights);
+
+        // rows sorted by node ID (for the reverse lookup)
+        #pragma omp parallel num_threads(num_threads)
+        {
+            std::vector<std::pair<int,float> > row;
+
+            #pragma omp for schedule(dynamic,256)
+            for(int i=0; i<numNodes; ++i)
+            {
+                row.clear();
+                for(int p=row_ptr[i]; p<row_ptr[i+1]; ++p)
+                    row.push_back(std::pair<int,float>(cols[p],weights[p]));
+
+                std::sort(row.begin(),row.end());
+                for(unsigned int r=0; r<row.size(); ++r)
+                {
+                    cols[row_ptr[i]+r] = row[r].first;
+                    weights[row_ptr[i]+r] = row[r].second;
+                }
+            }
+        }
+
+        // k strongest edges per node
+        std::vector<char> top(cols.size(),0);
+        #pragma omp parallel num_threads(num_threads)
+        {
+            std::vector<int> order;
+            CLStrongerEdge stronger(cols,weights);
+
+            #pragma omp for schedule(dynamic,256)
+            for(int i=0; i<numNodes; ++i)
+            {
+                int degree = row_ptr[i+1]-row_ptr[i];
+                if(degree <= int(k))
+                {
+                    for(int p=row_ptr[i]; p<row_ptr[i+1]; ++p)
+                        top[p] = 1;
+                    continue;
+                }
+
+                order.resize(degree);
+                for(int r=0; r<degree; ++r)
+                    order[r] = row_ptr[i]+r;
+
+                std::partial_sort(order.begin(),order.begin()+k,order.end(),stronger);
+                for(unsigned int r=0; r<k; ++r)
+                    top[order[r]] = 1;
+            }
+        }
+
+        // union: an edge stays if it is among the k strongest of either node
+        std::vector<int> reverse(cols.size(),-1);
+        std::vector<char> keep(cols.size(),0);
+        #pragma omp parallel for schedule(dynamic,256) num_threads(num_threads)
+        for(int i=0; i<numNodes; ++i)
+        {
+            for(int p=row_ptr[i]; p<row_ptr[i+1]; ++p)
+            {
+                int j = cols[p];
+                std::vector<int>::const_iterator r = std::lower_bound(cols.begin()+row_ptr[j],
+                                                                      cols.begin()+row_ptr[j+1],i);
+                if(r != cols.begin()+row_ptr[j+1] && *r == i)
+                    reverse[p] = r-cols.begin();
+
+                keep[p] = top[p] || (reverse[p] >= 0 && top[reverse[p]]);
+            }
+        }
+
+        edges.clear();
+        for(int i=0; i<numNodes; ++i)
+        {
+            for(int p=row_ptr[i]; p<row_ptr[i+1]; ++p)
+            {
+                if(!keep[p])
+                    continue;
+
+                CLEdge e;
+                e.i_ = i;
+                e.j_ = cols[p];
+                e.w_ = weights[p];
+                edges.push_back(e);
+            }
+        }
+    }
 }
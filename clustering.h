@@ -35,9 +35,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <list>
+#include <vector>
 #include <algorithm>
 
 #include "universe.h"
+#include "tracing.h"
 
 /**
  * Clustering
@@ -47,10 +49,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
  * This code is an adaption of their original source code,
  * to fit into our datastructures.
+ *
+ * Label propagation (parallel, for very large graphs)
+ * on the same edges, result as a CLUniverse as well.
  * ====================
  * Author: M.Hofer, 2015
  */
 
+// label propagation: converged when less than this fraction of the nodes changes
+#define L3D_LP_MIN_CHANGES 0.001f
+
 namespace L3D
 {
     // edge in affinity matrix
@@ -74,6 +82,19 @@ namespace L3D
         return a.w_ < b.w_;
     }
 
+    // same as above, ties broken by the node IDs (total order)
+    static bool sortEdgesDet(const CLEdge& a, const CLEdge& b)
+    {
+        if(a.w_ < b.w_)
+            return true;
+        else if(a.w_ == b.w_ && a.i_ < b.i_)
+            return true;
+        else if(a.w_ == b.w_ && a.i_ == b.i_ && a.j_ < b.j_)
+            return true;
+        else
+            return false;
+    }
+
     static bool sortEdgesByRow(const CLEdge& a, const CLEdge& b)
     {
         if(a.i_ < b.i_)
@@ -122,8 +143,25 @@ namespace L3D
     }
 
     // perform graph clustering
+    // (deterministic: edges with equal weights are processed in a fixed order)
     CLUniverse* performClustering(std::list<CLEdge> edges, int numNodes,
-                                  float c);
+                                  float c, bool deterministic=false);
+
+    // keeps the k strongest edges of each node (an edge stays if it
+    // is among the k strongest of one of its nodes --> symmetric)
+    void sparsifyAffinities(std::list<CLEdge>& edges, int numNodes,
+                            unsigned int k, int num_threads);
+
+    // weighted label propagation (multithreaded alternative to performClustering
+    // for very large affinity graphs): every node takes the label with the
+    // highest sum of edge weights among its neighbors, until less than
+    // L3D_LP_MIN_CHANGES of the nodes change or max_iterations is reached
+    // (edges in both directions, as in the affinity matrix; deterministic:
+    //  synchronous updates, same result for any number of threads)
+    CLUniverse* performLabelPropagation(const std::list<CLEdge>& edges, int numNodes,
+                                        int num_threads, unsigned int max_iterations,
+                                        bool deterministic=false,
+                                        unsigned int* iterations=NULL);
 
 }
 
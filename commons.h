@@ -27,6 +27,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // internal
 #include "serialization.h"
 #include "clustering.h"
+#include "memory.h"
+#include "timer.h"
 
 /**
  * Line3D - Constants
@@ -41,12 +43,24 @@ namespace L3D
     // feature detection
     #define L3D_DEF_MAX_IMG_WIDTH 1920
     #define L3D_DEF_MIN_LINE_LENGTH_F 0.005f
+    // max. number of segments per image (0 = unlimited, see Line3D::setMaxNumSegments)
     #define L3D_DEF_MAX_NUM_SEGMENTS 3000
     #define L3D_DEF_LOAD_AND_STORE_SEGMENTS true
+    // segments derived from finer cached detections: min. length in the scaled image [px]
+    #define L3D_DERIVED_MIN_LENGTH_PX 5.0f
+    // fragment merging (before the segment cap): max. angle [rad], max. normal
+    // offset [px], max. gap along the line (fraction of the image diagonal)
+    #define L3D_DEF_MERGE_FRAGMENTS false
+    #define L3D_FRAGMENT_MAX_ANGLE 0.035f
+    #define L3D_FRAGMENT_MAX_OFFSET 1.5f
+    #define L3D_FRAGMENT_MAX_GAP_F 0.005f
+    #define L3D_FRAGMENT_MAX_PASSES 3
 
     // collinearity
     #define L3D_DEF_COLLINEARITY_S 2.0f
     #define L3D_DEF_COLLINEARITY_FOR_CLUSTERING true
+    // more segments: sparse, orientation indexed collinearity instead of the dense matrix
+    #define L3D_DENSE_COLLINEARITY_MAX 4096
 
     // matching
     #define L3D_DEF_MATCHING_NEIGHBORS 10
@@ -56,12 +70,97 @@ namespace L3D
     // same as for GPU!
     #define L3D_DEF_SIGMA_P 3.5f
     #define L3D_DEF_SIGMA_A 10.0f
+    // max. hypotheses per segment after verification (0 = no limit)
+    #define L3D_DEF_MAX_HYPOTHESES 0
+    // direction classes: only segments which point at a common vanishing point
+    // are matched (dominant 3D directions, estimated from the longest segments)
+    #define L3D_DEF_DIRECTION_CLASSES false
+    #define L3D_VD_MAX_DIRECTIONS 6
+    #define L3D_VD_ANGLE_T 0.035f
+    #define L3D_VD_SIGMA_PX 1.0f
+    #define L3D_VD_MIN_SUPPORT 0.05f
+    #define L3D_VD_SAMPLE_SIZE 20000
+    #define L3D_VD_RANSAC_ITERATIONS 1000
+
+    // match files: background I/O threads (0 = synchronous reads), max. prefetched
+    // file data [MB, size on disk] and number of upcoming views which are prefetched during matching
+    #define L3D_DEF_PREFETCH_THREADS 2
+    #define L3D_DEF_PREFETCH_BUFFER_MB 256
+    #define L3D_PREFETCH_DEPTH 4
 
     // replicator dynamics diffusion
     #define L3D_DEF_PERFORM_RDD false
 
     // clustering
     #define L3D_MIN_AFFINITY 0.25f
+    #define L3D_CLUSTERING_GRAPH 0
+    #define L3D_CLUSTERING_LABEL_PROPAGATION 1
+    #define L3D_DEF_CLUSTERING L3D_CLUSTERING_GRAPH
+    #define L3D_DEF_LP_MAX_ITERATIONS 30
+    // max. affinities per segment before diffusion/clustering (0 = all)
+    #define L3D_DEF_AFFINITY_TOP_K 0
+
+    // host precision (3D similarities)
+    #define L3D_PRECISION_DOUBLE 0
+    #define L3D_PRECISION_FLOAT 1
+    #define L3D_DEF_HOST_PRECISION L3D_PRECISION_DOUBLE
+
+    // compute backend
+    #define L3D_BACKEND_CUDA 0
+    #define L3D_BACKEND_CPU 1
+    #define L3D_DEF_BACKEND L3D_BACKEND_CUDA
+    #define L3D_DEF_NUM_THREADS -1
+    #define L3D_DEF_DETERMINISTIC false
+    // CPU matching: threads pinned to the NUMA nodes, node local segment copies
+    #define L3D_DEF_NUMA_AWARE false
+
+    // memory budget [MB] for the host data structures (0 = unlimited)
+    #define L3D_DEF_MEMORY_BUDGET_MB 0
+    // hypothesis cap when the budget is exceeded during matching
+    #define L3D_BUDGET_MAX_HYPOTHESES 3
+
+    // visual neighbor selection
+    #define L3D_NEIGHBORS_SIMILARITY 0
+    #define L3D_NEIGHBORS_COVERAGE 1
+    #define L3D_DEF_NEIGHBOR_SELECTION L3D_NEIGHBORS_SIMILARITY
+    // coverage: min. gain of an additional neighbor (fraction of the source worldpoints)
+    #define L3D_DEF_COVERAGE_MIN_GAIN 0.05f
+    // coverage: weight of a worldpoint which is already seen by k neighbors (decay^k)
+    #define L3D_COVERAGE_DECAY 0.5f
+    // coverage: influence of the viewing angle spread [0,1]
+    #define L3D_COVERAGE_ANGLE_WEIGHT 0.5f
+
+    // redundant view culling: views with a camera center within the min. baseline,
+    // a similar viewing direction [rad] and a high worldpoint overlap (fraction of
+    // the smaller view) are represented by a single view during matching
+    #define L3D_CULLING_OFF 0
+    #define L3D_CULLING_ON 1
+    // culled segments are attached to the 3D lines they project onto
+    #define L3D_CULLING_REATTACH 2
+    #define L3D_DEF_VIEW_CULLING L3D_CULLING_OFF
+    #define L3D_CULL_MAX_ANGLE 0.175f
+    #define L3D_CULL_MIN_OVERLAP 0.8f
+    // re-attachment: max. endpoint distance to the projected line [px], max. angle [rad]
+    // and min. overlap with the projected segment (fraction of the 2D segment)
+    #define L3D_REATTACH_MAX_DIST_PX 2.0f
+    #define L3D_REATTACH_MAX_ANGLE 0.035f
+    #define L3D_REATTACH_MIN_OVERLAP 0.5f
+    // re-attachment: cell size [px] of the segment grid (per culled view)
+    #define L3D_REATTACH_GRID_PX 64
+
+    // adaptive matching budget: time target [s] (0 = fixed number of neighbors)
+    #define L3D_DEF_MATCHING_TIME_TARGET 0.0f
+    // segment pair tests per second (defaults, calibrate with getStatistics())
+    #define L3D_PAIR_TESTS_PER_S_CUDA 2.0e9
+    #define L3D_PAIR_TESTS_PER_S_CPU 2.5e7
+
+    // auto tuning (CPU): synthetic calibration scene (views, boxes, image size)
+    // and repetitions per configuration (best time counts)
+    #define L3D_TUNE_VIEWS 12
+    #define L3D_TUNE_BOXES 150
+    #define L3D_TUNE_WIDTH 1920
+    #define L3D_TUNE_HEIGHT 1080
+    #define L3D_TUNE_REPEATS 2
 
     #define L3D_EPS 1e-12
 
@@ -145,6 +244,10 @@ namespace L3D
             score_ = s;
         }
 
+        void setID(unsigned int id){
+            id_ = id;
+        }
+
         void invalidate(){valid_ = false;}
         void validate(){valid_ = true;}
 
@@ -165,6 +268,83 @@ namespace L3D
         return (sm1->confidence() > sm2->confidence());
     }
 
+    // run statistics (counts and timings [ms])
+    struct L3DStatistics
+    {
+        L3DStatistics(){
+            reset();
+        }
+
+        void reset(){
+            num_views_ = 0;
+            num_segments_ = 0;
+            num_fragments_merged_ = 0;
+            num_views_culled_ = 0;
+            num_segments_reattached_ = 0;
+            num_neighbor_pairs_ = 0;
+            num_pair_tests_ = 0;
+            num_pair_tests_skipped_ = 0;
+            num_raw_matches_ = 0;
+            num_matches_ = 0;
+            num_correspondences_ = 0;
+            num_affinities_ = 0;
+            num_affinities_kept_ = 0;
+            num_clusters_ = 0;
+            num_lines_ = 0;
+
+            time_detection_ = 0.0;
+            time_neighbors_ = 0.0;
+            time_matching_ = 0.0;
+            time_selection_ = 0.0;
+            time_clustering_ = 0.0;
+            time_partitioning_ = 0.0;
+            time_io_matching_ = 0.0;
+            time_io_selection_ = 0.0;
+            time_total_ = 0.0;
+
+            load_balance_.reset();
+            memory_.reset();
+        }
+
+        unsigned int num_views_;
+        unsigned int num_segments_;
+        // removed by the fragment merging (see Line3D::setFragmentMerging)
+        unsigned int num_fragments_merged_;
+        // redundant views (see Line3D::setViewCulling)
+        unsigned int num_views_culled_;
+        unsigned int num_segments_reattached_;
+        unsigned int num_neighbor_pairs_;
+        unsigned long long num_pair_tests_;
+        // skipped: no common direction class (see Line3D::setDirectionClasses)
+        unsigned long long num_pair_tests_skipped_;
+        unsigned int num_raw_matches_;
+        unsigned int num_matches_;
+        unsigned int num_correspondences_;
+        unsigned int num_affinities_;
+        // after the sparsification (see Line3D::setAffinityTopK)
+        unsigned int num_affinities_kept_;
+        unsigned int num_clusters_;
+        unsigned int num_lines_;
+
+        double time_detection_;
+        double time_neighbors_;
+        double time_matching_;
+        double time_selection_;
+        double time_clustering_;
+        // graph clustering only (without the affinities)
+        double time_partitioning_;
+        // blocked on match file reads (summed over all threads)
+        double time_io_matching_;
+        double time_io_selection_;
+        double time_total_;
+
+        // CPU matching (see L3DLoadBalance)
+        L3D::L3DLoadBalance load_balance_;
+
+        // host memory (peak per structure)
+        L3D::L3DMemoryTracker memory_;
+    };
+
     // visual neighbor
     struct L3DVisualNeighbor
     {
@@ -0,0 +1,1388 @@
+#include "cpuwrapper.h"
+
+// constants (shared with the GPU)
+#include "cudawrapper.h"
+#include "l3dnuma.h"
+#include "timer.h"
+
+// std
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+// external
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace L3D
+{
+    /// HELPER FUNCTIONS
+    ////////////////////////////////////////////////////////////////////////////////
+    int cpu_num_threads(const int num_threads)
+    {
+        if(num_threads > 0)
+            return num_threads;
+
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // id of the calling thread in the current team (0 without OpenMP)
+    int cpu_thread_id()
+    {
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // copy a (padded) matrix block from a DataArray into a dense buffer
+    void cpu_copy_matrix(L3D::DataArray<float>* src, const unsigned int row_offset,
+                         const unsigned int rows, const unsigned int cols, float* dst)
+    {
+        for(unsigned int r=0; r<rows; ++r)
+            for(unsigned int c=0; c<cols; ++c)
+                dst[r*cols+c] = src->dataCPU(c,row_offset+r)[0];
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // same as K_collinearity (for x < y)
+    float cpu_collinearity(const float* seg1, const float* seg2, const float coll_sigma_sqr)
+    {
+        // line1
+        float3 p1 = make_float3(seg1[0],seg1[1],1.0f);
+        float3 p2 = make_float3(seg1[2],seg1[3],1.0f);
+        float3 line1 = cross(p1,p2);
+
+        // line2
+        float3 q1 = make_float3(seg2[0],seg2[1],1.0f);
+        float3 q2 = make_float3(seg2[2],seg2[3],1.0f);
+        float3 line2 = cross(q1,q2);
+
+        // distances
+        float d1 = fmax(HD_distance_p2l_2D_f3(line2,p1),HD_distance_p2l_2D_f3(line2,p2));
+        float d2 = fmax(HD_distance_p2l_2D_f3(line1,q1),HD_distance_p2l_2D_f3(line1,q2));
+        float d = fmax(d1,d2);
+
+        // affinity
+        float aff = expf(-d*d/(2.0f*coll_sigma_sqr));
+        if(aff > L3D_COLLIN_AFF_T_G)
+        {
+            // check for conflict (overlap)
+            float2 _p1 = make_float2(p1.x,p1.y);
+            float2 _p2 = make_float2(p2.x,p2.y);
+            float2 _q1 = make_float2(q1.x,q1.y);
+            float2 _q2 = make_float2(q2.x,q2.y);
+            float pos1 = dot(_q1-_p1,_q2-_p1);
+            float pos2 = dot(_q1-_p2,_q2-_p2);
+            float pos3 = dot(_p1-_q1,_p2-_q1);
+            float pos4 = dot(_p1-_q2,_p2-_q2);
+
+            if(pos1 > -L3D_EPS_G && pos2 > -L3D_EPS_G && pos3 > -L3D_EPS_G && pos4 > -L3D_EPS_G)
+                return aff;
+        }
+
+        return 0.0f;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // contiguous ranges [x,y) of items with about equal cost, at most max_tasks
+    // (prefix[i]: cost of the items 0..i-1)
+    void cpu_split_ranges(const std::vector<double>& prefix, const unsigned int max_tasks,
+                          std::vector<int2>& ranges)
+    {
+        ranges.clear();
+        int n = int(prefix.size())-1;
+        if(n <= 0)
+            return;
+
+        unsigned int tasks = std::max(max_tasks,1u);
+        int begin = 0;
+        for(unsigned int t=1; t<=tasks && begin<n; ++t)
+        {
+            int end = n;
+            if(t < tasks)
+            {
+                double target = prefix[n]*double(t)/double(tasks);
+                end = std::lower_bound(prefix.begin()+begin+1,prefix.end(),target)-prefix.begin();
+                end = std::min(end,n);
+            }
+            ranges.push_back(make_int2(begin,end));
+            begin = end;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // matching task: source rows [begin,end) vs. one neighbor
+    struct L3DMatchingTask
+    {
+        unsigned int neighbor_;
+        int begin_;
+        int end_;
+        double cost_;
+    };
+
+    // expensive tasks first (fewer stragglers), ties in input order
+    bool cpu_sort_tasks(const L3DMatchingTask& t1, const L3DMatchingTask& t2)
+    {
+        if(t1.cost_ != t2.cost_)
+            return (t1.cost_ > t2.cost_);
+        if(t1.neighbor_ != t2.neighbor_)
+            return (t1.neighbor_ < t2.neighbor_);
+        return (t1.begin_ < t2.begin_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // angle in [0,pi)
+    double cpu_angle_mod_pi(double a)
+    {
+        a = fmod(a,M_PI);
+        if(a < 0.0)
+            a += M_PI;
+        return a;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // index of the target segments by the epipolar lines which hit them:
+    // an angular interval in the pencil of epipolar lines (finite epipole)
+    // or an offset interval (epipole (almost) at infinity --> parallel lines)
+    class L3DEpipolarIndex
+    {
+    public:
+        L3DEpipolarIndex(L3D::DataArray<float4>* segments_tgt, const int offset,
+                         const int width, const float* F) : valid_(false), F_(F)
+        {
+            // epipole in the target image (intersection of two epipolar lines)
+            float3 l0 = HD_epipolar_line(make_float3(0,0,1),F,false);
+            float3 l1 = HD_epipolar_line(make_float3(1,0,1),F,false);
+            float3 l2 = HD_epipolar_line(make_float3(0,1,1),F,false);
+            float3 e1 = cross(l0,l1);
+            float3 e2 = cross(l0,l2);
+            float3 e = (length(e1) > length(e2)) ? e1 : e2;
+
+            double exy = sqrt(double(e.x)*double(e.x)+double(e.y)*double(e.y));
+            if(exy < L3D_EPS_G && fabs(e.z) < L3D_EPS_G)
+                return;
+
+            // image extent (from the segments)
+            double extent = 1.0;
+            for(int j=0; j<width; ++j)
+            {
+                float4 data = target_segment(segments_tgt,offset+j);
+                extent = fmax(extent,fmax(fmax(fabs(data.x),fabs(data.y)),fmax(fabs(data.z),fabs(data.w))));
+            }
+
+            // far epipole: parallel lines, the offsets are off by at most extent^2/distance
+            parallel_ = (fabs(e.z)*1e3*extent < exy);
+            if(parallel_)
+            {
+                nx_ = -double(e.y)/exy;
+                ny_ = double(e.x)/exy;
+                pad_ = 1.0+((fabs(e.z) > 0.0f) ? extent*extent*fabs(e.z)/exy : 0.0);
+            }
+            else
+            {
+                ex_ = double(e.x)/double(e.z);
+                ey_ = double(e.y)/double(e.z);
+                pad_ = L3D_INDEX_PAD;
+            }
+
+            // coordinate intervals of the targets
+            std::vector<double> start(width);
+            std::vector<double> ext(width);
+            min_ = 0.0;
+            max_ = M_PI;
+            for(int j=0; j<width; ++j)
+            {
+                float4 data = target_segment(segments_tgt,offset+j);
+                if(parallel_)
+                {
+                    double u1 = nx_*data.x+ny_*data.y;
+                    double u2 = nx_*data.z+ny_*data.w;
+                    start[j] = fmin(u1,u2);
+                    ext[j] = fabs(u2-u1);
+
+                    if(j == 0 || start[j] < min_) min_ = start[j];
+                    if(j == 0 || start[j]+ext[j] > max_) max_ = start[j]+ext[j];
+                }
+                else
+                {
+                    // subtended angle (< pi, unless the epipole lies on the segment)
+                    double v1x = data.x-ex_;
+                    double v1y = data.y-ey_;
+                    double v2x = data.z-ex_;
+                    double v2y = data.w-ey_;
+                    double a1 = atan2(v1y,v1x);
+                    double e_ang = atan2(v1x*v2y-v1y*v2x,v1x*v2x+v1y*v2y);
+                    start[j] = (e_ang >= 0.0) ? a1 : a1+e_ang;
+                    ext[j] = fabs(e_ang);
+                }
+            }
+            if(parallel_)
+            {
+                min_ -= pad_;
+                max_ += pad_;
+            }
+
+            bins_.resize(L3D_INDEX_BINS);
+            for(int j=0; j<width; ++j)
+                insert(j,start[j],ext[j]);
+
+            valid_ = true;
+        }
+
+        bool valid(){return valid_;}
+
+        // candidate targets for a source segment (ascending, no duplicates),
+        // seen: per target the last source ID which collected it
+        void candidates(const float3 p1, const float3 p2, const int srcID,
+                        std::vector<int>& seen, std::vector<int>& result)
+        {
+            result.clear();
+
+            double u1 = lineCoordinate(HD_epipolar_line(p1,F_,false));
+            double u2 = lineCoordinate(HD_epipolar_line(p2,F_,false));
+
+            double start,ext;
+            if(parallel_)
+            {
+                start = fmin(u1,u2);
+                ext = fabs(u2-u1);
+            }
+            else
+            {
+                // arc from u1 to u2 which contains the midpoint
+                double um = lineCoordinate(HD_epipolar_line(0.5f*(p1+p2),F_,false));
+                double d = cpu_angle_mod_pi(u2-u1);
+                double dm = cpu_angle_mod_pi(um-u1);
+                start = (dm <= d) ? u1 : u2;
+                ext = (dm <= d) ? d : M_PI-d;
+            }
+
+            int b0,num;
+            binRange(start,ext,b0,num);
+            for(int k=0; k<num; ++k)
+            {
+                std::vector<int>& bin = bins_[(b0+k) % L3D_INDEX_BINS];
+                for(unsigned int i=0; i<bin.size(); ++i)
+                {
+                    if(seen[bin[i]] != srcID)
+                    {
+                        seen[bin[i]] = srcID;
+                        result.push_back(bin[i]);
+                    }
+                }
+            }
+            std::sort(result.begin(),result.end());
+        }
+
+    private:
+        // coordinate of an epipolar line (angle or offset)
+        double lineCoordinate(const float3 l)
+        {
+            if(parallel_)
+            {
+                // a*x+b*y+c = 0 with (a,b) ~ n
+                double s = nx_*double(l.x)+ny_*double(l.y);
+                return (fabs(s) > L3D_EPS_G) ? -double(l.z)/s : 0.0;
+            }
+            return cpu_angle_mod_pi(atan2(double(l.x),-double(l.y)));
+        }
+
+        // bins covered by [start,start+ext] (padded, angles wrap around at pi)
+        void binRange(const double start, const double ext, int& b0, int& num)
+        {
+            if(parallel_)
+            {
+                double scale = double(L3D_INDEX_BINS)/fmax(max_-min_,double(L3D_EPS_G));
+                b0 = std::max(std::min(int((start-pad_-min_)*scale),L3D_INDEX_BINS-1),0);
+                int b1 = std::max(std::min(int((start+ext+pad_-min_)*scale),L3D_INDEX_BINS-1),0);
+                num = b1-b0+1;
+            }
+            else
+            {
+                double s = cpu_angle_mod_pi(start-pad_);
+                b0 = std::min(int(s/M_PI*L3D_INDEX_BINS),L3D_INDEX_BINS-1);
+                int b1 = int((s+ext+2.0*pad_)/M_PI*L3D_INDEX_BINS);
+                num = std::min(b1-b0+1,L3D_INDEX_BINS);
+            }
+        }
+
+        void insert(const int j, const double start, const double ext)
+        {
+            int b0,num;
+            binRange(start,ext,b0,num);
+            for(int k=0; k<num; ++k)
+                bins_[(b0+k) % L3D_INDEX_BINS].push_back(j);
+        }
+
+        bool valid_;
+        bool parallel_;
+        const float* F_;
+        double ex_;
+        double ey_;
+        double nx_;
+        double ny_;
+        double pad_;
+        double min_;
+        double max_;
+        std::vector<std::vector<int> > bins_;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // same as K_pairwise_matches (for one segment pair)
+    float4 cpu_pairwise_match(const float3 p1, const float3 p2,
+                              const float3 q1, const float3 q2,
+                              const float* F, const float* RtKinv_src, const int r_stride,
+                              const float* RtKinv_tgt, const float3 C_src, const float3 C_tgt)
+    {
+        float4 result = make_float4(0,0,0,0);
+
+        float3 line1 = cross(p1,p2);
+        float3 line2 = cross(q1,q2);
+
+        // epipolar lines
+        float3 epi_p1 = HD_epipolar_line(p1,F,false);
+        float3 epi_p2 = HD_epipolar_line(p2,F,false);
+        float3 epi_q1 = HD_epipolar_line(q1,F,true);
+        float3 epi_q2 = HD_epipolar_line(q2,F,true);
+
+        // intersect
+        float3 l2_p1 = HD_normalize_hom_coords_2D(cross(line2,epi_p1));
+        float3 l2_p2 = HD_normalize_hom_coords_2D(cross(line2,epi_p2));
+        float3 l1_q1 = HD_normalize_hom_coords_2D(cross(line1,epi_q1));
+        float3 l1_q2 = HD_normalize_hom_coords_2D(cross(line1,epi_q2));
+
+        if(int(l2_p1.z) == 0 || int(l2_p2.z) == 0 ||
+                int(l1_q1.z) == 0 || int(l1_q2.z) == 0)
+        {
+            // intersections not valid
+            return result;
+        }
+
+        // check if enough overlap
+        float overlap1 = HD_segment_overlap_2D(p1,p2,l1_q1,l1_q2);
+        float overlap2 = HD_segment_overlap_2D(q1,q2,l2_p1,l2_p2);
+
+        if(fmin(overlap1,overlap2) > L3D_MIN_OVERLAP_LOWER_T_G &&
+                fmax(overlap1,overlap2) > L3D_MIN_OVERLAP_UPPER_T_G)
+        {
+            // potential match --> triangulate
+            result.x = HD_get_triangulation_depth(p1,l2_p1,C_src,C_tgt,
+                                                  RtKinv_src,r_stride,RtKinv_tgt,3,true);
+            result.y = HD_get_triangulation_depth(p2,l2_p2,C_src,C_tgt,
+                                                  RtKinv_src,r_stride,RtKinv_tgt,3,true);
+            result.z = HD_get_triangulation_depth(l1_q1,q1,C_src,C_tgt,
+                                                  RtKinv_src,r_stride,RtKinv_tgt,3,false);
+            result.w = HD_get_triangulation_depth(l1_q2,q2,C_src,C_tgt,
+                                                  RtKinv_src,r_stride,RtKinv_tgt,3,false);
+        }
+
+        return result;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // per NUMA node copies of the segment data, allocated and filled by a
+    // thread of the node (first touch), threads of a team read their node's copy
+    // (nodes without a copy, e.g. a smaller team than requested, read the shared data)
+    class L3DMatchingReplicas
+    {
+    public:
+        L3DMatchingReplicas(L3D::DataArray<float>* segments_src,
+                            L3D::DataArray<float4>* segments_tgt,
+                            const int threads) : threads_(threads),
+            shared_src_(segments_src), shared_tgt_(segments_tgt)
+        {
+            const L3DNumaTopology& numa = L3DNumaTopology::system();
+            src_.assign(numa.numNodes(),NULL);
+            tgt_.assign(numa.numNodes(),NULL);
+
+            #pragma omp parallel num_threads(threads)
+            {
+                int t = cpu_thread_id();
+                unsigned int n = numa.nodeOfThread(t,threads_);
+                if(t == 0 || numa.nodeOfThread(t-1,threads_) != n)
+                {
+                    // first thread of the node
+                    L3DNodePin pin(n);
+                    src_[n] = new L3D::DataArray<float>(segments_src->width(),segments_src->height());
+                    segments_src->copyTo(src_[n]);
+                    tgt_[n] = new L3D::DataArray<float4>(segments_tgt->width(),segments_tgt->height());
+                    segments_tgt->copyTo(tgt_[n]);
+                }
+            }
+        }
+
+        ~L3DMatchingReplicas()
+        {
+            for(unsigned int n=0; n<src_.size(); ++n)
+            {
+                delete src_[n];
+                delete tgt_[n];
+            }
+        }
+
+        // node of the calling thread (inside a team of the same size)
+        unsigned int node() const {
+            return L3DNumaTopology::system().nodeOfThread(cpu_thread_id(),threads_);
+        }
+
+        L3D::DataArray<float>* src(const unsigned int node){
+            return (node < src_.size() && src_[node] != NULL) ? src_[node] : shared_src_;
+        }
+        L3D::DataArray<float4>* tgt(const unsigned int node){
+            return (node < tgt_.size() && tgt_[node] != NULL) ? tgt_[node] : shared_tgt_;
+        }
+
+    private:
+        int threads_;
+        L3D::DataArray<float>* shared_src_;
+        L3D::DataArray<float4>* shared_tgt_;
+        std::vector<L3D::DataArray<float>*> src_;
+        std::vector<L3D::DataArray<float4>*> tgt_;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // same as K_verify_matches (depth prior resolved at compile time)
+    template<bool DEPTH_PRIOR>
+    void cpu_verify_matches(const std::vector<L3D::L3DMatchingPair>& raw,
+                            const std::vector<int2>& matchOffset,
+                            L3D::DataArray<float>* segments_src,
+                            L3D::DataArray<float4>* segments_tgt,
+                            L3D::DataArray<int2>* offsets,
+                            const float* RtKinv, const int r_stride,
+                            const std::vector<float>& P, const float3 camCenter_src,
+                            const float sigma_p, const float sigma_a,
+                            const float spatial_k, const int threads,
+                            L3DMatchingReplicas* replicas,
+                            const std::vector<int2>& tasks,
+                            std::vector<double>& busy_ms,
+                            std::vector<float>& confidences)
+    {
+        #pragma omp parallel num_threads(threads)
+        {
+            L3D_TRACE_ZONE("matches:verify (thread)");
+
+            // NUMA: pinned, node local segment data
+            unsigned int node = (replicas != NULL) ? replicas->node() : 0;
+            L3DNodePin pin(node,replicas != NULL);
+            L3D::DataArray<float>* seg_src = (replicas != NULL) ? replicas->src(node) : segments_src;
+            L3D::DataArray<float4>* seg_tgt = (replicas != NULL) ? replicas->tgt(node) : segments_tgt;
+
+            L3D::L3DTimer timer;
+            double busy = 0.0;
+
+            // hypothesis ranges of about equal cost
+            #pragma omp for schedule(dynamic,1) nowait
+            for(int t=0; t<int(tasks.size()); ++t)
+            {
+                timer.start();
+                for(int y=tasks[t].x; y<tasks[t].y; ++y)
+                {
+                    int srcID = raw[y].segID1_;
+                    int camID = raw[y].camID2_;
+
+                    // segment data
+                    const float* src = seg_src->dataCPU(0,srcID);
+                    float3 p1 = make_float3(src[0],src[1],1.0f);
+                    float3 p2 = make_float3(src[2],src[3],1.0f);
+
+                    // unproject
+                    float3 P1 = HD_unproject_point(p1,camCenter_src,raw[y].depths_.x,RtKinv,r_stride);
+                    float3 P2 = HD_unproject_point(p2,camCenter_src,raw[y].depths_.y,RtKinv,r_stride);
+
+                    // iterate over matches
+                    int start = matchOffset[srcID].x;
+                    int end = start+matchOffset[srcID].y;
+
+                    float confidence = 0.0f;
+
+                    int current_cam = -1;
+                    float current_confidence = 0.0f;
+
+                    for(int i=start; i<end; ++i)
+                    {
+                        if(i == y)
+                            continue;
+
+                        // match data
+                        int camID2 = raw[i].camID2_;
+                        int tgtID2 = raw[i].segID2_;
+                        int camFeatureOffset = offsets->dataCPU(camID2,0)[0].x;
+
+                        // unproject
+                        float3 Q1 = HD_unproject_point(p1,camCenter_src,raw[i].depths_.x,RtKinv,r_stride);
+                        float3 Q2 = HD_unproject_point(p2,camCenter_src,raw[i].depths_.y,RtKinv,r_stride);
+
+                        if(camID2 == camID)
+                            continue;
+
+                        if(camID2 != current_cam)
+                        {
+                            // update score
+                            if(current_cam != -1)
+                            {
+                                confidence += current_confidence;
+                            }
+
+                            current_confidence = 0.0f;
+                            current_cam = camID2;
+                        }
+
+                        // 2D confidence
+                        float3 proj1 = HD_project_point(P1,&P[camID2*12],4);
+                        float3 proj2 = HD_project_point(P2,&P[camID2*12],4);
+
+                        if(int(proj1.z) == 1 && int(proj2.z) == 1)
+                        {
+                            float4 data = target_segment(seg_tgt,tgtID2+camFeatureOffset);
+                            float3 q1 = make_float3(data.x,data.y,1.0f);
+                            float3 q2 = make_float3(data.z,data.w,1.0f);
+
+                            float conf = HD_hypothesis_confidence<DEPTH_PRIOR>(proj1,proj2,q1,q2,P1,P2,Q1,Q2,
+                                                                               camCenter_src,sigma_p,sigma_a,
+                                                                               spatial_k);
+
+                            if(conf > 0.5f)
+                            {
+                                // confidence
+                                if(conf > current_confidence)
+                                    current_confidence = conf;
+                            }
+                        }
+                    }
+
+                    // update once more
+                    confidence += current_confidence;
+
+                    // store confidence
+                    confidences[y] = confidence;
+                }
+                busy += timer.elapsedMS();
+            }
+
+            busy_ms[cpu_thread_id()] += busy;
+        }
+    }
+
+    /// EXTERNAL FUNCTIONS
+    ////////////////////////////////////////////////////////////////////////////////
+    void compute_collinearity_cpu(L3D::DataArray<float>* segments,
+                                  L3D::DataArray<float>* relation,
+                                  const float collin_s,
+                                  const int num_threads)
+    {
+        int size = segments->height();
+        float coll_sigma_sqr = collin_s*collin_s;
+
+        #pragma omp parallel for schedule(dynamic,16) num_threads(cpu_num_threads(num_threads))
+        for(int y=0; y<size; ++y)
+        {
+            const float* seg2 = segments->dataCPU(0,y);
+            relation->dataCPU(y,y)[0] = 0.0f;
+
+            for(int x=0; x<y; ++x)
+            {
+                float result = cpu_collinearity(segments->dataCPU(0,x),seg2,
+                                                coll_sigma_sqr);
+
+                relation->dataCPU(x,y)[0] = result;
+                relation->dataCPU(y,x)[0] = result;
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    void compute_collinearity_cpu_indexed(L3D::DataArray<float>* segments,
+                                          const float collin_s,
+                                          const int num_threads,
+                                          std::map<unsigned int,std::map<unsigned int,float> >& collinearities)
+    {
+        int size = segments->height();
+        float coll_sigma_sqr = collin_s*collin_s;
+
+        // max. point to line distance with an affinity above L3D_COLLIN_AFF_T_G
+        double d_max = 1.01*collin_s*sqrt(-2.0*log(L3D_COLLIN_AFF_T_G))+1e-3;
+
+        // orientation and length
+        std::vector<std::pair<double,int> > orientation(size);
+        std::vector<double> length(size);
+        for(int i=0; i<size; ++i)
+        {
+            const float* s = segments->dataCPU(0,i);
+            double dx = s[2]-s[0];
+            double dy = s[3]-s[1];
+            orientation[i] = std::pair<double,int>(cpu_angle_mod_pi(atan2(dy,dx)),i);
+            length[i] = sqrt(dx*dx+dy*dy);
+        }
+        std::sort(orientation.begin(),orientation.end());
+
+        std::vector<double> angles(size);
+        for(int i=0; i<size; ++i)
+            angles[i] = orientation[i].first;
+
+        int threads = cpu_num_threads(num_threads);
+        std::vector<std::vector<std::pair<int,int> > > pairs(size);
+        std::vector<std::vector<float> > scores(size);
+
+        #pragma omp parallel for schedule(dynamic,64) num_threads(threads)
+        for(int x=0; x<size; ++x)
+        {
+            const float* seg1 = segments->dataCPU(0,x);
+            float3 p1 = make_float3(seg1[0],seg1[1],1.0f);
+            float3 p2 = make_float3(seg1[2],seg1[3],1.0f);
+            float3 line1 = cross(p1,p2);
+            double theta = cpu_angle_mod_pi(atan2(double(seg1[3]-seg1[1]),double(seg1[2]-seg1[0])));
+
+            // both endpoints within d_max of the other line --> |sin(dtheta)|*length <= 2*d_max
+            double w = (2.0*d_max >= length[x]) ? M_PI : asin(2.0*d_max/length[x])+1e-3;
+
+            // orientation window (wraps around at pi)
+            std::vector<std::pair<int,int> > ranges;
+            if(w >= 0.5*M_PI)
+            {
+                ranges.push_back(std::pair<int,int>(0,size));
+            }
+            else
+            {
+                double lo = theta-w;
+                double hi = theta+w;
+                if(lo < 0.0)
+                {
+                    ranges.push_back(std::pair<int,int>(std::lower_bound(angles.begin(),angles.end(),lo+M_PI)-angles.begin(),size));
+                    lo = 0.0;
+                }
+                if(hi >= M_PI)
+                {
+                    ranges.push_back(std::pair<int,int>(0,std::upper_bound(angles.begin(),angles.end(),hi-M_PI)-angles.begin()));
+                    hi = M_PI;
+                }
+                ranges.push_back(std::pair<int,int>(std::lower_bound(angles.begin(),angles.end(),lo)-angles.begin(),
+                                                    std::upper_bound(angles.begin(),angles.end(),hi)-angles.begin()));
+            }
+
+            for(unsigned int r=0; r<ranges.size(); ++r)
+            {
+                for(int k=ranges[r].first; k<ranges[r].second; ++k)
+                {
+                    int y = orientation[k].second;
+                    if(y <= x)
+                        continue;
+
+                    // midpoint has to be close to the line as well
+                    const float* seg2 = segments->dataCPU(0,y);
+                    float3 m = make_float3(0.5f*(seg2[0]+seg2[2]),0.5f*(seg2[1]+seg2[3]),1.0f);
+                    if(HD_distance_p2l_2D_f3(line1,m) > d_max)
+                        continue;
+
+                    float result = cpu_collinearity(seg1,seg2,coll_sigma_sqr);
+                    if(result > 0.0f)
+                    {
+                        pairs[x].push_back(std::pair<int,int>(x,y));
+                        scores[x].push_back(result);
+                    }
+                }
+            }
+        }
+
+        // merge (in order)
+        for(int x=0; x<size; ++x)
+        {
+            for(unsigned int k=0; k<pairs[x].size(); ++k)
+            {
+                collinearities[pairs[x][k].first][pairs[x][k].second] = scores[x][k];
+                collinearities[pairs[x][k].second][pairs[x][k].first] = scores[x][k];
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    unsigned int merge_segment_fragments_cpu(std::vector<float4>& segments,
+                                             const float max_angle,
+                                             const float max_offset,
+                                             const float max_gap,
+                                             const unsigned int max_passes)
+    {
+        unsigned int num_merged = 0;
+        for(unsigned int pass=0; pass<max_passes; ++pass)
+        {
+            int size = segments.size();
+
+            // orientation (sorted) and length rank
+            std::vector<std::pair<double,int> > orientation(size);
+            std::vector<std::pair<double,int> > by_length(size);
+            for(int i=0; i<size; ++i)
+            {
+                double dx = segments[i].z-segments[i].x;
+                double dy = segments[i].w-segments[i].y;
+                orientation[i] = std::pair<double,int>(cpu_angle_mod_pi(atan2(dy,dx)),i);
+                by_length[i] = std::pair<double,int>(-sqrt(dx*dx+dy*dy),i);
+            }
+            std::sort(orientation.begin(),orientation.end());
+            std::sort(by_length.begin(),by_length.end());
+
+            std::vector<double> angles(size);
+            for(int i=0; i<size; ++i)
+                angles[i] = orientation[i].first;
+
+            std::vector<int> rank(size);
+            for(int i=0; i<size; ++i)
+                rank[by_length[i].second] = i;
+
+            // longer segments absorb shorter ones (the longer one defines the line)
+            std::vector<bool> removed(size,false);
+            unsigned int merged_in_pass = 0;
+            for(int r=0; r<size; ++r)
+            {
+                int x = by_length[r].second;
+                if(removed[x])
+                    continue;
+
+                double px = segments[x].x;
+                double py = segments[x].y;
+                double len = -by_length[r].first;
+                if(len < L3D_EPS_G)
+                    continue;
+
+                double dx = (segments[x].z-px)/len;
+                double dy = (segments[x].w-py)/len;
+                double theta = cpu_angle_mod_pi(atan2(dy,dx));
+
+                // orientation window (wraps around at pi)
+                std::vector<std::pair<int,int> > ranges;
+                double lo = theta-max_angle;
+                double hi = theta+max_angle;
+                if(lo < 0.0)
+                {
+                    ranges.push_back(std::pair<int,int>(std::lower_bound(angles.begin(),angles.end(),lo+M_PI)-angles.begin(),size));
+                    lo = 0.0;
+                }
+                if(hi >= M_PI)
+                {
+                    ranges.push_back(std::pair<int,int>(0,std::upper_bound(angles.begin(),angles.end(),hi-M_PI)-angles.begin()));
+                    hi = M_PI;
+                }
+                ranges.push_back(std::pair<int,int>(std::lower_bound(angles.begin(),angles.end(),lo)-angles.begin(),
+                                                    std::upper_bound(angles.begin(),angles.end(),hi)-angles.begin()));
+
+                // extent along the line (grows with every merge --> rescan)
+                double t_min = 0.0;
+                double t_max = len;
+                bool grown = true;
+                while(grown)
+                {
+                    grown = false;
+                    for(unsigned int w=0; w<ranges.size(); ++w)
+                    {
+                        for(int k=ranges[w].first; k<ranges[w].second; ++k)
+                        {
+                            int y = orientation[k].second;
+                            if(removed[y] || rank[y] <= r)
+                                continue;
+
+                            // normal offset of both endpoints
+                            double ax = segments[y].x-px;
+                            double ay = segments[y].y-py;
+                            double bx = segments[y].z-px;
+                            double by = segments[y].w-py;
+                            if(fabs(ax*dy-ay*dx) > max_offset || fabs(bx*dy-by*dx) > max_offset)
+                                continue;
+
+                            // gap along the line
+                            double ta = ax*dx+ay*dy;
+                            double tb = bx*dx+by*dy;
+                            double f_min = std::min(ta,tb);
+                            double f_max = std::max(ta,tb);
+                            if(f_min-t_max > max_gap || t_min-f_max > max_gap)
+                                continue;
+
+                            if(f_min < t_min || f_max > t_max)
+                                grown = true;
+
+                            t_min = std::min(t_min,f_min);
+                            t_max = std::max(t_max,f_max);
+                            removed[y] = true;
+                            ++merged_in_pass;
+                        }
+                    }
+                }
+
+                if(t_min < 0.0 || t_max > len)
+                {
+                    segments[x] = make_float4(px+t_min*dx,py+t_min*dy,
+                                              px+t_max*dx,py+t_max*dy);
+                }
+            }
+
+            if(merged_in_pass == 0)
+                break;
+
+            // compact
+            std::vector<float4> remaining;
+            remaining.reserve(size-merged_in_pass);
+            for(int i=0; i<size; ++i)
+            {
+                if(!removed[i])
+                    remaining.push_back(segments[i]);
+            }
+            segments.swap(remaining);
+            num_merged += merged_in_pass;
+        }
+        return num_merged;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    void compute_pairwise_matches_cpu(L3D::DataArray<float>* segments_src,
+                                      L3D::DataArray<float>* RtKinv_src,
+                                      L3D::DataArray<float4>* segments_tgt,
+                                      L3D::DataArray<float>* RtKinv_tgt,
+                                      L3D::DataArray<float>* camCenters_tgt,
+                                      const float3 camCenter_src,
+                                      L3D::DataArray<float>* fundamentals,
+                                      L3D::DataArray<float>* projections,
+                                      L3D::DataArray<int2>* offsets,
+                                      std::list<unsigned int>& toBeMatched,
+                                      std::list<L3D::L3DMatchingPair>& matches,
+                                      std::map<unsigned int,unsigned int>& local2global,
+                                      const unsigned int vID,
+                                      const float uncertainty_k_upper,
+                                      const float uncertainty_k_lower,
+                                      const float sigma_p, const float sigma_a,
+                                      const float spatial_k, float& median_depth,
+                                      unsigned int& num_raw_matches,
+                                      const unsigned int max_hypotheses,
+                                      const L3D::L3DRegionOfInterest* roi,
+                                      const int num_threads,
+                                      const bool verbose, const std::string prefix,
+                                      const int index_min_segments,
+                                      const bool numa_aware,
+                                      L3D::DataArray<int>* classes_src,
+                                      L3D::DataArray<int>* classes_tgt,
+                                      L3D::L3DLoadBalance* balance,
+                                      const unsigned int tasks_per_thread,
+                                      unsigned long long* num_skipped)
+    {
+        num_raw_matches = 0;
+        if(num_skipped != NULL)
+            *num_skipped = 0;
+
+        if(toBeMatched.size() == 0)
+            return;
+
+        // init
+        int threads = cpu_num_threads(num_threads);
+        int height = segments_src->height();
+        unsigned int num_cams = offsets->width();
+        const float* RtKinv = RtKinv_src->dataCPU(0,0);
+        int r_stride = RtKinv_src->strideCPU();
+
+        // dense camera data (per local ID)
+        std::vector<float> F(num_cams*9);
+        std::vector<float> RtKinvs(num_cams*9);
+        std::vector<float> P(num_cams*12);
+        std::vector<float3> centers(num_cams);
+        for(unsigned int i=0; i<num_cams; ++i)
+        {
+            cpu_copy_matrix(fundamentals,i*3,3,3,&F[i*9]);
+            cpu_copy_matrix(RtKinv_tgt,i*3,3,3,&RtKinvs[i*9]);
+            cpu_copy_matrix(projections,i*3,3,4,&P[i*12]);
+            centers[i] = make_float3(camCenters_tgt->dataCPU(0,i)[0],
+                                     camCenters_tgt->dataCPU(1,i)[0],
+                                     camCenters_tgt->dataCPU(2,i)[0]);
+        }
+
+        // NUMA: segment data per node, pinned threads
+        L3DMatchingReplicas* replicas = NULL;
+        if(numa_aware && L3DNumaTopology::system().available() && threads > 1)
+            replicas = new L3DMatchingReplicas(segments_src,segments_tgt,threads);
+
+        // neighbors (local IDs, target ranges)
+        std::vector<unsigned int> neighbors(toBeMatched.begin(),toBeMatched.end());
+        unsigned int num_neighbors = neighbors.size();
+        std::vector<int> feature_offsets(num_neighbors);
+        std::vector<int> widths(num_neighbors);
+        for(unsigned int n=0; n<num_neighbors; ++n)
+        {
+            if(verbose)
+                std::cout << prefix << "[" << vID << "] <--> [" << local2global[neighbors[n]] << "]" << std::endl;
+
+            feature_offsets[n] = offsets->dataCPU(neighbors[n],0)[0].x;
+            widths[n] = offsets->dataCPU(neighbors[n],0)[0].y;
+        }
+
+        // epipolar indices (many target segments), built in parallel
+        std::vector<L3DEpipolarIndex*> indices(num_neighbors,(L3DEpipolarIndex*)NULL);
+        #pragma omp parallel for schedule(dynamic,1) num_threads(threads)
+        for(int n=0; n<int(num_neighbors); ++n)
+        {
+            if(index_min_segments >= 0 && widths[n] >= index_min_segments)
+            {
+                L3DEpipolarIndex* index = new L3DEpipolarIndex(segments_tgt,feature_offsets[n],widths[n],
+                                                               &F[neighbors[n]*9]);
+                if(index->valid())
+                    indices[n] = index;
+                else
+                    delete index;
+            }
+        }
+
+        // tasks: source row ranges per neighbor, heavy pairs are split into
+        // more ranges (about tasks_per_thread tasks per thread)
+        double total_cost = 0.0;
+        for(unsigned int n=0; n<num_neighbors; ++n)
+            total_cost += double(height)*double(widths[n]);
+
+        double task_cost = total_cost/double(threads*std::max(tasks_per_thread,1u));
+        std::vector<L3DMatchingTask> tasks;
+        for(unsigned int n=0; n<num_neighbors && height>0; ++n)
+        {
+            double cost = double(height)*double(widths[n]);
+            int num_ranges = (task_cost > 0.0) ? int(ceil(cost/task_cost)) : 1;
+            num_ranges = std::max(std::min(num_ranges,height),1);
+            int rows = (height+num_ranges-1)/num_ranges;
+            for(int begin=0; begin<height; begin+=rows)
+            {
+                L3DMatchingTask task;
+                task.neighbor_ = n;
+                task.begin_ = begin;
+                task.end_ = std::min(begin+rows,height);
+                task.cost_ = double(task.end_-task.begin_)*double(widths[n]);
+                tasks.push_back(task);
+            }
+        }
+        std::sort(tasks.begin(),tasks.end(),cpu_sort_tasks);
+
+        // rows are processed independently, merged in order (per neighbor)
+        std::vector<std::vector<std::list<L3D::L3DMatchingPair> > > row_matches(num_neighbors);
+        for(unsigned int n=0; n<num_neighbors; ++n)
+            row_matches[n].resize(height);
+
+        std::vector<double> busy_ms(threads,0.0);
+        std::vector<unsigned long long> skipped(threads,0);
+
+        L3D_TRACE_BEGIN(pairwise);
+        #pragma omp parallel num_threads(threads)
+        {
+            // nowait: the zone ends when the thread runs out of tasks
+            L3D_TRACE_ZONE("matches:pairwise (thread)");
+
+            unsigned int node = (replicas != NULL) ? replicas->node() : 0;
+            L3DNodePin pin(node,replicas != NULL);
+            L3D::DataArray<float>* seg_src = (replicas != NULL) ? replicas->src(node) : segments_src;
+            L3D::DataArray<float4>* seg_tgt = (replicas != NULL) ? replicas->tgt(node) : segments_tgt;
+
+            std::vector<int> seen;
+            std::vector<int> candidates;
+            int seen_neighbor = -1;
+
+            L3D::L3DTimer timer;
+            double busy = 0.0;
+            unsigned long long skipped_local = 0;
+
+            #pragma omp for schedule(dynamic,1) nowait
+            for(int t=0; t<int(tasks.size()); ++t)
+            {
+                timer.start();
+
+                unsigned int n = tasks[t].neighbor_;
+                unsigned int localID = neighbors[n];
+                int feature_offset = feature_offsets[n];
+                int width = widths[n];
+                L3DEpipolarIndex* index = indices[n];
+
+                // rows are unique per neighbor --> reset only when it changes
+                if(index != NULL && seen_neighbor != int(n))
+                {
+                    seen.assign(width,-1);
+                    seen_neighbor = n;
+                }
+
+                for(int i=tasks[t].begin_; i<tasks[t].end_; ++i)
+                {
+                    // line src
+                    const float* src = seg_src->dataCPU(0,i);
+                    float3 p1 = make_float3(src[0],src[1],1.0f);
+                    float3 p2 = make_float3(src[2],src[3],1.0f);
+
+                    if(index != NULL)
+                        index->candidates(p1,p2,i,seen,candidates);
+
+                    int class_src = (classes_src != NULL) ? segment_class(classes_src,i) : L3D_CLASS_ANY;
+
+                    int num_candidates = (index != NULL) ? int(candidates.size()) : width;
+                    for(int c=0; c<num_candidates; ++c)
+                    {
+                        int j = (index != NULL) ? candidates[c] : c;
+
+                        // no common direction class
+                        if(classes_tgt != NULL && (class_src & segment_class(classes_tgt,feature_offset+j)) == 0)
+                        {
+                            ++skipped_local;
+                            continue;
+                        }
+
+                        // line tgt
+                        float4 data = target_segment(seg_tgt,feature_offset+j);
+                        float3 q1 = make_float3(data.x,data.y,1.0f);
+                        float3 q2 = make_float3(data.z,data.w,1.0f);
+
+                        float4 depths = cpu_pairwise_match(p1,p2,q1,q2,&F[localID*9],
+                                                           RtKinv,r_stride,&RtKinvs[localID*9],
+                                                           camCenter_src,centers[localID]);
+
+                        if(depths.x > 0.0f && depths.y > 0.0f && depths.z > 0.0f && depths.w > 0.0f)
+                        {
+                            // potential match
+                            L3D::L3DMatchingPair mp;
+                            mp.segID1_ = i;
+                            mp.segID2_ = j;
+                            mp.camID2_ = localID;
+                            mp.depths_ = depths;
+                            mp.active_ = true;
+                            mp.confidence_ = 0.0f;
+                            row_matches[n][i].push_back(mp);
+                        }
+                    }
+                }
+
+                busy += timer.elapsedMS();
+            }
+
+            busy_ms[cpu_thread_id()] += busy;
+            skipped[cpu_thread_id()] += skipped_local;
+        }
+        L3D_TRACE_END(pairwise,"matches:pairwise");
+
+        if(num_skipped != NULL)
+        {
+            for(int t=0; t<threads; ++t)
+                *num_skipped += skipped[t];
+        }
+
+        for(unsigned int n=0; n<num_neighbors; ++n)
+        {
+            delete indices[n];
+            for(int i=0; i<height; ++i)
+                matches.splice(matches.end(),row_matches[n][i]);
+        }
+
+        if(balance != NULL)
+            balance->add(busy_ms,tasks.size());
+
+        // verify matches (sort first!)
+        L3D_TRACE_BEGIN(sort);
+        matches.sort(L3D::sortMatchingPairs);
+        L3D_TRACE_END(sort,"matches:sort");
+        num_raw_matches = matches.size();
+        if(verbose)
+            std::cout << prefix << "#raw_matches:          " << matches.size() << std::endl;
+
+        if(roi != NULL && roi->hasRegion())
+        {
+            unsigned int removed = filter_hypotheses_roi(matches,segments_src,RtKinv_src,
+                                                         camCenter_src,roi);
+            if(verbose)
+                std::cout << prefix << "#outside_roi:          " << removed << std::endl;
+        }
+
+        if(matches.size() == 0)
+        {
+            delete replicas;
+            return;
+        }
+
+        std::vector<L3D::L3DMatchingPair> raw(matches.begin(),matches.end());
+        std::vector<int2> matchOffset(height,make_int2(-1,-1));
+        for(unsigned int pos=0; pos<raw.size(); ++pos)
+        {
+            int segID = raw[pos].segID1_;
+            if(matchOffset[segID].x < 0)
+                matchOffset[segID] = make_int2(pos,0);
+
+            ++matchOffset[segID].y;
+        }
+
+        // same as K_verify_matches
+        std::vector<float> confidences(raw.size(),0.0f);
+
+        // tasks: hypothesis ranges of about equal cost (a hypothesis is checked
+        // against all hypotheses of its segment --> heavy segments are split)
+        std::vector<double> cost_prefix(raw.size()+1,0.0);
+        for(unsigned int pos=0; pos<raw.size(); ++pos)
+            cost_prefix[pos+1] = cost_prefix[pos]+double(matchOffset[raw[pos].segID1_].y);
+
+        std::vector<int2> verify_tasks;
+        cpu_split_ranges(cost_prefix,threads*std::max(tasks_per_thread,1u),verify_tasks);
+        std::vector<double> verify_busy_ms(threads,0.0);
+
+        L3D_TRACE_BEGIN(verify);
+        if(spatial_k > 0.0f)
+        {
+            cpu_verify_matches<true>(raw,matchOffset,segments_src,segments_tgt,offsets,
+                                     RtKinv,r_stride,P,camCenter_src,sigma_p,sigma_a,
+                                     spatial_k,threads,replicas,verify_tasks,
+                                     verify_busy_ms,confidences);
+        }
+        else
+        {
+            cpu_verify_matches<false>(raw,matchOffset,segments_src,segments_tgt,offsets,
+                                      RtKinv,r_stride,P,camCenter_src,sigma_p,sigma_a,
+                                      spatial_k,threads,replicas,verify_tasks,
+                                      verify_busy_ms,confidences);
+        }
+        L3D_TRACE_END(verify,"matches:verify");
+        delete replicas;
+
+        if(balance != NULL)
+            balance->add(verify_busy_ms,verify_tasks.size());
+
+        matches.clear();
+
+        L3D_TRACE_BEGIN(filter);
+        std::vector<float> depths;
+        float conf_t = 1.00f;
+        unsigned int num_valid = 0;
+        for(int i=0; i<height; ++i)
+        {
+            int start = matchOffset[i].x;
+            int end = start + matchOffset[i].y;
+
+            if(start >= 0)
+            {
+                float max_conf = 0.0f;
+
+                float depth_s1 = 0.0f;
+                float depth_s2 = 0.0f;
+
+                for(int k=start; k<end; ++k)
+                {
+                    float conf = confidences[k];
+
+                    if(conf > conf_t)
+                        ++num_valid;
+
+                    if(conf > max_conf)
+                    {
+                        max_conf = conf;
+
+                        depth_s1 = raw[k].depths_.x;
+                        depth_s2 = raw[k].depths_.y;
+                    }
+                }
+
+                if(max_conf > conf_t/2.0f)
+                {
+                    depths.push_back(depth_s1);
+                    depths.push_back(depth_s2);
+                }
+            }
+        }
+
+        median_depth = -1.0f;
+        float median_reg_upper = 0.0f;
+        float median_reg_lower = 0.0f;
+        if(depths.size() > 0)
+        {
+            std::sort(depths.begin(),depths.end());
+            median_depth = depths[depths.size()/2];
+
+            median_reg_upper = median_depth*uncertainty_k_upper;
+            median_reg_lower = median_depth*uncertainty_k_lower;
+        }
+
+        if(verbose)
+            std::cout << prefix << "#filtered_matches (1): " << num_valid << std::endl;
+
+        if(verbose)
+            std::cout << prefix << "spatial_reg:           " << median_reg_lower << " - " << median_reg_upper << " (@depth: " << median_depth << ")" << std::endl;
+
+        // store result
+        float confidence_norm = 2.0f;
+        for(unsigned int i=0; i<raw.size(); ++i)
+        {
+            float conf = confidences[i];
+            if(conf > conf_t)
+            {
+                conf /= confidence_norm;
+
+                L3D::L3DMatchingPair mp = raw[i];
+                mp.camID2_ = local2global[raw[i].camID2_];
+                mp.confidence_ = conf;
+                mp.active_ = true;
+                matches.push_back(mp);
+            }
+        }
+
+        if(max_hypotheses > 0)
+            cap_hypotheses(matches,max_hypotheses);
+        L3D_TRACE_END(filter,"matches:filter");
+
+        if(verbose)
+        {
+            std::cout << prefix << "#filtered_matches (2): " << matches.size() << std::endl;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // same as K_sparseMat_row_normalization
+    void cpu_sparse_row_normalization(L3D::SparseMatrix* M, const int threads)
+    {
+        float4* data = M->entries()->dataCPU();
+        const int* start_indices = M->start_indices()->dataCPU();
+        int num_rows = M->num_rows_cols();
+        int num_entries = M->num_entries();
+
+        #pragma omp parallel for schedule(dynamic,64) num_threads(threads)
+        for(int y=0; y<num_rows; ++y)
+        {
+            int start = start_indices[y];
+
+            if(start < 0)
+                continue;
+
+            // compute sum
+            float sum = 0.0f;
+            int i = start;
+            while(i < num_entries && int(data[i].x) == y)
+            {
+                sum += data[i].z;
+                ++i;
+            }
+
+            // check for precision errors
+            if(sum < L3D_EPS_G)
+                sum = L3D_EPS_G;
+
+            // normalize
+            i = start;
+            while(i < num_entries && int(data[i].x) == y)
+            {
+                data[i].z /= sum;
+                ++i;
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // same as K_sparseMat_diffusion_step
+    void cpu_sparse_diffusion_step(L3D::SparseMatrix* P, L3D::SparseMatrix* W,
+                                   L3D::SparseMatrix* P_prime, const int threads)
+    {
+        const float4* P_data = P->entries()->dataCPU();
+        const float4* W_data = W->entries()->dataCPU();
+        const int* P_rows = P->start_indices()->dataCPU();
+        const int* W_cols = W->start_indices()->dataCPU();
+        float4* P_prime_data = P_prime->entries()->dataCPU();
+        const int* P_prime_rows = P_prime->start_indices()->dataCPU();
+        int num_entries = P->num_entries();
+
+        #pragma omp parallel for schedule(static) num_threads(threads)
+        for(int y=0; y<num_entries; ++y)
+        {
+            // get data
+            float4 data = P_data[y];
+
+            // transpose
+            int r = data.y;
+            int c = data.x;
+
+            // row[P]*col[W]
+            float mul = 0.0f;
+            int start_P = P_rows[r];
+            int start_W = W_cols[c];
+            while(start_P >= 0 && start_W >= 0 &&
+                  start_P < num_entries && start_W < num_entries)
+            {
+                float4 d1 = P_data[start_P];
+                float4 d2 = W_data[start_W];
+
+                int row1 = d1.x;
+                int col2 = d2.y;
+
+                if(row1 != r || col2 != c)
+                    break;
+
+                mul += (d1.z*d2.z);
+                ++start_P;
+                ++start_W;
+            }
+
+            // multiply with transposed
+            mul *= data.z;
+
+            if(mul < L3D_EPS_G)
+                mul = L3D_EPS_G;
+
+            // store
+            int s = P_prime_rows[r];
+            while(s >= 0 && s < num_entries)
+            {
+                int row = P_prime_data[s].x;
+                int col = P_prime_data[s].y;
+
+                if(row != r)
+                    break;
+
+                if(col == c)
+                {
+                    P_prime_data[s].z = mul;
+                    break;
+                }
+
+                ++s;
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    void replicator_dynamics_diffusion_cpu(L3D::SparseMatrix* &W,
+                                           const int num_threads,
+                                           const bool verbose,
+                                           const std::string prefix)
+    {
+        if(W->num_entries() == 0)
+            return;
+
+        int threads = cpu_num_threads(num_threads);
+
+        // create P matrix
+        L3D::SparseMatrix* P = new L3D::SparseMatrix(W,true,false);
+
+        // make copy of P
+        L3D::SparseMatrix* P_prime = new L3D::SparseMatrix(P,false,false);
+
+        // row normalize
+        cpu_sparse_row_normalization(P,threads);
+
+        for(int i=0; i<L3D_RDD_MAX_ITER; ++i)
+        {
+            // diffusion
+            if(verbose)
+                std::cout << prefix << "iteration: " << i << std::endl;
+
+            // update
+            cpu_sparse_diffusion_step(P,W,P_prime,threads);
+
+            // row normalize
+            L3D::SparseMatrix* tmp = P;
+            P = P_prime;
+            P_prime = tmp;
+
+            if(i < L3D_RDD_MAX_ITER-1)
+                cpu_sparse_row_normalization(P,threads);
+        }
+
+        // re-assign
+        delete W;
+        W = P;
+
+        delete P_prime;
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef I3D_LINE3D_CPUWRAPPER_H_
+#define I3D_LINE3D_CPUWRAPPER_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// internal
+#include "sparsematrix.h"
+#include "dataArray.h"
+#include "geometry.h"
+#include "roi.h"
+#include "timer.h"
+
+// std
+#include <map>
+#include <vector>
+#include <list>
+#include <string>
+
+/**
+ * Line3D - CPU Backend
+ * ====================
+ * OpenMP implementations of the CUDA functions
+ * (cudawrapper.h), operating on the CPU data of
+ * the DataArrays only. Results are equivalent to
+ * the GPU versions (same geometric core).
+ * num_threads <= 0 --> all available cores.
+ * ====================
+ * Author: M.Hofer, 2015
+ */
+
+// epipolar index (matching)
+#define L3D_INDEX_MIN_SEGMENTS 512
+#define L3D_INDEX_BINS 2048
+#define L3D_INDEX_PAD 1e-3
+
+// load balancing (matching): tasks per thread (default, see tuning.h)
+#define L3D_TASKS_PER_THREAD 8
+
+namespace L3D
+{
+    // number of threads to use (num_threads <= 0 --> all cores)
+    extern int cpu_num_threads(const int num_threads);
+
+    // compute pairwise 2D line segment collinearity score
+    extern void compute_collinearity_cpu(L3D::DataArray<float>* segments,
+                                         L3D::DataArray<float>* relation,
+                                         const float collin_s,
+                                         const int num_threads);
+
+    // pairwise collinearity for many segments (sparse, same scores as the dense
+    // version): only pairs with compatible orientations (sorted) are tested
+    extern void compute_collinearity_cpu_indexed(L3D::DataArray<float>* segments,
+                                                 const float collin_s,
+                                                 const int num_threads,
+                                                 std::map<unsigned int,std::map<unsigned int,float> >& collinearities);
+
+    // merges nearly collinear, nearly touching fragments of the same edge
+    // (orientation sorted): a longer segment absorbs shorter ones whose
+    // endpoints are within max_offset of its line and whose gap along the
+    // line is at most max_gap, returns the number of removed fragments
+    extern unsigned int merge_segment_fragments_cpu(std::vector<float4>& segments,
+                                                    const float max_angle,
+                                                    const float max_offset,
+                                                    const float max_gap,
+                                                    const unsigned int max_passes);
+
+    // perform segment matching (targets with at least index_min_segments
+    // segments use an epipolar index, < 0 --> brute force; numa_aware: threads
+    // are pinned to the NUMA nodes and read node local copies of the segments;
+    // optional class masks: only pairs with a common class are tested;
+    // the work is split into (neighbor, source range) and hypothesis range
+    // tasks (about tasks_per_thread per thread), the busy time of the
+    // threads is added to balance; num_skipped: tested candidate pairs
+    // which are rejected by the class masks)
+    extern void compute_pairwise_matches_cpu(L3D::DataArray<float>* segments_src,
+                                             L3D::DataArray<float>* RtKinv_src,
+                                             L3D::DataArray<float4>* segments_tgt,
+                                             L3D::DataArray<float>* RtKinv_tgt,
+                                             L3D::DataArray<float>* camCenters_tgt,
+                                             const float3 camCenter_src,
+                                             L3D::DataArray<float>* fundamentals,
+                                             L3D::DataArray<float>* projections,
+                                             L3D::DataArray<int2>* offsets,
+                                             std::list<unsigned int>& toBeMatched,
+                                             std::list<L3D::L3DMatchingPair>& matches,
+                                             std::map<unsigned int,unsigned int>& local2global,
+                                             const unsigned int vID,
+                                             const float uncertainty_k_upper,
+                                             const float uncertainty_k_lower,
+                                             const float sigma_p, const float sigma_a,
+                                             const float spatial_k, float& median_depth,
+                                             unsigned int& num_raw_matches,
+                                             const unsigned int max_hypotheses,
+                                             const L3D::L3DRegionOfInterest* roi,
+                                             const int num_threads,
+                                             const bool verbose, const std::string prefix,
+                                             const int index_min_segments=L3D_INDEX_MIN_SEGMENTS,
+                                             const bool numa_aware=false,
+                                             L3D::DataArray<int>* classes_src=NULL,
+                                             L3D::DataArray<int>* classes_tgt=NULL,
+                                             L3D::L3DLoadBalance* balance=NULL,
+                                             const unsigned int tasks_per_thread=L3D_TASKS_PER_THREAD,
+                                             unsigned long long* num_skipped=NULL);
+
+    // replicator dynamics diffusion [M.Donoser, BMVC'13]
+    extern void replicator_dynamics_diffusion_cpu(L3D::SparseMatrix* &W,
+                                                  const int num_threads,
+                                                  const bool verbose,
+                                                  const std::string prefix);
+}
+
+#endif //I3D_LINE3D_CPUWRAPPER_H_
@@ -53,13 +53,6 @@ namespace L3D
         return make_float3(X.x,X.y,X.z);
     }
 
-    ////////////////////////////////////////////////////////////////////////////////
-    // Note: point needs to be normalized! (--> p.z == 1)
-    __device__ float D_distance_p2l_2D_f3(const float3 line, const float3 p)
-    {
-        return fabs((line.x*p.x+line.y*p.y+line.z)/sqrtf(line.x*line.x+line.y*line.y));
-    }
-
     ////////////////////////////////////////////////////////////////////////////////
     __device__ float D_distance_p2plane_3D_f3(const float3 n_plane, const float3 p_plane,
                                               const float3 p)
@@ -90,14 +83,6 @@ namespace L3D
        return result;
     }
 
-    ////////////////////////////////////////////////////////////////////////////////
-    // Note: points needs to be normalized! (--> p.z == 1)
-    __device__ float D_segment_length_2D_f3(const float3 p1, const float3 p2)
-    {
-        float3 v = p1-p2;
-        return sqrtf(v.x*v.x+v.y*v.y);
-    }
-
     ////////////////////////////////////////////////////////////////////////////////
     // Note: points needs to be normalized! (--> p.z == 1)
     __device__ float D_angle_between_lines_deg_2D_f3(const float3 p1, const float3 p2,
@@ -114,192 +99,27 @@ namespace L3D
         return angle;
     }
 
-    ////////////////////////////////////////////////////////////////////////////////
-    __device__ float D_angle_between_lines_deg_3D_f3(const float3 P1, const float3 P2,
-                                                     const float3 Q1, const float3 Q2)
-    {
-        float3 v1 = normalize(P1-P2);
-        float3 v2 = normalize(Q1-Q2);
-
-        float angle = acos(fmax(fmin(dot(v1,v2),1.0f),-1.0f))/CUDART_PI*180.0f;
-
-        if(angle > 90.0f)
-            angle = 180.0f-angle;
-
-        return angle;
-    }
-
-    ////////////////////////////////////////////////////////////////////////////////
-    // Note: points needs to be normalized! (--> p.z == 1),
-    // q needs to be collinear with p1 and p2!
-    __device__ bool D_point_on_segment_2D_f3(const float3 p1, const float3 p2,
-                                             const float3 q)
-    {
-        float2 v1 = make_float2(p1.x-q.x,p1.y-q.y);
-        float2 v2 = make_float2(p2.x-q.x,p2.y-q.y);
-        return (dot(v1,v2) < L3D_EPS_G);
-    }
-
     ////////////////////////////////////////////////////////////////////////////////
     __device__ float3 D_epipolar_line(const float3 p, const int camID,
                                       const bool transpose)
     {
-        float _p[3],_l[3];
-        _p[0] = p.x; _p[1] = p.y; _p[2] = p.z;
-        _l[0] = 0.0f; _l[1] = 0.0f; _l[2] = 0.0f;
-
-        for(int r=0; r<3; ++r)
-        {
-            for(int c=0; c<3; ++c)
-            {
-                if(!transpose)
-                    _l[r] += tex2D(tex_fundamentals,c+0.5f,float(camID*3+r)+0.5f)*_p[c];
-                else
-                    _l[r] += tex2D(tex_fundamentals,r+0.5f,float(camID*3+c)+0.5f)*_p[c];
-            }
-        }
-
-        return make_float3(_l[0],_l[1],_l[2]);
-    }
-
-    ////////////////////////////////////////////////////////////////////////////////
-    __device__ float D_segment_overlap_2D(const float3 src_p1, const float3 src_p2,
-                                          const float3 q1, const float3 q2)
-    {
-        /*
-        float len_src = D_segment_length_2D_f3(src_p1,src_p2);
-        float len_tgt = D_segment_length_2D_f3(q1,q2);
-
-        if(len_src < 1.0f || len_tgt < 1.0f)
-            return 0.0f;
-
-        if(D_point_on_segment_2D_f3(src_p1,src_p2,q1) &&
-           D_point_on_segment_2D_f3(src_p1,src_p2,q2))
-        {
-            // both target points within the ref segment
-            return len_tgt/len_src;
-        }
-        else if(D_point_on_segment_2D_f3(q1,q2,src_p1) &&
-                D_point_on_segment_2D_f3(q1,q2,src_p2))
-        {
-            // both source points within the tgt segment
-            return 1.0f;
-        }
-        else if(D_point_on_segment_2D_f3(src_p1,src_p2,q1))
-        {
-            // overlap exists
-            if(D_point_on_segment_2D_f3(q1,q2,src_p1))
-                return D_segment_length_2D_f3(q1,src_p1)/len_src;
-            else
-                return D_segment_length_2D_f3(q1,src_p2)/len_src;
-        }
-        else if(D_point_on_segment_2D_f3(src_p1,src_p2,q2))
-        {
-            // overlap exists
-            if(D_point_on_segment_2D_f3(q1,q2,src_p2))
-                return D_segment_length_2D_f3(q2,src_p2)/len_src;
-            else
-                return D_segment_length_2D_f3(q2,src_p1)/len_src;
-        }
-
-        // no overlap
-        return 0.0f;
-        */
-
-        float len_src = D_segment_length_2D_f3(src_p1,src_p2);
-        float len_tgt = D_segment_length_2D_f3(q1,q2);
-
-        if(len_src < 1.0f || len_tgt < 1.0f)
-            return 0.0f;
-
-        if(D_point_on_segment_2D_f3(src_p1,src_p2,q1) &&
-           D_point_on_segment_2D_f3(src_p1,src_p2,q2))
-        {
-            // both target points within the ref segment
-            return len_tgt/len_src;
-        }
-        else if(D_point_on_segment_2D_f3(q1,q2,src_p1) &&
-                D_point_on_segment_2D_f3(q1,q2,src_p2))
-        {
-            // both source points within the tgt segment
-            return len_src/len_tgt;
-        }
-        else if(D_point_on_segment_2D_f3(src_p1,src_p2,q1))
-        {
-            float len1 = D_segment_length_2D_f3(src_p2,q2);
-            float len2 = D_segment_length_2D_f3(src_p1,q2);
-
-            // overlap exists
-            if(D_point_on_segment_2D_f3(q1,q2,src_p1) && len1 > L3D_EPS_G)
-                return D_segment_length_2D_f3(q1,src_p1)/len1;
-            else if(len2 > L3D_EPS_G)
-                return D_segment_length_2D_f3(q1,src_p2)/len2;
-        }
-        else if(D_point_on_segment_2D_f3(src_p1,src_p2,q2))
-        {
-            float len1 = D_segment_length_2D_f3(src_p1,q1);
-            float len2 = D_segment_length_2D_f3(src_p2,q1);
-
-            // overlap exists
-            if(D_point_on_segment_2D_f3(q1,q2,src_p2) && len1 > L3D_EPS_G)
-                return D_segment_length_2D_f3(q2,src_p2)/len1;
-            else if(len2 > L3D_EPS_G)
-                return D_segment_length_2D_f3(q2,src_p1)/len2;
-        }
-
-        // no overlap
-        return 0.0f;
-    }
-
-    ////////////////////////////////////////////////////////////////////////////////
-    __device__ float3 D_normalize_hom_coords_2D(float3 p)
-    {
-        if(fabs(p.z) > L3D_EPS_G)
-        {
-            p /= p.z;
-            p.z = 1;
-            return p;
-        }
-        else
-        {
-            return make_float3(0,0,0);
-        }
-    }
-
-    ////////////////////////////////////////////////////////////////////////////////
-    __device__ float3 D_get_ray_src(const float3 p, const float* RtKinv, const int stride)
-    {
-        float _p[3],_ray[3];
-        _p[0] = p.x; _p[1] = p.y; _p[2] = p.z;
-        _ray[0] = 0.0f; _ray[1] = 0.0f; _ray[2] = 0.0f;
-
+        float F[9];
         for(int r=0; r<3; ++r)
-        {
             for(int c=0; c<3; ++c)
-            {
-                _ray[r] += RtKinv[r*stride+c]*_p[c];
-            }
-        }
+                F[r*3+c] = tex2D(tex_fundamentals,c+0.5f,float(camID*3+r)+0.5f);
 
-        return make_float3(_ray[0],_ray[1],_ray[2]);
+        return HD_epipolar_line(p,F,transpose);
     }
 
     ////////////////////////////////////////////////////////////////////////////////
     __device__ float3 D_get_ray_tgt(const float3 p, const int cID)
     {
-        float _p[3],_ray[3];
-        _p[0] = p.x; _p[1] = p.y; _p[2] = p.z;
-        _ray[0] = 0.0f; _ray[1] = 0.0f; _ray[2] = 0.0f;
-
+        float RtKinv[9];
         for(int r=0; r<3; ++r)
-        {
             for(int c=0; c<3; ++c)
-            {
-                _ray[r] += tex2D(tex_RtKinv,c+0.5f,float(cID*3+r)+0.5f)*_p[c];
-            }
-        }
+                RtKinv[r*3+c] = tex2D(tex_RtKinv,c+0.5f,float(cID*3+r)+0.5f);
 
-        return make_float3(_ray[0],_ray[1],_ray[2]);
+        return HD_get_ray(p,RtKinv,3);
     }
 
     ////////////////////////////////////////////////////////////////////////////////
@@ -308,39 +128,13 @@ namespace L3D
                                                const int camID2, const bool for_src,
                                                const float* RtKinv1, const int r_stride)
     {
-        float3 ray1 = normalize(D_get_ray_src(p1,RtKinv1,r_stride));
-        float3 ray2 = normalize(D_get_ray_tgt(p2,camID2));
-        float3 w0 = C1-C2;
-
-        float a = dot(ray1,ray1);
-        float b = dot(ray1,ray2);
-        float c = dot(ray2,ray2);
-        float d = dot(ray1,w0);
-        float e = dot(ray2,w0);
-
-        float denom = a*c-b*b;
-        if(fabs(denom) > L3D_EPS_G)
-        {
-            // triangulation possible
-            if(for_src)
-                return (b*e-c*d)/denom;
-            else
-                return (a*e-b*d)/denom;
-        }
-        else
-        {
-            // impossible correspondence
-            return -1.0f;
-        }
-    }
+        float RtKinv2[9];
+        for(int r=0; r<3; ++r)
+            for(int c=0; c<3; ++c)
+                RtKinv2[r*3+c] = tex2D(tex_RtKinv,c+0.5f,float(camID2*3+r)+0.5f);
 
-    ////////////////////////////////////////////////////////////////////////////////
-    __device__ float3 D_unproject_point_src(const float3 p, const float3 C,
-                                            const float depth,
-                                            const float* RtKinv, const int r_stride)
-    {
-        float3 ray = normalize(D_get_ray_src(p,RtKinv,r_stride));
-        return C+depth*ray;
+        return HD_get_triangulation_depth(p1,p2,C1,C2,RtKinv1,r_stride,
+                                          RtKinv2,3,for_src);
     }
 
     ////////////////////////////////////////////////////////////////////////////////
@@ -354,29 +148,30 @@ namespace L3D
     ////////////////////////////////////////////////////////////////////////////////
     __device__ float3 D_project_point_tgt(const float3 P, const int camID)
     {
-        float _P[4];
-        _P[0] = P.x; _P[1] = P.y; _P[2] = P.z; _P[3] = 1.0f;
-        float _p[3];
-        _p[0] = 0.0f; _p[1] = 0.0f; _p[2] = 0.0f;
+        float proj[12];
         for(int r=0; r<3; ++r)
-        {
             for(int c=0; c<4; ++c)
-            {
-                _p[r] += tex2D(tex_projections,c+0.5f,float(camID*3+r)+0.5f)*_P[c];
-            }
-        }
+                proj[r*4+c] = tex2D(tex_projections,c+0.5f,float(camID*3+r)+0.5f);
 
-        if(fabs(_p[2]) > L3D_EPS_G)
-        {
-           return make_float3(_p[0]/_p[2],_p[1]/_p[2],1.0f);
-        }
-        else
-        {
-            return make_float3(0,0,0);
-        }
+        return HD_project_point(P,proj,4);
     }
 
     ////////////////////////////////////////////////////////////////////////////////
+    __device__ float4 D_target_segment(const int k)
+    {
+        return tex2D(tex_segments_f4,float(k % L3D_TGT_ROW_WIDTH)+0.5f,
+                     float(k / L3D_TGT_ROW_WIDTH)+0.5f);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // class mask of the k-th segment (see segment_classes_array)
+    __device__ int D_segment_class(const int* classes, const int stride, const int k)
+    {
+        return classes[(k / L3D_TGT_ROW_WIDTH)*stride + k % L3D_TGT_ROW_WIDTH];
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    template<bool DEPTH_PRIOR>
     __device__ float D_hypothesis_confidence(const float3 p1, const float3 p2,
                                              const float3 P1, const float3 P2,
                                              const float3 Q1, const float3 Q2,
@@ -384,46 +179,13 @@ namespace L3D
                                              const float sigma_p, const float sigma_a,
                                              const float spatial_k)
     {
-        // check 3D distances
-        if(spatial_k > 0.0f)
-        {
-            float depth1 = length(C-P1);
-            float depth2 = length(C-P2);
-
-            float unc1 = spatial_k*depth1;
-            float unc2 = spatial_k*depth2;
-
-            float dist1 = length(P1-Q1);
-            float dist2 = length(P2-Q2);
-
-            if(dist1 > unc1 || dist2 > unc2)
-                return 0.0f;
-        }
-
-        // src line
-        float3 line1 = cross(p1,p2);
-
         // tgt data
-        float4 data = tex2D(tex_segments_f4,tgtID+0.5f,0.5f);
+        float4 data = D_target_segment(tgtID);
         float3 q1 = make_float3(data.x,data.y,1.0f);
         float3 q2 = make_float3(data.z,data.w,1.0f);
-        float3 line2 = cross(q1,q2);
 
-        // distances
-        float d1 = fmax(D_distance_p2l_2D_f3(line2,p1),
-                        D_distance_p2l_2D_f3(line2,p2));
-        float d2 = fmax(D_distance_p2l_2D_f3(line1,q1),
-                        D_distance_p2l_2D_f3(line1,q2));
-        float dist = fmax(d1,d2);
-
-        // angle
-        float angle = D_angle_between_lines_deg_3D_f3(P1,P2,Q1,Q2);
-        float sigma_sqr_a = sigma_a*sigma_a;
-
-        float sigma_sqr_d = sigma_p*sigma_p;
-        float d = expf(-dist*dist/(2.0f*sigma_sqr_d));
-
-        return fmin(d,expf(-angle*angle/(2.0f*sigma_sqr_a)));
+        return HD_hypothesis_confidence<DEPTH_PRIOR>(p1,p2,q1,q2,P1,P2,Q1,Q2,C,
+                                                     sigma_p,sigma_a,spatial_k);
     }
 
     /// KERNEL FUNCTIONS
@@ -459,8 +221,8 @@ namespace L3D
                 float3 line2 = cross(q1,q2);
 
                 // distances
-                float d1 = fmax(D_distance_p2l_2D_f3(line2,p1),D_distance_p2l_2D_f3(line2,p2));
-                float d2 = fmax(D_distance_p2l_2D_f3(line1,q1),D_distance_p2l_2D_f3(line1,q2));
+                float d1 = fmax(HD_distance_p2l_2D_f3(line2,p1),HD_distance_p2l_2D_f3(line2,p2));
+                float d2 = fmax(HD_distance_p2l_2D_f3(line1,q1),HD_distance_p2l_2D_f3(line1,q2));
                 float d = fmax(d1,d2);
 
                 // affinity
@@ -506,8 +268,8 @@ namespace L3D
                 float3 line2 = cross(q1,q2);
 
                 // distances
-                float d1 = fmax(D_distance_p2l_2D_f3(line2,p1),D_distance_p2l_2D_f3(line2,p2));
-                float d2 = fmax(D_distance_p2l_2D_f3(line1,q1),D_distance_p2l_2D_f3(line1,q2));
+                float d1 = fmax(HD_distance_p2l_2D_f3(line2,p1),HD_distance_p2l_2D_f3(line2,p2));
+                float d2 = fmax(HD_distance_p2l_2D_f3(line1,q1),HD_distance_p2l_2D_f3(line1,q2));
                 float d = fmax(d1,d2);
 
                 // affinity
@@ -538,7 +300,9 @@ namespace L3D
     __global__ void K_pairwise_matches(float4* buffer, const int width, const int height,
                                        const float* RtKinv, const int offset,
                                        const int cID, const float3 C_src, const int stride,
-                                       const int r_stride)
+                                       const int r_stride, const int src_offset,
+                                       const int* classes_src, const int* classes_tgt,
+                                       const int c_stride_src, const int c_stride_tgt)
     {
         int x = blockIdx.x*blockDim.x + threadIdx.x;
         int y = blockIdx.y*blockDim.y + threadIdx.y;
@@ -547,15 +311,25 @@ namespace L3D
         {
             float4 result = make_float4(0,0,0,0);
 
-            // line src
-            float3 p1 = make_float3(tex2D(tex_segments,0.5f,y+0.5f),
-                                    tex2D(tex_segments,1.5f,y+0.5f),1.0f);
-            float3 p2 = make_float3(tex2D(tex_segments,2.5f,y+0.5f),
-                                    tex2D(tex_segments,3.5f,y+0.5f),1.0f);
+            // no common direction class
+            if(classes_src != NULL &&
+                    (D_segment_class(classes_src,c_stride_src,src_offset+y) &
+                     D_segment_class(classes_tgt,c_stride_tgt,offset+x)) == 0)
+            {
+                buffer[y*stride+x] = result;
+                return;
+            }
+
+            // line src (buffer rows are a tile of the source segments)
+            float src_y = float(src_offset+y)+0.5f;
+            float3 p1 = make_float3(tex2D(tex_segments,0.5f,src_y),
+                                    tex2D(tex_segments,1.5f,src_y),1.0f);
+            float3 p2 = make_float3(tex2D(tex_segments,2.5f,src_y),
+                                    tex2D(tex_segments,3.5f,src_y),1.0f);
             float3 line1 = cross(p1,p2);
 
             // line tgt
-            float4 data = tex2D(tex_segments_f4,float(offset+x)+0.5f,0.5f);
+            float4 data = D_target_segment(offset+x);
             float3 q1 = make_float3(data.x,data.y,1.0f);
             float3 q2 = make_float3(data.z,data.w,1.0f);
             float3 line2 = cross(q1,q2);
@@ -567,10 +341,10 @@ namespace L3D
             float3 epi_q2 = D_epipolar_line(q2,cID,true);
 
             // intersect
-            float3 l2_p1 = D_normalize_hom_coords_2D(cross(line2,epi_p1));
-            float3 l2_p2 = D_normalize_hom_coords_2D(cross(line2,epi_p2));
-            float3 l1_q1 = D_normalize_hom_coords_2D(cross(line1,epi_q1));
-            float3 l1_q2 = D_normalize_hom_coords_2D(cross(line1,epi_q2));
+            float3 l2_p1 = HD_normalize_hom_coords_2D(cross(line2,epi_p1));
+            float3 l2_p2 = HD_normalize_hom_coords_2D(cross(line2,epi_p2));
+            float3 l1_q1 = HD_normalize_hom_coords_2D(cross(line1,epi_q1));
+            float3 l1_q2 = HD_normalize_hom_coords_2D(cross(line1,epi_q2));
 
             if(int(l2_p1.z) == 0 || int(l2_p2.z) == 0 ||
                     int(l1_q1.z) == 0 || int(l1_q2.z) == 0)
@@ -581,8 +355,8 @@ namespace L3D
             }
 
             // check if enough overlap
-            float overlap1 = D_segment_overlap_2D(p1,p2,l1_q1,l1_q2);
-            float overlap2 = D_segment_overlap_2D(q1,q2,l2_p1,l2_p2);
+            float overlap1 = HD_segment_overlap_2D(p1,p2,l1_q1,l1_q2);
+            float overlap2 = HD_segment_overlap_2D(q1,q2,l2_p1,l2_p2);
 
             if(fmin(overlap1,overlap2) > L3D_MIN_OVERLAP_LOWER_T_G &&
                     fmax(overlap1,overlap2) > L3D_MIN_OVERLAP_UPPER_T_G)
@@ -611,6 +385,7 @@ namespace L3D
     }
 
     ////////////////////////////////////////////////////////////////////////////////
+    template<bool DEPTH_PRIOR>
     __global__ void K_verify_matches(float4* matches_data, float4* matches_depths,
                                      const int2* match_offsets,
                                      const int2* camera_offsets, const int size,
@@ -641,8 +416,8 @@ namespace L3D
                                     tex2D(tex_segments,3.5f,srcID+0.5f),1.0f);
 
             // unproject
-            float3 P1 = D_unproject_point_src(p1,C_src,depth_p1,RtKinv,r_stride);
-            float3 P2 = D_unproject_point_src(p2,C_src,depth_p2,RtKinv,r_stride);
+            float3 P1 = HD_unproject_point(p1,C_src,depth_p1,RtKinv,r_stride);
+            float3 P2 = HD_unproject_point(p2,C_src,depth_p2,RtKinv,r_stride);
 
             // iterate over matches
             int start = match_offsets[srcID].x;
@@ -668,8 +443,8 @@ namespace L3D
                 float4 depths_tgt = matches_depths[i];
                 float depth_q1 = depths_tgt.x;
                 float depth_q2 = depths_tgt.y;
-                float3 Q1 = D_unproject_point_src(p1,C_src,depth_q1,RtKinv,r_stride);
-                float3 Q2 = D_unproject_point_src(p2,C_src,depth_q2,RtKinv,r_stride);
+                float3 Q1 = HD_unproject_point(p1,C_src,depth_q1,RtKinv,r_stride);
+                float3 Q2 = HD_unproject_point(p2,C_src,depth_q2,RtKinv,r_stride);
 
                 if(camID2 == camID)
                     continue;
@@ -692,9 +467,9 @@ namespace L3D
 
                 if(int(proj1.z) == 1 && int(proj2.z) == 1)
                 {
-                    float conf = D_hypothesis_confidence(proj1,proj2,P1,P2,Q1,Q2,
-                                                         C_src,tgtID2+camFeatureOffset,
-                                                         sigma_p,sigma_a,spatial_k);
+                    float conf = D_hypothesis_confidence<DEPTH_PRIOR>(proj1,proj2,P1,P2,Q1,Q2,
+                                                                      C_src,tgtID2+camFeatureOffset,
+                                                                      sigma_p,sigma_a,spatial_k);
 
                     if(conf > 0.5f)
                     {
@@ -854,6 +629,78 @@ namespace L3D
         cudaUnbindTexture(tex_segments);
     }
 
+    ////////////////////////////////////////////////////////////////////////////////
+    void cap_hypotheses(std::list<L3D::L3DMatchingPair>& matches,
+                        const unsigned int max_hypotheses)
+    {
+        std::list<L3D::L3DMatchingPair>::iterator begin = matches.begin();
+        while(begin != matches.end())
+        {
+            // matches of the same source segment are consecutive
+            std::list<L3D::L3DMatchingPair>::iterator end = begin;
+            std::vector<std::pair<float,unsigned int> > conf;
+            unsigned int pos = 0;
+            for(; end!=matches.end() && end->segID1_ == begin->segID1_; ++end,++pos)
+                conf.push_back(std::pair<float,unsigned int>(-end->confidence_,pos));
+
+            if(conf.size() > max_hypotheses)
+            {
+                // most confident ones (ties: first one wins)
+                std::sort(conf.begin(),conf.end());
+                std::vector<bool> keep(conf.size(),false);
+                for(unsigned int i=0; i<max_hypotheses; ++i)
+                    keep[conf[i].second] = true;
+
+                pos = 0;
+                while(begin != end)
+                {
+                    if(keep[pos])
+                        ++begin;
+                    else
+                        begin = matches.erase(begin);
+
+                    ++pos;
+                }
+            }
+
+            begin = end;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    unsigned int filter_hypotheses_roi(std::list<L3D::L3DMatchingPair>& matches,
+                                       L3D::DataArray<float>* segments_src,
+                                       L3D::DataArray<float>* RtKinv_src,
+                                       const float3 camCenter_src,
+                                       const L3D::L3DRegionOfInterest* roi)
+    {
+        const float* RtKinv = RtKinv_src->dataCPU(0,0);
+        int r_stride = RtKinv_src->strideCPU();
+
+        unsigned int removed = 0;
+        std::list<L3D::L3DMatchingPair>::iterator it = matches.begin();
+        while(it != matches.end())
+        {
+            const float* src = segments_src->dataCPU(0,it->segID1_);
+            float3 p1 = make_float3(src[0],src[1],1.0f);
+            float3 p2 = make_float3(src[2],src[3],1.0f);
+
+            float3 P1 = HD_unproject_point(p1,camCenter_src,it->depths_.x,RtKinv,r_stride);
+            float3 P2 = HD_unproject_point(p2,camCenter_src,it->depths_.y,RtKinv,r_stride);
+
+            if(roi->intersectsSegment(P1,P2))
+            {
+                ++it;
+            }
+            else
+            {
+                it = matches.erase(it);
+                ++removed;
+            }
+        }
+        return removed;
+    }
+
     ////////////////////////////////////////////////////////////////////////////////
     void compute_pairwise_matches(L3D::DataArray<float>* segments_src,
                                   L3D::DataArray<float>* RtKinv_src,
@@ -872,8 +719,14 @@ namespace L3D
                                   const float uncertainty_k_lower,
                                   const float sigma_p, const float sigma_a,
                                   const float spatial_k, float& median_depth,
-                                  const bool verbose, const std::string prefix)
+                                  unsigned int& num_raw_matches,
+                                  const unsigned int max_hypotheses,
+                                  const L3D::L3DRegionOfInterest* roi,
+                                  const bool verbose, const std::string prefix,
+                                  L3D::DataArray<int>* classes_src,
+                                  L3D::DataArray<int>* classes_tgt)
     {
+        num_raw_matches = 0;
         if(toBeMatched.size() == 0)
             return;
 
@@ -890,8 +743,17 @@ namespace L3D
         bindTexture(tex_fundamentals,fundamentals);
         bindTexture(tex_projections,projections);
 
-        // init buffer
-        L3D::DataArray<float4>* buffer = new L3D::DataArray<float4>(max_width,height,true);
+        // init buffer (tiles of source segments)
+        size_t max_rows = size_t(L3D_CU_MAX_BUFFER_MB)*1024*1024/(size_t(std::max(max_width,1u))*sizeof(float4));
+        unsigned int tile_height = std::max(std::min(size_t(height),max_rows),size_t(1));
+        L3D::DataArray<float4>* buffer = new L3D::DataArray<float4>(max_width,tile_height,true);
+
+        // direction classes (optional, uploaded by the caller)
+        bool classes = (classes_src != NULL && classes_tgt != NULL);
+        const int* c_src = classes ? classes_src->dataGPU() : NULL;
+        const int* c_tgt = classes ? classes_tgt->dataGPU() : NULL;
+        int c_stride_src = classes ? classes_src->strideGPU() : 0;
+        int c_stride_tgt = classes ? classes_tgt->strideGPU() : 0;
 
         // compute matches
         dim3 dimBlock = dim3(block_size,block_size);
@@ -905,42 +767,53 @@ namespace L3D
             if(verbose)
                 std::cout << prefix << "[" << vID << "] <--> [" << local2global[localID] << "]" << std::endl;
 
-            // setup grid
             unsigned int feature_offset = offsets->dataCPU(localID,0)[0].x;
             unsigned int width = offsets->dataCPU(localID,0)[0].y;
-            dimGrid = dim3(divUp(width, dimBlock.x),
-                           divUp(height, dimBlock.y));
-
-            // match segments
-            L3D::K_pairwise_matches <<< dimGrid, dimBlock >>> (buffer->dataGPU(),
-                                                               width,height,RtKinv_src->dataGPU(),
-                                                               feature_offset,localID,
-                                                               camCenter_src,
-                                                               buffer->strideGPU(),
-                                                               RtKinv_src->strideGPU());
-
-            // download
-            buffer->download();
-
-            // store raw matches
-            for(unsigned int i=0; i<height; ++i)
+
+            for(unsigned int row_offset=0; row_offset<height; row_offset+=tile_height)
             {
-                for(unsigned int j=0; j<width; ++j)
+                // setup grid
+                unsigned int rows = std::min(tile_height,height-row_offset);
+                dimGrid = dim3(divUp(width, dimBlock.x),
+                               divUp(rows, dimBlock.y));
+
+                // match segments
+                L3D_TRACE_BEGIN(kernel);
+                L3D::K_pairwise_matches <<< dimGrid, dimBlock >>> (buffer->dataGPU(),
+                                                                   width,rows,RtKinv_src->dataGPU(),
+                                                                   feature_offset,localID,
+                                                                   camCenter_src,
+                                                                   buffer->strideGPU(),
+                                                                   RtKinv_src->strideGPU(),
+                                                                   row_offset,c_src,c_tgt,
+                                                                   c_stride_src,c_stride_tgt);
+
+                // download
+                buffer->download();
+                L3D_TRACE_END(kernel,"matches:pairwise");
+
+                // store raw matches
+                L3D_TRACE_BEGIN(store);
+                for(unsigned int i=0; i<rows; ++i)
                 {
-                    float4 depths = buffer->dataCPU(j,i)[0];
-                    if(depths.x > 0.0f && depths.y > 0.0f && depths.z > 0.0f && depths.w > 0.0f)
+                    for(unsigned int j=0; j<width; ++j)
                     {
-                        // potential match
-                        L3D::L3DMatchingPair mp;
-                        mp.segID1_ = i;
-                        mp.segID2_ = j;
-                        mp.camID2_ = localID;
-                        mp.depths_ = depths;
-                        mp.active_ = true;
-                        mp.confidence_ = 0.0f;
-                        matches.push_back(mp);
+                        float4 depths = buffer->dataCPU(j,i)[0];
+                        if(depths.x > 0.0f && depths.y > 0.0f && depths.z > 0.0f && depths.w > 0.0f)
+                        {
+                            // potential match
+                            L3D::L3DMatchingPair mp;
+                            mp.segID1_ = row_offset+i;
+                            mp.segID2_ = j;
+                            mp.camID2_ = localID;
+                            mp.depths_ = depths;
+                            mp.active_ = true;
+                            mp.confidence_ = 0.0f;
+                            matches.push_back(mp);
+                        }
                     }
                 }
+                L3D_TRACE_END(store,"matches:store_raw");
             }
         }
 
@@ -948,10 +821,21 @@ namespace L3D
         delete buffer;
 
         // verify matches (sort first!)
+        L3D_TRACE_BEGIN(sort);
         matches.sort(L3D::sortMatchingPairs);
+        L3D_TRACE_END(sort,"matches:sort");
+        num_raw_matches = matches.size();
         if(verbose)
             std::cout << prefix << "#raw_matches:          " << matches.size() << std::endl;
 
+        if(roi != NULL && roi->hasRegion())
+        {
+            unsigned int removed = filter_hypotheses_roi(matches,segments_src,RtKinv_src,
+                                                         camCenter_src,roi);
+            if(verbose)
+                std::cout << prefix << "#outside_roi:          " << removed << std::endl;
+        }
+
         if(matches.size() == 0)
             return;
 
@@ -1002,6 +886,7 @@ namespace L3D
                                                                num_matches);
         }
 
+        L3D_TRACE_BEGIN(verify);
         rawMatches_data->upload();
         rawMatches_depths->upload();
         matchOffset->upload();
@@ -1010,18 +895,34 @@ namespace L3D
         dimGrid = dim3(divUp(1, dimBlock.x),
                        divUp(rawMatches_data->width(), dimBlock.y));
 
-        L3D::K_verify_matches <<< dimGrid, dimBlock >>> (rawMatches_data->dataGPU(),
-                                                         rawMatches_depths->dataGPU(),
-                                                         matchOffset->dataGPU(),
-                                                         offsets->dataGPU(),rawMatches_data->width(),
-                                                         RtKinv_src->dataGPU(),camCenter_src,
-                                                         sigma_p,sigma_a,spatial_k,
-                                                         RtKinv_src->strideGPU());
+        // depth prior resolved at compile time
+        if(spatial_k > 0.0f)
+        {
+            L3D::K_verify_matches<true> <<< dimGrid, dimBlock >>> (rawMatches_data->dataGPU(),
+                                                                   rawMatches_depths->dataGPU(),
+                                                                   matchOffset->dataGPU(),
+                                                                   offsets->dataGPU(),rawMatches_data->width(),
+                                                                   RtKinv_src->dataGPU(),camCenter_src,
+                                                                   sigma_p,sigma_a,spatial_k,
+                                                                   RtKinv_src->strideGPU());
+        }
+        else
+        {
+            L3D::K_verify_matches<false> <<< dimGrid, dimBlock >>> (rawMatches_data->dataGPU(),
+                                                                    rawMatches_depths->dataGPU(),
+                                                                    matchOffset->dataGPU(),
+                                                                    offsets->dataGPU(),rawMatches_data->width(),
+                                                                    RtKinv_src->dataGPU(),camCenter_src,
+                                                                    sigma_p,sigma_a,spatial_k,
+                                                                    RtKinv_src->strideGPU());
+        }
 
         // download
         matches.clear();
         rawMatches_data->download();
+        L3D_TRACE_END(verify,"matches:verify");
 
+        L3D_TRACE_BEGIN(filter);
         std::vector<float> depths;
         float conf_t = 1.00f;
         unsigned int num_valid = 0;
@@ -1109,6 +1010,10 @@ namespace L3D
             }
         }
 
+        if(max_hypotheses > 0)
+            cap_hypotheses(matches,max_hypotheses);
+        L3D_TRACE_END(filter,"matches:filter");
+
         if(verbose)
         {
             std::cout << prefix << "#filtered_matches (2): " << matches.size() << std::endl;
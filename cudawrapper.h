@@ -27,9 +27,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // internal
 #include "sparsematrix.h"
 #include "dataArray.h"
+#include "geometry.h"
+#include "tracing.h"
+#include "roi.h"
 
 // std
 #include <map>
+#include <vector>
+#include <algorithm>
 
 // params
 #define L3D_RDD_MAX_ITER 10
@@ -38,19 +43,61 @@ namespace L3D
 {
     // constants CPU
     const unsigned int L3D_CU_BLOCK_SIZE_C = 16;
+    // target segments are stored in rows of this width (2D texture limits)
+    const unsigned int L3D_TGT_ROW_WIDTH = 4096;
+    // max. size of the raw match buffer [MB] (source segments are tiled)
+    const unsigned int L3D_CU_MAX_BUFFER_MB = 256;
+    // segment class mask which is compatible with all others
+    const int L3D_CLASS_ANY = ~0;
 
     // constants GPU
-    __device__ const float L3D_EPS_G = 1e-12;
     __device__ const float L3D_COLLIN_AFF_T_G = 0.50f;
     __device__ const float L3D_MIN_OVERLAP_LOWER_T_G = 0.10f;
     __device__ const float L3D_MIN_OVERLAP_UPPER_T_G = 0.30f;
 
+    // target segments of all neighbors, row-wise (see L3D_TGT_ROW_WIDTH)
+    inline L3D::DataArray<float4>* target_segments_array(const std::vector<float4>& segments,
+                                                         const bool allocate_GPU_memory)
+    {
+        unsigned int width = std::max(std::min(unsigned(segments.size()),L3D_TGT_ROW_WIDTH),1u);
+        unsigned int height = std::max((unsigned(segments.size())+L3D_TGT_ROW_WIDTH-1)/L3D_TGT_ROW_WIDTH,1u);
+
+        std::vector<float4> data(segments);
+        data.resize(width*height,make_float4(0,0,0,0));
+        return new L3D::DataArray<float4>(width,height,allocate_GPU_memory,data);
+    }
+
+    // k-th target segment (see target_segments_array)
+    inline float4 target_segment(L3D::DataArray<float4>* segments, const unsigned int k)
+    {
+        return segments->dataCPU(k % L3D_TGT_ROW_WIDTH,k / L3D_TGT_ROW_WIDTH)[0];
+    }
+
+    // per segment class masks (e.g. direction classes), same layout as the target segments
+    inline L3D::DataArray<int>* segment_classes_array(const std::vector<int>& classes,
+                                                      const bool allocate_GPU_memory)
+    {
+        unsigned int width = std::max(std::min(unsigned(classes.size()),L3D_TGT_ROW_WIDTH),1u);
+        unsigned int height = std::max((unsigned(classes.size())+L3D_TGT_ROW_WIDTH-1)/L3D_TGT_ROW_WIDTH,1u);
+
+        std::vector<int> data(classes);
+        data.resize(width*height,0);
+        return new L3D::DataArray<int>(width,height,allocate_GPU_memory,data);
+    }
+
+    // class mask of the k-th segment (see segment_classes_array)
+    inline int segment_class(L3D::DataArray<int>* classes, const unsigned int k)
+    {
+        return classes->dataCPU(k % L3D_TGT_ROW_WIDTH,k / L3D_TGT_ROW_WIDTH)[0];
+    }
+
     // compute pairwise 2D line segment collinearity score
     extern void compute_collinearity(L3D::DataArray<float>* segments,
                                      L3D::DataArray<float>* relation,
                                      const float collin_s);
 
-    // perform segment matching
+    // perform segment matching (optional class masks: only pairs
+    // with a common class are tested, see segment_classes_array)
     extern void compute_pairwise_matches(L3D::DataArray<float>* segments_src,
                                          L3D::DataArray<float>* RtKinv_src,
                                          L3D::DataArray<float4>* segments_tgt,
@@ -68,7 +115,25 @@ namespace L3D
                                          const float uncertainty_k_lower,
                                          const float sigma_p, const float sigma_a,
                                          const float spatial_k, float& median_depth,
-                                         const bool verbose, const std::string prefix);
+                                         unsigned int& num_raw_matches,
+                                         const unsigned int max_hypotheses,
+                                         const L3D::L3DRegionOfInterest* roi,
+                                         const bool verbose, const std::string prefix,
+                                         L3D::DataArray<int>* classes_src=NULL,
+                                         L3D::DataArray<int>* classes_tgt=NULL);
+
+    // keeps the max_hypotheses most confident matches per source segment
+    // (matches have to be grouped by segID1_)
+    extern void cap_hypotheses(std::list<L3D::L3DMatchingPair>& matches,
+                               const unsigned int max_hypotheses);
+
+    // removes hypotheses that do not intersect the region of interest,
+    // returns the number of removed ones
+    extern unsigned int filter_hypotheses_roi(std::list<L3D::L3DMatchingPair>& matches,
+                                              L3D::DataArray<float>* segments_src,
+                                              L3D::DataArray<float>* RtKinv_src,
+                                              const float3 camCenter_src,
+                                              const L3D::L3DRegionOfInterest* roi);
 
     // replicator dynamics diffusion [M.Donoser, BMVC'13]
     extern void replicator_dynamics_diffusion(L3D::SparseMatrix* &W, const bool verbose,
@@ -0,0 +1,218 @@
+#ifndef I3D_LINE3D_DIRECTIONS_H_
+#define I3D_LINE3D_DIRECTIONS_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// std
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+// external
+#include "eigen3/Eigen/Eigen"
+#include "helper_math.h"
+
+// internal
+#include "commons.h"
+#include "dataArray.h"
+#include "cudawrapper.h"
+
+/**
+ * Line3D - Direction Classes
+ * ====================
+ * Dominant 3D directions of a scene (man-made
+ * structures) and per segment direction classes.
+ * A 2D segment and its camera define an
+ * interpretation plane, the 3D direction of the
+ * segment lies in it. Directions which lie in
+ * the planes of many segments (all views) are
+ * found by RANSAC. Per view, each direction maps
+ * to a vanishing point, a segment belongs to the
+ * classes of all vanishing points it points at
+ * (bit mask). Segments without a class are
+ * compatible with everything.
+ * ====================
+ */
+
+namespace L3D
+{
+    class L3DDirectionClasses
+    {
+    public:
+        L3DDirectionClasses(){}
+
+        // normal of the interpretation plane of a 2D segment (world space, x = K*(R*X+t))
+        static Eigen::Vector3d interpretationPlane(const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                                                   const float4 seg)
+        {
+            Eigen::Vector3d p1(seg.x,seg.y,1.0);
+            Eigen::Vector3d p2(seg.z,seg.w,1.0);
+            Eigen::Vector3d n = R.transpose()*(K.transpose()*p1.cross(p2));
+            if(n.norm() > L3D_EPS)
+                n.normalize();
+            return n;
+        }
+
+        // dominant directions (RANSAC on the interpretation planes, weighted),
+        // a direction needs min_support of the total weight
+        void estimate(const std::vector<Eigen::Vector3d>& normals,
+                      const std::vector<double>& weights,
+                      const unsigned int max_directions,
+                      const float angle_t, const float min_support,
+                      const unsigned int iterations, unsigned int seed=42)
+        {
+            directions_.clear();
+            if(normals.size() < 2)
+                return;
+
+            double sin_t = sin(angle_t);
+            double total = 0.0;
+            for(unsigned int i=0; i<weights.size(); ++i)
+                total += weights[i];
+
+            std::vector<bool> used(normals.size(),false);
+            while(directions_.size() < max_directions)
+            {
+                // hypotheses: intersection of two planes
+                Eigen::Vector3d best(0,0,0);
+                double best_support = 0.0;
+                for(unsigned int it=0; it<iterations; ++it)
+                {
+                    unsigned int i = rand_r(&seed) % normals.size();
+                    unsigned int j = rand_r(&seed) % normals.size();
+                    if(i == j || used[i] || used[j])
+                        continue;
+
+                    Eigen::Vector3d d = normals[i].cross(normals[j]);
+                    if(d.norm() < sin_t)
+                        continue;
+
+                    d.normalize();
+                    double support = support_of(d,normals,weights,used,sin_t);
+                    if(support > best_support)
+                    {
+                        best_support = support;
+                        best = d;
+                    }
+                }
+
+                if(best_support < min_support*total)
+                    break;
+
+                // refine: direction closest to all inlier planes
+                Eigen::Matrix3d M = Eigen::Matrix3d::Zero();
+                for(unsigned int k=0; k<normals.size(); ++k)
+                {
+                    if(!used[k] && fabs(normals[k].dot(best)) < sin_t)
+                        M += weights[k]*normals[k]*normals[k].transpose();
+                }
+                Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig(M);
+                Eigen::Vector3d refined = eig.eigenvectors().col(0);
+                if(support_of(refined,normals,weights,used,sin_t) >= best_support)
+                    best = refined;
+
+                directions_.push_back(best);
+
+                // remove inliers
+                for(unsigned int k=0; k<normals.size(); ++k)
+                {
+                    if(fabs(normals[k].dot(best)) < sin_t)
+                        used[k] = true;
+                }
+            }
+        }
+
+        unsigned int numDirections() const {return directions_.size();}
+        Eigen::Vector3d direction(const unsigned int k) const {return directions_[k];}
+
+        // class masks of the segments of a view (L3D_CLASS_ANY: no dominant direction),
+        // a segment belongs to a class if it points at the vanishing point within
+        // angle_t (+ endpoint uncertainty of +-sigma_px)
+        void classify(const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                      L3D::DataArray<float>* segments, const float angle_t,
+                      const float sigma_px, std::vector<int>& classes) const
+        {
+            classes.assign(segments->height(),L3D_CLASS_ANY);
+            if(directions_.size() == 0)
+                return;
+
+            // vanishing points
+            std::vector<Eigen::Vector3d> vps(directions_.size());
+            for(unsigned int k=0; k<directions_.size(); ++k)
+                vps[k] = K*(R*directions_[k]);
+
+            for(unsigned int i=0; i<segments->height(); ++i)
+            {
+                double x1 = segments->dataCPU(0,i)[0];
+                double y1 = segments->dataCPU(1,i)[0];
+                double x2 = segments->dataCPU(2,i)[0];
+                double y2 = segments->dataCPU(3,i)[0];
+
+                Eigen::Vector2d u(x2-x1,y2-y1);
+                double len = u.norm();
+                if(len < L3D_EPS)
+                    continue;
+                u /= len;
+
+                Eigen::Vector2d m(0.5*(x1+x2),0.5*(y1+y2));
+                double cos_t = cos(angle_t+atan(2.0*sigma_px/len));
+
+                int mask = 0;
+                for(unsigned int k=0; k<vps.size(); ++k)
+                {
+                    // direction towards the vanishing point (at infinity: image direction)
+                    Eigen::Vector2d w;
+                    if(fabs(vps[k].z()) > L3D_EPS)
+                        w = Eigen::Vector2d(vps[k].x()/vps[k].z(),vps[k].y()/vps[k].z())-m;
+                    else
+                        w = Eigen::Vector2d(vps[k].x(),vps[k].y());
+
+                    double wn = w.norm();
+                    if(wn > L3D_EPS && fabs(u.dot(w))/wn > cos_t)
+                        mask |= (1 << k);
+                }
+
+                if(mask != 0)
+                    classes[i] = mask;
+            }
+        }
+
+        // segments can be matched if they share a class
+        static bool compatible(const int c1, const int c2){return ((c1 & c2) != 0);}
+
+    private:
+        static double support_of(const Eigen::Vector3d& d,
+                                 const std::vector<Eigen::Vector3d>& normals,
+                                 const std::vector<double>& weights,
+                                 const std::vector<bool>& used, const double sin_t)
+        {
+            double support = 0.0;
+            for(unsigned int k=0; k<normals.size(); ++k)
+            {
+                if(!used[k] && fabs(normals[k].dot(d)) < sin_t)
+                    support += weights[k];
+            }
+            return support;
+        }
+
+        std::vector<Eigen::Vector3d> directions_;
+    };
+}
+
+#endif //I3D_LINE3D_DIRECTIONS_H_
@@ -0,0 +1,323 @@
+#ifndef I3D_LINE3D_GEOMETRY_H_
+#define I3D_LINE3D_GEOMETRY_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// external
+#include "math_constants.h"
+#include "helper_math.h"
+
+/**
+ * Line3D - Geometry
+ * ====================
+ * Geometric core functions of the matching
+ * and verification stage. Host and device
+ * callable, all camera data is passed explicitly
+ * (row-major matrices with stride), the CUDA kernels
+ * fetch it from textures and delegate to these.
+ * ====================
+ */
+
+// epsilon of the host and device code (CPU and CUDA backends)
+#define L3D_EPS_G 1e-12f
+
+namespace L3D
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Note: point needs to be normalized! (--> p.z == 1)
+    inline __host__ __device__ float HD_distance_p2l_2D_f3(const float3 line, const float3 p)
+    {
+        return fabs((line.x*p.x+line.y*p.y+line.z)/sqrtf(line.x*line.x+line.y*line.y));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Note: points needs to be normalized! (--> p.z == 1)
+    inline __host__ __device__ float HD_segment_length_2D_f3(const float3 p1, const float3 p2)
+    {
+        float3 v = p1-p2;
+        return sqrtf(v.x*v.x+v.y*v.y);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    inline __host__ __device__ float HD_angle_between_lines_deg_3D_f3(const float3 P1, const float3 P2,
+                                                                      const float3 Q1, const float3 Q2)
+    {
+        float3 v1 = normalize(P1-P2);
+        float3 v2 = normalize(Q1-Q2);
+
+        float angle = acos(fmax(fmin(dot(v1,v2),1.0f),-1.0f))/CUDART_PI*180.0f;
+
+        if(angle > 90.0f)
+            angle = 180.0f-angle;
+
+        return angle;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Note: points needs to be normalized! (--> p.z == 1),
+    // q needs to be collinear with p1 and p2!
+    inline __host__ __device__ bool HD_point_on_segment_2D_f3(const float3 p1, const float3 p2,
+                                                              const float3 q)
+    {
+        float2 v1 = make_float2(p1.x-q.x,p1.y-q.y);
+        float2 v2 = make_float2(p2.x-q.x,p2.y-q.y);
+        return (dot(v1,v2) < L3D_EPS_G);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    inline __host__ __device__ float3 HD_normalize_hom_coords_2D(float3 p)
+    {
+        if(fabs(p.z) > L3D_EPS_G)
+        {
+            p /= p.z;
+            p.z = 1;
+            return p;
+        }
+        else
+        {
+            return make_float3(0,0,0);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // F: 3x3 fundamental matrix (row-major)
+    inline __host__ __device__ float3 HD_epipolar_line(const float3 p, const float* F,
+                                                       const bool transpose)
+    {
+        float _p[3],_l[3];
+        _p[0] = p.x; _p[1] = p.y; _p[2] = p.z;
+        _l[0] = 0.0f; _l[1] = 0.0f; _l[2] = 0.0f;
+
+        for(int r=0; r<3; ++r)
+        {
+            for(int c=0; c<3; ++c)
+            {
+                if(!transpose)
+                    _l[r] += F[r*3+c]*_p[c];
+                else
+                    _l[r] += F[c*3+r]*_p[c];
+            }
+        }
+
+        return make_float3(_l[0],_l[1],_l[2]);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    inline __host__ __device__ float HD_segment_overlap_2D(const float3 src_p1, const float3 src_p2,
+                                                           const float3 q1, const float3 q2)
+    {
+        float len_src = HD_segment_length_2D_f3(src_p1,src_p2);
+        float len_tgt = HD_segment_length_2D_f3(q1,q2);
+
+        if(len_src < 1.0f || len_tgt < 1.0f)
+            return 0.0f;
+
+        if(HD_point_on_segment_2D_f3(src_p1,src_p2,q1) &&
+           HD_point_on_segment_2D_f3(src_p1,src_p2,q2))
+        {
+            // both target points within the ref segment
+            return len_tgt/len_src;
+        }
+        else if(HD_point_on_segment_2D_f3(q1,q2,src_p1) &&
+                HD_point_on_segment_2D_f3(q1,q2,src_p2))
+        {
+            // both source points within the tgt segment
+            return len_src/len_tgt;
+        }
+        else if(HD_point_on_segment_2D_f3(src_p1,src_p2,q1))
+        {
+            float len1 = HD_segment_length_2D_f3(src_p2,q2);
+            float len2 = HD_segment_length_2D_f3(src_p1,q2);
+
+            // overlap exists
+            if(HD_point_on_segment_2D_f3(q1,q2,src_p1) && len1 > L3D_EPS_G)
+                return HD_segment_length_2D_f3(q1,src_p1)/len1;
+            else if(len2 > L3D_EPS_G)
+                return HD_segment_length_2D_f3(q1,src_p2)/len2;
+        }
+        else if(HD_point_on_segment_2D_f3(src_p1,src_p2,q2))
+        {
+            float len1 = HD_segment_length_2D_f3(src_p1,q1);
+            float len2 = HD_segment_length_2D_f3(src_p2,q1);
+
+            // overlap exists
+            if(HD_point_on_segment_2D_f3(q1,q2,src_p2) && len1 > L3D_EPS_G)
+                return HD_segment_length_2D_f3(q2,src_p2)/len1;
+            else if(len2 > L3D_EPS_G)
+                return HD_segment_length_2D_f3(q2,src_p1)/len2;
+        }
+
+        // no overlap
+        return 0.0f;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // RtKinv: 3x3 matrix (row-major) with row stride
+    inline __host__ __device__ float3 HD_get_ray(const float3 p, const float* RtKinv, const int stride)
+    {
+        float _p[3],_ray[3];
+        _p[0] = p.x; _p[1] = p.y; _p[2] = p.z;
+        _ray[0] = 0.0f; _ray[1] = 0.0f; _ray[2] = 0.0f;
+
+        for(int r=0; r<3; ++r)
+        {
+            for(int c=0; c<3; ++c)
+            {
+                _ray[r] += RtKinv[r*stride+c]*_p[c];
+            }
+        }
+
+        return make_float3(_ray[0],_ray[1],_ray[2]);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    inline __host__ __device__ float HD_get_triangulation_depth(const float3 p1, const float3 p2,
+                                                                const float3 C1, const float3 C2,
+                                                                const float* RtKinv1, const int stride1,
+                                                                const float* RtKinv2, const int stride2,
+                                                                const bool for_src)
+    {
+        float3 ray1 = normalize(HD_get_ray(p1,RtKinv1,stride1));
+        float3 ray2 = normalize(HD_get_ray(p2,RtKinv2,stride2));
+        float3 w0 = C1-C2;
+
+        float a = dot(ray1,ray1);
+        float b = dot(ray1,ray2);
+        float c = dot(ray2,ray2);
+        float d = dot(ray1,w0);
+        float e = dot(ray2,w0);
+
+        float denom = a*c-b*b;
+        if(fabs(denom) > L3D_EPS_G)
+        {
+            // triangulation possible
+            if(for_src)
+                return (b*e-c*d)/denom;
+            else
+                return (a*e-b*d)/denom;
+        }
+        else
+        {
+            // impossible correspondence
+            return -1.0f;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    inline __host__ __device__ float3 HD_unproject_point(const float3 p, const float3 C,
+                                                         const float depth,
+                                                         const float* RtKinv, const int stride)
+    {
+        float3 ray = normalize(HD_get_ray(p,RtKinv,stride));
+        return C+depth*ray;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // P: 3x4 projection matrix (row-major) with row stride
+    inline __host__ __device__ float3 HD_project_point(const float3 X, const float* P, const int stride)
+    {
+        float _X[4];
+        _X[0] = X.x; _X[1] = X.y; _X[2] = X.z; _X[3] = 1.0f;
+        float _p[3];
+        _p[0] = 0.0f; _p[1] = 0.0f; _p[2] = 0.0f;
+        for(int r=0; r<3; ++r)
+        {
+            for(int c=0; c<4; ++c)
+            {
+                _p[r] += P[r*stride+c]*_X[c];
+            }
+        }
+
+        if(fabs(_p[2]) > L3D_EPS_G)
+        {
+           return make_float3(_p[0]/_p[2],_p[1]/_p[2],1.0f);
+        }
+        else
+        {
+            return make_float3(0,0,0);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // p1,p2: projected hypothesis, q1,q2: target segment (normalized)
+    // DEPTH_PRIOR: reject hypotheses whose 3D distance exceeds spatial_k*depth
+    template<bool DEPTH_PRIOR>
+    inline __host__ __device__ float HD_hypothesis_confidence(const float3 p1, const float3 p2,
+                                                              const float3 q1, const float3 q2,
+                                                              const float3 P1, const float3 P2,
+                                                              const float3 Q1, const float3 Q2,
+                                                              const float3 C,
+                                                              const float sigma_p, const float sigma_a,
+                                                              const float spatial_k)
+    {
+        // check 3D distances
+        if(DEPTH_PRIOR)
+        {
+            float depth1 = length(C-P1);
+            float depth2 = length(C-P2);
+
+            float unc1 = spatial_k*depth1;
+            float unc2 = spatial_k*depth2;
+
+            float dist1 = length(P1-Q1);
+            float dist2 = length(P2-Q2);
+
+            if(dist1 > unc1 || dist2 > unc2)
+                return 0.0f;
+        }
+
+        // lines
+        float3 line1 = cross(p1,p2);
+        float3 line2 = cross(q1,q2);
+
+        // distances
+        float d1 = fmax(HD_distance_p2l_2D_f3(line2,p1),
+                        HD_distance_p2l_2D_f3(line2,p2));
+        float d2 = fmax(HD_distance_p2l_2D_f3(line1,q1),
+                        HD_distance_p2l_2D_f3(line1,q2));
+        float dist = fmax(d1,d2);
+
+        // angle
+        float angle = HD_angle_between_lines_deg_3D_f3(P1,P2,Q1,Q2);
+        float sigma_sqr_a = sigma_a*sigma_a;
+
+        float sigma_sqr_d = sigma_p*sigma_p;
+        float d = expf(-dist*dist/(2.0f*sigma_sqr_d));
+
+        return fmin(d,expf(-angle*angle/(2.0f*sigma_sqr_a)));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // runtime dispatch (spatial_k <= 0 --> no depth prior)
+    inline __host__ __device__ float HD_hypothesis_confidence(const float3 p1, const float3 p2,
+                                                              const float3 q1, const float3 q2,
+                                                              const float3 P1, const float3 P2,
+                                                              const float3 Q1, const float3 Q2,
+                                                              const float3 C,
+                                                              const float sigma_p, const float sigma_a,
+                                                              const float spatial_k)
+    {
+        if(spatial_k > 0.0f)
+            return HD_hypothesis_confidence<true>(p1,p2,q1,q2,P1,P2,Q1,Q2,C,sigma_p,sigma_a,spatial_k);
+        else
+            return HD_hypothesis_confidence<false>(p1,p2,q1,q2,P1,P2,Q1,Q2,C,sigma_p,sigma_a,spatial_k);
+    }
+}
+
+#endif //I3D_LINE3D_GEOMETRY_H_
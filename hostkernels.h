@@ -0,0 +1,155 @@
+#ifndef I3D_LINE3D_HOSTKERNELS_H_
+#define I3D_LINE3D_HOSTKERNELS_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// std
+#include <cmath>
+#include <algorithm>
+
+// external
+#include "eigen3/Eigen/Eigen"
+
+// internal
+#include "commons.h"
+
+/**
+ * Line3D - Host Kernels
+ * ====================
+ * 3D geometry on the host (clustering affinities),
+ * templated over the precision (float/double) and a
+ * feature policy. Dispatch happens once per job, the
+ * inner loops contain no runtime feature checks.
+ * ====================
+ */
+
+namespace L3D
+{
+    // precision + features for one job
+    template<typename T, bool COLLINEARITY>
+    struct L3DPolicy
+    {
+        typedef T real;
+        typedef Eigen::Matrix<T,3,1> vec3;
+
+        static const bool collinearity = COLLINEARITY;
+    };
+
+    // depth dependent spatial uncertainty of a view
+    // (same as L3DView::get_*_uncertainty)
+    template<typename T>
+    struct L3DUncertaintyModel
+    {
+        T k_lower_;
+        T k_upper_;
+        T median_depth_;
+
+        inline T lower(const T depth) const
+        {
+            return k_lower_*std::min(depth,median_depth_);
+        }
+
+        inline T upper(const T depth) const
+        {
+            return k_upper_*std::min(depth,median_depth_);
+        }
+
+        inline T sigma_sqr(const T depth) const
+        {
+            T d = upper(depth)-lower(depth);
+            return -d*d/(T(2)*std::log(T(0.01)));
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // distance of X to the (infinite) line through P1 with direction dir
+    template<typename T>
+    inline T HK_distance_point2line_3D(const Eigen::Matrix<T,3,1>& P1,
+                                       const Eigen::Matrix<T,3,1>& dir,
+                                       const Eigen::Matrix<T,3,1>& X)
+    {
+        Eigen::Matrix<T,3,1> proj = P1 + dir*(X-P1).dot(dir);
+        return (proj-X).norm();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // 1 below the lower uncertainty, gaussian decay above
+    template<typename T>
+    inline T HK_position_similarity(const T d, const T min_d, const T sigma_sqr)
+    {
+        if(d < min_d)
+            return T(1);
+        else
+            return std::exp(-(d-min_d)*(d-min_d)/(T(2)*sigma_sqr));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // similarity of two 3D segment hypotheses (position + angle) [sigma_a: degrees]
+    template<typename T>
+    inline T HK_similarity_coll3D(const L3D::L3DSegment3D& seg1, const L3D::L3DSegment3D& seg2,
+                                  const L3D::L3DUncertaintyModel<T>& u1,
+                                  const L3D::L3DUncertaintyModel<T>& u2,
+                                  const T sigma_a)
+    {
+        typedef Eigen::Matrix<T,3,1> vec3;
+
+        vec3 P1 = seg1.P1_.cast<T>();
+        vec3 P2 = seg1.P2_.cast<T>();
+        vec3 dir1 = seg1.dir_.cast<T>();
+        vec3 Q1 = seg2.P1_.cast<T>();
+        vec3 Q2 = seg2.P2_.cast<T>();
+        vec3 dir2 = seg2.dir_.cast<T>();
+
+        T dp1 = T(seg1.depth_p1_);
+        T dp2 = T(seg1.depth_p2_);
+        T dq1 = T(seg2.depth_p1_);
+        T dq2 = T(seg2.depth_p2_);
+
+        // seg1 --> seg2
+        T sim1 = HK_position_similarity<T>(HK_distance_point2line_3D<T>(Q1,dir2,P1),
+                                           u1.lower(dp1),u1.sigma_sqr(dp1));
+        T sim2 = HK_position_similarity<T>(HK_distance_point2line_3D<T>(Q1,dir2,P2),
+                                           u1.lower(dp2),u1.sigma_sqr(dp2));
+
+        // seg2 --> seg1
+        T sim3 = HK_position_similarity<T>(HK_distance_point2line_3D<T>(P1,dir1,Q1),
+                                           u2.lower(dq1),u2.sigma_sqr(dq1));
+        T sim4 = HK_position_similarity<T>(HK_distance_point2line_3D<T>(P1,dir1,Q2),
+                                           u2.lower(dq2),u2.sigma_sqr(dq2));
+
+        T w_d = std::min(std::min(sim1,sim2),std::min(sim3,sim4));
+
+        // angle
+        T angle = std::acos(std::max(std::min(dir1.dot(dir2),T(1)),T(-1)))/T(M_PI)*T(180);
+        if(angle > T(90))
+            angle = T(180)-angle;
+
+        T w_a = std::exp(-angle*angle/(T(2)*sigma_a*sigma_a));
+
+        // fuse
+        T sim = std::min(w_d,w_a);
+
+        if(sim <= T(0.01))
+            return T(0);
+        else
+            return sim;
+    }
+}
+
+#endif //I3D_LINE3D_HOSTKERNELS_H_
@@ -0,0 +1,165 @@
+#ifndef I3D_LINE3D_L3DNUMA_H_
+#define I3D_LINE3D_L3DNUMA_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// std
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+
+/**
+ * Line3D - NUMA
+ * ====================
+ * NUMA topology (Linux sysfs, no libnuma) and
+ * thread pinning. OpenMP threads are mapped to
+ * the nodes in contiguous blocks. Memory is placed
+ * by first touch: data which is allocated and
+ * initialized by a pinned thread lives on its node.
+ * Nodes are numbered densely in the order of the
+ * online node list (node IDs may have gaps).
+ * Without sysfs (or with a single node) everything
+ * is a no-op. The pin is taken once per thread
+ * at the start of a parallel region.
+ * ====================
+ */
+
+namespace L3D
+{
+    class L3DNumaTopology
+    {
+    public:
+        // system topology (parsed once)
+        static const L3DNumaTopology& system()
+        {
+            static L3DNumaTopology topology;
+            return topology;
+        }
+
+        unsigned int numNodes() const {return node_cpus_.size();}
+        bool available() const {return numNodes() > 1;}
+
+        // node of OpenMP thread t (team of num_threads threads)
+        unsigned int nodeOfThread(const int t, const int num_threads) const
+        {
+            if(numNodes() == 0 || num_threads <= 0)
+                return 0;
+            return (unsigned int)((long long)(t)*numNodes()/num_threads);
+        }
+
+        // restricts the calling thread to the CPUs of a node
+        bool pin(const unsigned int node) const
+        {
+            if(node >= numNodes() || node_cpus_[node].size() == 0)
+                return false;
+
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for(unsigned int i=0; i<node_cpus_[node].size(); ++i)
+                CPU_SET(node_cpus_[node][i],&set);
+
+            return (sched_setaffinity(0,sizeof(set),&set) == 0);
+        }
+
+    private:
+        L3DNumaTopology()
+        {
+            std::ifstream online("/sys/devices/system/node/online");
+            if(!online.is_open())
+                return;
+
+            std::string nodes;
+            std::getline(online,nodes);
+            std::vector<int> node_ids = parseList(nodes);
+            for(unsigned int i=0; i<node_ids.size(); ++i)
+            {
+                std::stringstream str;
+                str << "/sys/devices/system/node/node" << node_ids[i] << "/cpulist";
+                std::ifstream file(str.str().c_str());
+                if(!file.is_open())
+                    continue;
+
+                std::string list;
+                std::getline(file,list);
+                std::vector<int> cpus = parseList(list);
+                if(cpus.size() > 0)
+                    node_cpus_.push_back(cpus);
+            }
+        }
+
+        // "0-3,8-11" --> 0 1 2 3 8 9 10 11 (node and CPU lists)
+        static std::vector<int> parseList(const std::string& list)
+        {
+            std::vector<int> cpus;
+            std::stringstream str(list);
+            std::string range;
+            while(std::getline(str,range,','))
+            {
+                int first, last;
+                if(sscanf(range.c_str(),"%d-%d",&first,&last) == 2)
+                {
+                    for(int c=first; c<=last; ++c)
+                        cpus.push_back(c);
+                }
+                else if(sscanf(range.c_str(),"%d",&first) == 1)
+                {
+                    cpus.push_back(first);
+                }
+            }
+            return cpus;
+        }
+
+        std::vector<std::vector<int> > node_cpus_;
+    };
+
+    // pins the calling thread to a node for its lifetime (scope),
+    // the previous affinity is restored afterwards (construct once per
+    // thread at the top of a parallel region, not per task)
+    class L3DNodePin
+    {
+    public:
+        L3DNodePin(const unsigned int node, const bool enabled=true) : pinned_(false)
+        {
+            if(!enabled || !L3DNumaTopology::system().available())
+                return;
+
+            if(sched_getaffinity(0,sizeof(previous_),&previous_) == 0)
+                pinned_ = L3DNumaTopology::system().pin(node);
+        }
+
+        ~L3DNodePin()
+        {
+            if(pinned_)
+                sched_setaffinity(0,sizeof(previous_),&previous_);
+        }
+
+    private:
+        bool pinned_;
+        cpu_set_t previous_;
+    };
+}
+
+#endif //I3D_LINE3D_L3DNUMA_H_
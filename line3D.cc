@@ -18,6 +18,29 @@ namespace L3D
         uncertainty_upper_2D_ = fabs(uncertainty_t_upper_2D);
         uncertainty_lower_2D_ = fabs(uncertainty_t_lower_2D);
         computation_ = false;
+        backend_ = L3D_DEF_BACKEND;
+        num_threads_ = L3D_DEF_NUM_THREADS;
+        host_precision_ = L3D_DEF_HOST_PRECISION;
+        max_hypotheses_ = L3D_DEF_MAX_HYPOTHESES;
+        run_max_hypotheses_ = max_hypotheses_;
+        deterministic_ = L3D_DEF_DETERMINISTIC;
+        memory_budget_ = L3D_DEF_MEMORY_BUDGET_MB;
+        num_potential_corrs_ = 0;
+        max_num_segments_ = L3D_DEF_MAX_NUM_SEGMENTS;
+        merge_fragments_ = L3D_DEF_MERGE_FRAGMENTS;
+        neighbor_selection_ = L3D_DEF_NEIGHBOR_SELECTION;
+        coverage_min_gain_ = L3D_DEF_COVERAGE_MIN_GAIN;
+        matching_time_target_ = L3D_DEF_MATCHING_TIME_TARGET;
+        pair_tests_per_s_ = 0.0;
+        clustering_engine_ = L3D_DEF_CLUSTERING;
+        lp_max_iterations_ = L3D_DEF_LP_MAX_ITERATIONS;
+        affinity_top_k_ = L3D_DEF_AFFINITY_TOP_K;
+        prefetch_threads_ = L3D_DEF_PREFETCH_THREADS;
+        prefetch_buffer_MB_ = L3D_DEF_PREFETCH_BUFFER_MB;
+        prefetcher_ = NULL;
+        numa_aware_ = L3D_DEF_NUMA_AWARE;
+        direction_classes_ = L3D_DEF_DIRECTION_CLASSES;
+        view_culling_ = L3D_DEF_VIEW_CULLING;
         use_collinearity_ = useCollinearity;
         min_baseline_ = min_baseline;
 
@@ -34,6 +57,20 @@ namespace L3D
         boost::filesystem::path dir(data_directory_);
         boost::filesystem::create_directory(dir);
 
+        // tuned kernel parameters of this host
+        if(tuning_.load(L3D::L3DTuningProfile::defaultFile(data_directory_)))
+        {
+            if(num_threads_ <= 0)
+                num_threads_ = tuning_.num_threads_;
+
+            if(verbose_)
+            {
+                std::cout << prefix_ << "tuning profile: threads=" << tuning_.num_threads_;
+                std::cout << ", tasks/thread=" << tuning_.tasks_per_thread_;
+                std::cout << ", index>=" << tuning_.index_min_segments_ << std::endl;
+            }
+        }
+
         // create LSD
         ls_ = cv::createLineSegmentDetectorPtr(cv::LSD_REFINE_ADV);
 
@@ -89,6 +126,181 @@ namespace L3D
         views_.clear();
 
         computation_ = false;
+        stats_.reset();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::setComputeBackend(const int backend, const int num_threads)
+    {
+        if(views_.size() > 0)
+        {
+            std::cerr << prefix_ << "backend must be set before images are added!" << std::endl;
+            return;
+        }
+
+        backend_ = backend;
+        num_threads_ = num_threads;
+        if(num_threads_ <= 0 && tuning_.valid_)
+            num_threads_ = tuning_.num_threads_;
+
+        if(backend_ == L3D_BACKEND_CPU)
+            std::cout << prefix_ << "compute backend: CPU (threads: " << num_threads_ << ")" << std::endl;
+        else
+            std::cout << prefix_ << "compute backend: CUDA" << std::endl;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::autoTune()
+    {
+        if(views_.size() > 0)
+        {
+            std::cerr << prefix_ << "auto tuning must be performed before images are added!" << std::endl;
+            return;
+        }
+
+        std::cout << prefix_ << ">>> AUTO TUNING <<<" << std::endl;
+
+        // calibration scene (segments are projected, not detected)
+        L3D::L3DSyntheticScene scene(L3D_TUNE_VIEWS,L3D_TUNE_BOXES,L3D_TUNE_WIDTH,L3D_TUNE_HEIGHT,
+                                     42,false);
+
+        // start: compile-time defaults, all cores
+        L3D::L3DTuningProfile best;
+        best.host_ = L3D::L3DTuningProfile::hostname();
+        best.num_threads_ = L3D::cpu_num_threads(L3D_DEF_NUM_THREADS);
+
+        double best_throughput = 0.0;
+        double best_ms = tuningRun(scene,best,best_throughput);
+
+        // one parameter after the other (threads, tasks per thread, index threshold)
+        for(unsigned int stage=0; stage<3; ++stage)
+        {
+            std::vector<int> candidates;
+            if(stage == 0)
+            {
+                for(int t=1; t<best.num_threads_; t*=2)
+                    candidates.push_back(t);
+            }
+            else if(stage == 1)
+            {
+                for(int t=1; t<=32; t*=2)
+                    candidates.push_back(t);
+            }
+            else
+            {
+                candidates.push_back(-1);
+                for(int m=128; m<=2048; m*=2)
+                    candidates.push_back(m);
+            }
+
+            for(unsigned int i=0; i<candidates.size(); ++i)
+            {
+                L3D::L3DTuningProfile profile = best;
+                if(stage == 0)
+                    profile.num_threads_ = candidates[i];
+                else if(stage == 1)
+                    profile.tasks_per_thread_ = candidates[i];
+                else
+                    profile.index_min_segments_ = candidates[i];
+
+                if(profile.num_threads_ == best.num_threads_ &&
+                        profile.tasks_per_thread_ == best.tasks_per_thread_ &&
+                        profile.index_min_segments_ == best.index_min_segments_)
+                {
+                    continue;
+                }
+
+                double throughput = 0.0;
+                double ms = tuningRun(scene,profile,throughput);
+                if(ms < best_ms)
+                {
+                    best = profile;
+                    best_ms = ms;
+                    best_throughput = throughput;
+                }
+            }
+        }
+
+        best.valid_ = true;
+        best.pair_tests_per_s_ = best_throughput;
+
+        std::string file = L3D::L3DTuningProfile::defaultFile(data_directory_);
+        best.save(file);
+
+        // thread count taken from the previous profile --> replace it as well
+        bool profile_threads = (tuning_.valid_ && num_threads_ == tuning_.num_threads_);
+        tuning_ = best;
+
+        if(num_threads_ <= 0 || profile_threads)
+            num_threads_ = tuning_.num_threads_;
+
+        std::cout << prefix_ << "best: threads=" << best.num_threads_ << ", tasks/thread=" << best.tasks_per_thread_;
+        std::cout << ", index>=" << best.index_min_segments_ << " --> " << best_ms << "ms";
+        std::cout << " (" << best.pair_tests_per_s_ << " pair tests/s)" << std::endl;
+        std::cout << prefix_ << "profile: " << file << std::endl;
+    }
+
+    //------------------------------------------------------------------------------
+    double Line3D::tuningRun(L3D::L3DSyntheticScene& scene, const L3D::L3DTuningProfile& profile,
+                             double& pair_tests_per_s)
+    {
+        // private scratch directory (never an existing one of the user)
+        boost::filesystem::path scratch;
+        do
+        {
+            scratch = boost::filesystem::path(data_directory_)/boost::filesystem::unique_path("tuning_%%%%-%%%%-%%%%");
+        } while(boost::filesystem::exists(scratch));
+        std::string directory = scratch.string();
+
+        double best_ms = -1.0;
+        pair_tests_per_s = 0.0;
+        for(unsigned int r=0; r<L3D_TUNE_REPEATS; ++r)
+        {
+            // fresh directory --> no stored matches
+            boost::filesystem::remove_all(scratch);
+
+            L3D::Line3D* tuner = new L3D::Line3D(directory,matching_neighbors_,
+                                                 uncertainty_upper_2D_,uncertainty_lower_2D_,
+                                                 sigma_p_,sigma_a_,min_baseline_,false,false);
+            tuner->backend_ = L3D_BACKEND_CPU;
+            tuner->num_threads_ = profile.num_threads_;
+            tuner->tuning_ = profile;
+            tuner->deterministic_ = deterministic_;
+            tuner->numa_aware_ = numa_aware_;
+            tuner->prefetch_threads_ = 0;
+
+            for(unsigned int v=0; v<scene.views()->size(); ++v)
+            {
+                L3D::L3DSyntheticView& view = scene.views()->at(v);
+                std::vector<float4> segments;
+                scene.segments(v,segments);
+                if(segments.size() == 0)
+                    continue;
+
+                tuner->addImageSegments(view.id_,scene.width(),scene.height(),
+                                        view.K_,view.R_,view.t_,view.worldpoints_,
+                                        &segments[0],segments.size());
+            }
+
+            // matching phase only
+            tuner->computeMatches();
+            tuner->releasePrefetcher();
+            L3D::L3DStatistics stats = tuner->getStatistics();
+            delete tuner;
+
+            if(best_ms < 0.0 || stats.time_matching_ < best_ms)
+            {
+                best_ms = stats.time_matching_;
+                if(stats.time_matching_ > 0.0)
+                    pair_tests_per_s = double(stats.num_pair_tests_)/(stats.time_matching_/1000.0);
+            }
+        }
+        boost::filesystem::remove_all(scratch);
+
+        std::cout << prefix_ << "[threads=" << profile.num_threads_ << ", tasks/thread=" << profile.tasks_per_thread_;
+        std::cout << ", index>=" << profile.index_min_segments_ << "] " << best_ms << "ms" << std::endl;
+
+        return best_ms;
     }
 
     //------------------------------------------------------------------------------
@@ -96,7 +308,8 @@ namespace L3D
                           const Eigen::Matrix3d K, const Eigen::Matrix3d R,
                           const Eigen::Vector3d t, std::list<unsigned int>& worldpointIDs,
                           const int maxImgWidth,
-                          const bool loadAndStoreSegments)
+                          const bool loadAndStoreSegments,
+                          const cv::Mat mask)
     {
         if(computation_)
         {
@@ -125,6 +338,11 @@ namespace L3D
             std::cerr << prefix_ << "image is empty!" << std::endl;
             return;
         }
+        else if(!mask.empty() && (mask.type() != CV_8UC1 || mask.rows != image.rows || mask.cols != image.cols))
+        {
+            std::cerr << prefix_ << "mask must be CV_8UC1 and have the size of the image!" << std::endl;
+            return;
+        }
 
         // compute new image sizes
         unsigned int new_width = image.cols;
@@ -140,59 +358,26 @@ namespace L3D
 
         std::cout << prefix_ << "adding image [" << imageID << "] [" << new_width << "x" << new_height << "]" << std::endl;
 
-        // check if features already computed
-        std::stringstream str;
-        if(use_collinearity_)
-            str << "/segments_" << imageID << "_" << new_width << "x" << new_height << "_coll1.bin";
-        else
-            str << "/segments_" << imageID << "_" << new_width << "x" << new_height << "_coll0.bin";
-
-        std::string feature_file = data_directory_+str.str();
-        boost::filesystem::wpath file(feature_file);
-
-        // remove if neccessary
-        if(boost::filesystem::exists(file) && !loadAndStoreSegments)
-        {
-            boost::filesystem::remove(file);
-        }
-
-        L3D::L3DSegments* segments = NULL;
-        if(boost::filesystem::exists(file) && loadAndStoreSegments)
-        {
-            if(verbose_)
-                std::cout << prefix_ << "segments data found" << std::endl;
-
-            // load segments
-            segments = new L3D::L3DSegments();
-            L3D::serializeFromFile(feature_file,*segments);
-        }
-        else
+        // segments (stored, derived from the cached detections or detected)
+        L3D::L3DTimer timer;
+        L3D::L3DSegments* segments = imageSegments(imageID,image,mask,new_width,new_height,
+                                                   loadAndStoreSegments);
+        if(segments == NULL)
         {
-            if(verbose_)
-                std::cout << prefix_ << "performing line segment detection..." << std::endl;
-
-            // detect line segments
-            std::list<float4> lineSegments_vec;
-            float min_length = L3D_DEF_MIN_LINE_LENGTH_F*sqrtf(float(image.rows*image.rows+image.cols*image.cols));
-            if(detectLineSegments(image,lineSegments_vec,new_width,new_height,min_length))
-            {
-                // setup segment data
-                segments = new L3D::L3DSegments(lineSegments_vec,use_collinearity_);
-
-                // serialize to disk
-                if(loadAndStoreSegments)
-                    L3D::serializeToFile(feature_file,*segments);
-            }
-            else
-            {
-                // no segments detected
-                return;
-            }
+            // no segments detected
+            return;
         }
 
         if(verbose_)
             std::cout << prefix_ << "#segments: " << segments->num_segments() << " (final)" << std::endl;
 
+        stats_.time_detection_ += timer.elapsedMS();
+        stats_.num_segments_ += segments->num_segments();
+        ++stats_.num_views_;
+
+        // memory
+        accountSegments(imageID,segments);
+
         // create filenames for binarized matches
         std::stringstream str2;
         str2 << "/matches_" << imageID << "_" << new_width << "x" << new_height;
@@ -221,7 +406,8 @@ namespace L3D
                                     const Eigen::Matrix3d K, const Eigen::Matrix3d R,
                                     const Eigen::Vector3d t, std::map<unsigned int,float>& viewSimilarity,
                                     const int maxImgWidth,
-                                    const bool loadAndStoreSegments)
+                                    const bool loadAndStoreSegments,
+                                    const cv::Mat mask)
     {
         if(computation_)
         {
@@ -250,6 +436,11 @@ namespace L3D
             std::cerr << prefix_ << "image is empty!" << std::endl;
             return;
         }
+        else if(!mask.empty() && (mask.type() != CV_8UC1 || mask.rows != image.rows || mask.cols != image.cols))
+        {
+            std::cerr << prefix_ << "mask must be CV_8UC1 and have the size of the image!" << std::endl;
+            return;
+        }
 
         // compute new image sizes
         unsigned int new_width = image.cols;
@@ -265,20 +456,163 @@ namespace L3D
 
         std::cout << prefix_ << "adding image [" << imageID << "] [" << new_width << "x" << new_height << "]" << std::endl;
 
-        // check if features already computed
+        // segments (stored, derived from the cached detections or detected)
+        L3D::L3DTimer timer;
+        L3D::L3DSegments* segments = imageSegments(imageID,image,mask,new_width,new_height,
+                                                   loadAndStoreSegments);
+        if(segments == NULL)
+        {
+            // no segments detected
+            return;
+        }
+
+        if(verbose_)
+            std::cout << prefix_ << "#segments: " << segments->num_segments() << " (final)" << std::endl;
+
+        stats_.time_detection_ += timer.elapsedMS();
+        stats_.num_segments_ += segments->num_segments();
+        ++stats_.num_views_;
+
+        // memory
+        accountSegments(imageID,segments);
+
+        // create filenames for binarized matches
+        std::stringstream str2;
+        str2 << "/matches_" << imageID << "_" << new_width << "x" << new_height;
+        std::string match_file = data_directory_+str2.str();
+
+        // create view
+        views_[imageID] = new L3D::L3DView(imageID,segments,K,R,t,
+                                           image.cols,image.rows,
+                                           uncertainty_upper_2D_,
+                                           uncertainty_lower_2D_,
+                                           match_file,
+                                           prefix_);
+
+        if(verbose_)
+        {
+            std::cout << prefix_ << "minimum uncertainty in depth=1: " << views_[imageID]->uncertainty_k_lower() << std::endl;
+            std::cout << prefix_ << "maximum uncertainty in depth=1: " << views_[imageID]->uncertainty_k_upper() << std::endl;
+        }
+
+        // update view similarity
+        setViewSimilarity(imageID,viewSimilarity);
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::addImageSegments(const unsigned int imageID,
+                                  const unsigned int width, const unsigned int height,
+                                  const Eigen::Matrix3d K, const Eigen::Matrix3d R,
+                                  const Eigen::Vector3d t, std::list<unsigned int>& worldpointIDs,
+                                  const float4* segments, const unsigned int num_segments)
+    {
+        if(computation_)
+        {
+            std::cerr << "reconstruction already performed! cannot add more images (try reset first)" << std::endl;
+            return;
+        }
+
+        if(views_.size() == 0)
+           std::cout << prefix_ << ">>> LOADING DATA <<<" << std::endl;
+
+        // check for unique ID
+        if(views_.find(imageID) != views_.end())
+        {
+            std::cerr << prefix_ << "imageID already in use!" << std::endl;
+            return;
+        }
+        else if(worldpointIDs.size() == 0)
+        {
+            std::cerr << prefix_ << "unlinked images cannot be added! (no worldpoints)" << std::endl;
+            return;
+        }
+
+        // check segments
+        if(width == 0 || height == 0)
+        {
+            std::cerr << prefix_ << "image is empty!" << std::endl;
+            return;
+        }
+        else if(segments == NULL || num_segments == 0)
+        {
+            std::cerr << prefix_ << "no segments given!" << std::endl;
+            return;
+        }
+
+        std::cout << prefix_ << "adding segments [" << imageID << "] [" << width << "x" << height << "]" << std::endl;
+
+        // segments (external, collinearity only)
+        L3D::L3DTimer timer;
+        L3D::L3DSegments* view_segments = new L3D::L3DSegments(segments,num_segments,
+                                                               collinearityWithinBudget(imageID),
+                                                               backend_,num_threads_);
+
+        if(verbose_)
+            std::cout << prefix_ << "#segments: " << view_segments->num_segments() << " (external)" << std::endl;
+
+        stats_.time_detection_ += timer.elapsedMS();
+        stats_.num_segments_ += view_segments->num_segments();
+        ++stats_.num_views_;
+
+        // memory
+        accountSegments(imageID,view_segments);
+
+        // create filenames for binarized matches
+        std::stringstream str2;
+        str2 << "/matches_" << imageID << "_" << width << "x" << height << "_ext";
+        std::string match_file = data_directory_+str2.str();
+
+        // create view
+        views_[imageID] = new L3D::L3DView(imageID,view_segments,K,R,t,
+                                           width,height,
+                                           uncertainty_upper_2D_,
+                                           uncertainty_lower_2D_,
+                                           match_file,
+                                           prefix_);
+
+        if(verbose_)
+        {
+            std::cout << prefix_ << "minimum uncertainty in depth=1: " << views_[imageID]->uncertainty_k_lower() << std::endl;
+            std::cout << prefix_ << "maximum uncertainty in depth=1: " << views_[imageID]->uncertainty_k_upper() << std::endl;
+        }
+
+        // update neighborhood (worldpoint IDs)
+        processWorldpointList(imageID,worldpointIDs);
+    }
+
+    //------------------------------------------------------------------------------
+    L3D::L3DSegments* Line3D::imageSegments(const unsigned int imageID, const cv::Mat& image,
+                                            const cv::Mat& mask,
+                                            const unsigned int new_width, const unsigned int new_height,
+                                            const bool loadAndStoreSegments)
+    {
+        // collinearity (not for new views once the memory budget is exceeded)
+        bool collinearity = collinearityWithinBudget(imageID);
+
+        // check if features already computed (same mask)
+        std::string mask_suffix = maskSuffix(mask);
         std::stringstream str;
-        if(use_collinearity_)
-            str << "/segments_" << imageID << "_" << new_width << "x" << new_height << "_coll1.bin";
+        if(collinearity)
+            str << "/segments_" << imageID << "_" << new_width << "x" << new_height << mask_suffix << selectionSuffix() << "_coll1.bin";
         else
-            str << "/segments_" << imageID << "_" << new_width << "x" << new_height << "_coll0.bin";
+            str << "/segments_" << imageID << "_" << new_width << "x" << new_height << mask_suffix << selectionSuffix() << "_coll0.bin";
 
         std::string feature_file = data_directory_+str.str();
         boost::filesystem::wpath file(feature_file);
 
+        // raw detections (finest resolution so far)
+        std::stringstream str_det;
+        str_det << "/detections_" << imageID << mask_suffix << ".bin";
+        std::string detection_file = data_directory_+str_det.str();
+        boost::filesystem::wpath det_file(detection_file);
+
         // remove if neccessary
-        if(boost::filesystem::exists(file) && !loadAndStoreSegments)
+        if(!loadAndStoreSegments)
         {
-            boost::filesystem::remove(file);
+            if(boost::filesystem::exists(file))
+                boost::filesystem::remove(file);
+            if(boost::filesystem::exists(det_file))
+                boost::filesystem::remove(det_file);
         }
 
         L3D::L3DSegments* segments = NULL;
@@ -290,55 +624,69 @@ namespace L3D
             // load segments
             segments = new L3D::L3DSegments();
             L3D::serializeFromFile(feature_file,*segments);
+            return segments;
         }
-        else
+
+        // cached detections of the same or a finer resolution
+        std::vector<float4> detections;
+        float upscale_factor = 1.0f;
+        float min_scaled_length = 0.0f;
+        bool derived = false;
+        if(boost::filesystem::exists(det_file) && loadAndStoreSegments)
+        {
+            L3D::L3DDetections cache;
+            L3D::serializeFromFile(detection_file,cache);
+            if(cache.width() >= new_width && cache.height() >= new_height)
+            {
+                cache.detections(detections);
+                derived = true;
+
+                // same scaling as in detectRawSegments
+                float w_diff = float(new_width)/float(image.cols);
+                float h_diff = float(new_height)/float(image.rows);
+                upscale_factor = 1.0f/(0.5f*(w_diff+h_diff));
+
+                // coarser: segments which are too short to be detected there
+                if(cache.width() > new_width || cache.height() > new_height)
+                    min_scaled_length = L3D_DERIVED_MIN_LENGTH_PX;
+
+                if(verbose_)
+                    std::cout << prefix_ << "segments derived from cached detections [" << cache.width() << "x" << cache.height() << "]" << std::endl;
+            }
+        }
+
+        if(!derived)
         {
             if(verbose_)
                 std::cout << prefix_ << "performing line segment detection..." << std::endl;
 
             // detect line segments
-            std::list<float4> lineSegments_vec;
-            float min_length = L3D_DEF_MIN_LINE_LENGTH_F*sqrtf(float(image.rows*image.rows+image.cols*image.cols));
-            if(detectLineSegments(image,lineSegments_vec,new_width,new_height,min_length))
-            {
-                // setup segment data
-                segments = new L3D::L3DSegments(lineSegments_vec,use_collinearity_);
+            if(!detectRawSegments(image,mask,detections,new_width,new_height,upscale_factor))
+                return NULL;
 
-                // serialize to disk
-                if(loadAndStoreSegments)
-                    L3D::serializeToFile(feature_file,*segments);
-            }
-            else
+            // keep the finest detections (cached ones are coarser)
+            if(loadAndStoreSegments)
             {
-                // no segments detected
-                return;
+                L3D::L3DDetections cache(detections,new_width,new_height);
+                L3D::serializeToFile(detection_file,cache);
             }
         }
 
-        if(verbose_)
-            std::cout << prefix_ << "#segments: " << segments->num_segments() << " (final)" << std::endl;
-
-        // create filenames for binarized matches
-        std::stringstream str2;
-        str2 << "/matches_" << imageID << "_" << new_width << "x" << new_height;
-        std::string match_file = data_directory_+str2.str();
+        // merging, filtering and segment cap
+        std::list<float4> lineSegments_vec;
+        float min_length = L3D_DEF_MIN_LINE_LENGTH_F*sqrtf(float(image.rows*image.rows+image.cols*image.cols));
+        selectLineSegments(detections,lineSegments_vec,image.cols,image.rows,
+                           upscale_factor,min_length,min_scaled_length);
 
-        // create view
-        views_[imageID] = new L3D::L3DView(imageID,segments,K,R,t,
-                                           image.cols,image.rows,
-                                           uncertainty_upper_2D_,
-                                           uncertainty_lower_2D_,
-                                           match_file,
-                                           prefix_);
+        // setup segment data
+        segments = new L3D::L3DSegments(lineSegments_vec,collinearity,
+                                        backend_,num_threads_);
 
-        if(verbose_)
-        {
-            std::cout << prefix_ << "minimum uncertainty in depth=1: " << views_[imageID]->uncertainty_k_lower() << std::endl;
-            std::cout << prefix_ << "maximum uncertainty in depth=1: " << views_[imageID]->uncertainty_k_upper() << std::endl;
-        }
+        // serialize to disk
+        if(loadAndStoreSegments)
+            L3D::serializeToFile(feature_file,*segments);
 
-        // update view similarity
-        setViewSimilarity(imageID,viewSimilarity);
+        return segments;
     }
 
     //------------------------------------------------------------------------------
@@ -350,6 +698,39 @@ namespace L3D
             return;
         }
 
+        L3D::L3DTimer total;
+        computeMatches();
+
+        // optimize correspondences (per cluster)
+        L3D::L3DTimer timer;
+        prefetcher_->resetStatistics();
+        optimizeLocalMatches();
+        stats_.time_selection_ = timer.elapsedMS();
+        stats_.time_io_selection_ = prefetcher_->waitMS();
+
+        if(verbose_)
+            printIOStatistics(stats_.time_io_selection_,stats_.time_selection_);
+
+        // match files are not read anymore
+        releasePrefetcher();
+
+        // cluster corresponding segments
+        timer.start();
+        clusterSegments2D(perform_diffusion);
+
+        // segments of the culled views
+        if(view_culling_ == L3D_CULLING_REATTACH)
+            reattachCulledViews();
+        stats_.time_clustering_ = timer.elapsedMS();
+
+        stats_.time_total_ = total.elapsedMS();
+
+        printMemoryReport();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::computeMatches()
+    {
         computation_ = true;
 
         // reset everything that was computed previously
@@ -357,20 +738,179 @@ namespace L3D
         potential_correspondences_.clear();
         clustered_result_.clear();
 
+        stats_.num_raw_matches_ = 0;
+        stats_.num_pair_tests_ = 0;
+        stats_.num_pair_tests_skipped_ = 0;
+        stats_.num_views_culled_ = 0;
+        stats_.num_segments_reattached_ = 0;
+        stats_.num_matches_ = 0;
+        stats_.num_correspondences_ = 0;
+        stats_.num_affinities_ = 0;
+        stats_.num_affinities_kept_ = 0;
+        stats_.num_clusters_ = 0;
+        stats_.num_lines_ = 0;
+        stats_.time_partitioning_ = 0.0;
+        stats_.time_io_matching_ = 0.0;
+        stats_.time_io_selection_ = 0.0;
+        stats_.load_balance_.reset();
+        stats_.memory_.set(L3D_MEM_MATCHES,0);
+        stats_.memory_.set(L3D_MEM_CORRESPONDENCES,0);
+        stats_.memory_.set(L3D_MEM_AFFINITIES,0);
+        stats_.memory_.set(L3D_MEM_CLUSTERS,0);
+        num_potential_corrs_ = 0;
+        L3D::L3DTimer timer;
+
+        // redundant views
+        culled_.clear();
+        if(view_culling_ != L3D_CULLING_OFF)
+            cullRedundantViews();
+
         // find visual neighbors
         findVisualNeighbors();
 
         // transform geometry
         transformGeometry();
 
+        // direction classes
+        segment_classes_.clear();
+        if(direction_classes_)
+            estimateDirectionClasses();
+        stats_.time_neighbors_ = timer.elapsedMS();
+
+        // match file I/O
+        prefetcher_ = new L3D::L3DMatchPrefetcher(prefetch_threads_,
+                                                   size_t(std::max(prefetch_buffer_MB_,0.0f)*1024.0f*1024.0f));
+        std::map<unsigned int,L3D::L3DView*>::iterator v = views_.begin();
+        for(; v!=views_.end(); ++v)
+            v->second->setPrefetcher(prefetcher_);
+
         // match views
+        timer.start();
         matchViews();
+        stats_.time_matching_ = timer.elapsedMS();
+        stats_.time_io_matching_ = prefetcher_->waitMS();
 
-        // optimize correspondences (per cluster)
-        optimizeLocalMatches();
+        if(verbose_ || matching_time_target_ > 0.0f)
+        {
+            std::cout << prefix_ << "pair tests: " << stats_.num_pair_tests_ << " in " << stats_.time_matching_/1000.0 << "s";
+            if(stats_.time_matching_ > 0.0)
+                std::cout << " (" << double(stats_.num_pair_tests_)/(stats_.time_matching_/1000.0) << "/s)";
+            if(matching_time_target_ > 0.0f)
+                std::cout << ", target: " << matching_time_target_ << "s";
+            if(stats_.num_pair_tests_skipped_ > 0)
+                std::cout << ", skipped (direction classes): " << stats_.num_pair_tests_skipped_;
+            std::cout << std::endl;
+        }
 
-        // cluster corresponding segments
-        clusterSegments2D(perform_diffusion);
+        if(verbose_ && backend_ == L3D_BACKEND_CPU && stats_.load_balance_.num_tasks_ > 0)
+        {
+            std::cout << prefix_ << "load imbalance: " << 100.0*stats_.load_balance_.imbalance() << "% idle (";
+            std::cout << stats_.load_balance_.num_tasks_ << " tasks)" << std::endl;
+        }
+
+        if(verbose_)
+            printIOStatistics(stats_.time_io_matching_,stats_.time_matching_);
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::releasePrefetcher()
+    {
+        if(prefetcher_ == NULL)
+            return;
+
+        std::map<unsigned int,L3D::L3DView*>::iterator v = views_.begin();
+        for(; v!=views_.end(); ++v)
+            v->second->setPrefetcher(NULL);
+
+        delete prefetcher_;
+        prefetcher_ = NULL;
+    }
+
+    //------------------------------------------------------------------------------
+    bool Line3D::memoryBudgetExceeded()
+    {
+        if(memory_budget_ <= 0.0f)
+            return false;
+
+        return (double(stats_.memory_.total()) > double(memory_budget_)*1024.0*1024.0);
+    }
+
+    //------------------------------------------------------------------------------
+    bool Line3D::collinearityWithinBudget(const unsigned int viewID)
+    {
+        if(!use_collinearity_)
+            return false;
+
+        if(!memoryBudgetExceeded())
+            return true;
+
+        std::cerr << prefix_ << "WARNING: memory budget exceeded, collinearity disabled for view [" << viewID << "]" << std::endl;
+        return false;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::releaseCorrespondences(const L3D::L3DSegment2D& src)
+    {
+        std::map<L3D::L3DSegment2D,std::map<L3D::L3DSegment2D,bool> >::iterator pc = potential_correspondences_.find(src);
+        if(pc == potential_correspondences_.end())
+            return;
+
+        num_potential_corrs_ -= pc->second.size();
+        potential_correspondences_.erase(pc);
+        stats_.memory_.set(L3D_MEM_CORRESPONDENCES,
+                           L3D::L3DMemoryTracker::mapBytes<L3D::L3DSegment2D,L3D::L3DCorrespondenceRRW>(best_match_.size())+
+                           L3D::L3DMemoryTracker::mapBytes<L3D::L3DSegment2D,std::map<L3D::L3DSegment2D,bool> >(potential_correspondences_.size())+
+                           L3D::L3DMemoryTracker::mapBytes<L3D::L3DSegment2D,bool>(num_potential_corrs_));
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::accountSegments(const unsigned int viewID, L3D::L3DSegments* segments)
+    {
+        // coordinates (segment data + copy for matching)
+        stats_.memory_.add(L3D_MEM_SEGMENTS,2*segments->num_segments()*4*sizeof(float));
+
+        // collinearity
+        size_t num_collin = 0;
+        std::map<unsigned int,std::map<unsigned int,float> >::iterator it = segments->collinearities()->begin();
+        for(; it!=segments->collinearities()->end(); ++it)
+            num_collin += it->second.size();
+
+        size_t collin_bytes = L3D::L3DMemoryTracker::mapBytes<unsigned int,std::map<unsigned int,float> >(segments->collinearities()->size())+
+                L3D::L3DMemoryTracker::mapBytes<unsigned int,float>(num_collin);
+        stats_.memory_.add(L3D_MEM_COLLINEARITY,collin_bytes);
+
+        if(memoryBudgetExceeded() && collin_bytes > 0)
+        {
+            // degrade: no collinearity for the view which exceeds the budget
+            std::cerr << prefix_ << "WARNING: memory budget exceeded, collinearity disabled for view [" << viewID << "]" << std::endl;
+            segments->collinearities()->clear();
+            stats_.memory_.remove(L3D_MEM_COLLINEARITY,collin_bytes);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::printMemoryReport()
+    {
+        std::cout << prefix_ << separator_ << std::endl;
+        std::cout << prefix_ << "memory (peak, estimated):" << std::endl;
+        for(unsigned int i=0; i<L3D_MEM_NUM_STRUCTURES; ++i)
+        {
+            std::cout << prefix_ << "  " << L3D::L3DMemoryTracker::name(i) << ": ";
+            std::cout << double(stats_.memory_.peak(i))/(1024.0*1024.0) << "MB" << std::endl;
+        }
+        std::cout << prefix_ << "  total: " << double(stats_.memory_.peak_total())/(1024.0*1024.0) << "MB";
+        if(memory_budget_ > 0.0f)
+            std::cout << " (budget: " << memory_budget_ << "MB)";
+        std::cout << std::endl;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::printIOStatistics(const double io_ms, const double stage_ms)
+    {
+        std::cout << prefix_ << "match file I/O: " << io_ms << "ms blocked";
+        if(stage_ms > 0.0)
+            std::cout << " (" << 100.0*io_ms/stage_ms << "% of the stage)";
+        std::cout << ", " << prefetcher_->numHits() << "/" << prefetcher_->numLoads() << " prefetched" << std::endl;
     }
 
     //------------------------------------------------------------------------------
@@ -380,6 +920,19 @@ namespace L3D
         result = clustered_result_;
     }
 
+    //------------------------------------------------------------------------------
+    void Line3D::getSelectedCorrespondences(std::map<L3D::L3DSegment2D,L3D::L3DSegment2D>& corrs)
+    {
+        corrs.clear();
+
+        std::map<L3D::L3DSegment2D,L3D::L3DCorrespondenceRRW>::iterator it = best_match_.begin();
+        for(; it!=best_match_.end(); ++it)
+        {
+            if(it->second.valid())
+                corrs[it->first] = it->second.tgt();
+        }
+    }
+
     //------------------------------------------------------------------------------
     void Line3D::save3DLinesAsSTL(std::list<L3D::L3DFinalLine3D>& result, std::string filename)
     {
@@ -451,25 +1004,172 @@ namespace L3D
                 Eigen::Vector3d P1 = (*it2).first;
                 Eigen::Vector3d P2 = (*it2).second;
 
-                file << P1.x() << " " << P1.y() << " " << P1.z() << " ";
-                file << P2.x() << " " << P2.y() << " " << P2.z() << " ";
-            }
+                file << P1.x() << " " << P1.y() << " " << P1.z() << " ";
+                file << P2.x() << " " << P2.y() << " " << P2.z() << " ";
+            }
+
+            // write 2D residuals
+            file << current.segments2D()->size() << " ";
+            std::list<L3D::L3DSegment2D>::iterator it3 = current.segments2D()->begin();
+            for(; it3!=current.segments2D()->end(); ++it3)
+            {
+                file << (*it3).camID() << " " << (*it3).segID() << " ";
+                float4 coords = getSegment2D(*it3);
+                file << coords.x << " " << coords.y << " ";
+                file << coords.z << " " << coords.w << " ";
+            }
+
+            file << std::endl;
+        }
+
+        file.close();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::save2D3DAssociationIndex(std::list<L3D::L3DFinalLine3D>& result, std::string filename)
+    {
+        // camera table (indexed by camID)
+        unsigned int num_cameras = 0;
+        if(views_.size() > 0)
+            num_cameras = views_.rbegin()->first+1;
+
+        std::vector<L3D::L3DAssocCamera> cameras(num_cameras);
+        uint32_t num_segments = 0;
+        for(unsigned int i=0; i<num_cameras; ++i)
+        {
+            cameras[i].offset_ = num_segments;
+            cameras[i].num_segments_ = 0;
+
+            if(views_.find(i) != views_.end())
+            {
+                cameras[i].num_segments_ = views_[i]->seg_coords()->height();
+                num_segments += cameras[i].num_segments_;
+            }
+        }
+
+        // segment -> line and line -> segments (CSR)
+        std::vector<uint32_t> seg2line(num_segments,L3D_ASSOC_NO_LINE);
+        std::vector<uint32_t> line_offsets;
+        std::vector<L3D::L3DAssocSegmentRef> refs;
+
+        uint32_t lineID = 0;
+        std::list<L3D::L3DFinalLine3D>::iterator it = result.begin();
+        for(; it!=result.end(); ++it)
+        {
+            // same numbering as the txt file
+            if(it->segments3D()->size() == 0)
+                continue;
+
+            line_offsets.push_back(refs.size());
+
+            std::list<L3D::L3DSegment2D>::iterator it2 = it->segments2D()->begin();
+            for(; it2!=it->segments2D()->end(); ++it2)
+            {
+                unsigned int camID = (*it2).camID();
+                unsigned int segID = (*it2).segID();
+
+                if(camID >= num_cameras || segID >= cameras[camID].num_segments_)
+                    continue;
+
+                seg2line[cameras[camID].offset_+segID] = lineID;
+
+                L3D::L3DAssocSegmentRef ref;
+                ref.camID_ = camID;
+                ref.segID_ = segID;
+                refs.push_back(ref);
+            }
+
+            ++lineID;
+        }
+        line_offsets.push_back(refs.size());
+
+        // header
+        L3D::L3DAssocHeader header;
+        memcpy(header.magic_,L3D_ASSOC_MAGIC,8);
+        header.version_ = L3D_ASSOC_VERSION;
+        header.num_cameras_ = num_cameras;
+        header.num_lines_ = lineID;
+        header.num_segments_ = num_segments;
+        header.num_refs_ = refs.size();
+        header.reserved_ = 0;
+
+        // write
+        std::ofstream file;
+        file.open(filename.c_str(),std::ios::out | std::ios::binary);
+
+        file.write((const char*)&header,sizeof(L3D::L3DAssocHeader));
+        if(cameras.size() > 0)
+            file.write((const char*)&cameras[0],cameras.size()*sizeof(L3D::L3DAssocCamera));
+        if(seg2line.size() > 0)
+            file.write((const char*)&seg2line[0],seg2line.size()*sizeof(uint32_t));
+        file.write((const char*)&line_offsets[0],line_offsets.size()*sizeof(uint32_t));
+        if(refs.size() > 0)
+            file.write((const char*)&refs[0],refs.size()*sizeof(L3D::L3DAssocSegmentRef));
+
+        file.close();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::cullRedundantViews()
+    {
+        std::cout << prefix_ << separator_ << std::endl;
+        std::cout << prefix_ << ">>> CULLING REDUNDANT VIEWS <<<" << std::endl;
+
+        // candidates, views with many worldpoints become representatives first
+        std::vector<std::pair<unsigned int,unsigned int> > order;
+        std::map<unsigned int,bool> open;
+        std::map<unsigned int,L3D::L3DView*>::iterator v = views_.begin();
+        for(; v!=views_.end(); ++v)
+        {
+            if(roi_.active() && !viewInRegion(v->first))
+                continue;
+
+            order.push_back(std::pair<unsigned int,unsigned int>(num_wps_[v->first],v->first));
+            open[v->first] = true;
+        }
+        std::sort(order.rbegin(),order.rend());
+
+        float cos_max = cos(L3D_CULL_MAX_ANGLE);
+        for(unsigned int i=0; i<order.size(); ++i)
+        {
+            unsigned int rep = order[i].second;
+            if(!open[rep])
+                continue;
+
+            open[rep] = false;
+            if(common_wps_.find(rep) == common_wps_.end())
+                continue;
 
-            // write 2D residuals
-            file << current.segments2D()->size() << " ";
-            std::list<L3D::L3DSegment2D>::iterator it3 = current.segments2D()->begin();
-            for(; it3!=current.segments2D()->end(); ++it3)
+            // viewing direction (optical axis, world space)
+            L3D::L3DView* view = views_[rep];
+            Eigen::Vector3d dir_rep = view->R().row(2).transpose();
+
+            // only views with common worldpoints can be redundant
+            std::map<unsigned int,unsigned int>::iterator n = common_wps_[rep].begin();
+            for(; n!=common_wps_[rep].end(); ++n)
             {
-                file << (*it3).camID() << " " << (*it3).segID() << " ";
-                float4 coords = getSegment2D(*it3);
-                file << coords.x << " " << coords.y << " ";
-                file << coords.z << " " << coords.w << " ";
-            }
+                if(open.find(n->first) == open.end() || !open[n->first])
+                    continue;
 
-            file << std::endl;
+                L3D::L3DView* other = views_[n->first];
+                if(view->baseline(other) > min_baseline_)
+                    continue;
+
+                Eigen::Vector3d dir = other->R().row(2).transpose();
+                if(dir_rep.dot(dir) < cos_max)
+                    continue;
+
+                unsigned int smaller = std::min(num_wps_[rep],num_wps_[n->first]);
+                if(smaller == 0 || float(n->second) < L3D_CULL_MIN_OVERLAP*float(smaller))
+                    continue;
+
+                culled_[n->first] = rep;
+                open[n->first] = false;
+            }
         }
 
-        file.close();
+        stats_.num_views_culled_ = culled_.size();
+        std::cout << prefix_ << culled_.size() << " of " << order.size() << " views culled" << std::endl;
     }
 
     //------------------------------------------------------------------------------
@@ -500,15 +1200,105 @@ namespace L3D
             }
         }
 
+        // worldpoints per view (sorted, coverage selection only)
+        std::map<unsigned int,std::vector<unsigned int> > view2wps;
+        if(neighbor_selection_ == L3D_NEIGHBORS_COVERAGE)
+        {
+            std::map<unsigned int,std::map<unsigned int,bool> >::iterator wp = worldpoints2views_.begin();
+            for(; wp!=worldpoints2views_.end(); ++wp)
+            {
+                if(wp->second.size() < 3)
+                    continue;
+
+                std::map<unsigned int,bool>::iterator wv = wp->second.begin();
+                for(; wv!=wp->second.end(); ++wv)
+                    view2wps[wv->first].push_back(wp->first);
+            }
+        }
+
+        // region of interest
+        std::map<unsigned int,bool> in_region;
+        std::map<unsigned int,L3D::L3DView*>::iterator v = views_.begin();
+        for(; v!=views_.end(); ++v)
+            in_region[v->first] = viewInRegion(v->first);
+
+        // adaptive matching budget [pair tests]
+        double budget = 0.0;
+        unsigned int remaining_views = 0;
+        std::set<std::pair<unsigned int,unsigned int> > charged;
+        if(matching_time_target_ > 0.0f)
+        {
+            double throughput = pair_tests_per_s_;
+            if(throughput <= 0.0)
+            {
+                if(backend_ == L3D_BACKEND_CUDA)
+                    throughput = L3D_PAIR_TESTS_PER_S_CUDA;
+                else if(tuning_.valid_ && tuning_.pair_tests_per_s_ > 0.0)
+                    throughput = tuning_.pair_tests_per_s_;
+                else
+                    throughput = L3D_PAIR_TESTS_PER_S_CPU*double(L3D::cpu_num_threads(num_threads_));
+            }
+            budget = double(matching_time_target_)*throughput;
+
+            std::map<unsigned int,std::map<unsigned int,float> >::iterator bit = view_similarities_.begin();
+            for(; bit!=view_similarities_.end(); ++bit)
+            {
+                if(views_.find(bit->first) != views_.end() && (!roi_.active() || in_region[bit->first]) &&
+                        culled_.find(bit->first) == culled_.end())
+                    ++remaining_views;
+            }
+
+            if(verbose_)
+                std::cout << prefix_ << "matching budget: " << budget << " pair tests (" << matching_time_target_ << "s)" << std::endl;
+        }
+
         // define visual neighbors
+        stats_.num_neighbor_pairs_ = 0;
         std::map<unsigned int,std::map<unsigned int,float> >::iterator sit = view_similarities_.begin();
         for(; sit!=view_similarities_.end(); ++sit)
         {
+            if(roi_.active() && !in_region[sit->first])
+            {
+                if(verbose_)
+                    std::cout << prefix_ << "image [" << sit->first << "] outside the region of interest" << std::endl;
+                continue;
+            }
+
+            if(culled_.find(sit->first) != culled_.end())
+            {
+                if(verbose_)
+                    std::cout << prefix_ << "image [" << sit->first << "] culled (represented by [" << culled_[sit->first] << "])" << std::endl;
+                continue;
+            }
+
             std::cout << prefix_ << "setting VNs for image [" << sit->first << "]" << std::endl;
             std::list<L3D::L3DVisualNeighbor> vn;
             std::map<unsigned int,float>::iterator n = sit->second.begin();
+
+            bool coverage = (neighbor_selection_ == L3D_NEIGHBORS_COVERAGE &&
+                             view2wps.find(sit->first) != view2wps.end());
+
             for(; n!=sit->second.end(); ++n)
             {
+                if(roi_.active() && !in_region[n->first])
+                    continue;
+
+                if(culled_.find(n->first) != culled_.end())
+                    continue;
+
+                if(coverage)
+                {
+                    // candidates (baseline w.r.t. the selection is checked later)
+                    if(views_.find(n->first) != views_.end() && views_[sit->first]->baseline(views_[n->first]) > min_baseline_)
+                    {
+                        L3D::L3DVisualNeighbor neighbor;
+                        neighbor.camID_ = n->first;
+                        neighbor.similarity_ = n->second;
+                        vn.push_back(neighbor);
+                    }
+                    continue;
+                }
+
                 if(views_.find(n->first) != views_.end() && views_[sit->first]->baseline(views_[n->first]) > min_baseline_)
                 {
                     // check existing VNs (baseline)
@@ -534,20 +1324,326 @@ namespace L3D
             // sort by similarity
             vn.sort(L3D::sortVisualNeighbors);
 
+            // greedy coverage selection
+            if(coverage)
+            {
+                std::list<L3D::L3DVisualNeighbor> candidates = vn;
+                selectCoverageNeighbors(sit->first,candidates,view2wps,vn);
+            }
+
             // limit number of neighbors
             if(matching_neighbors_ > 0 && int(vn.size()) > matching_neighbors_)
                 vn.resize(matching_neighbors_);
 
+            // adaptive budget
+            if(matching_time_target_ > 0.0f)
+                applyMatchingBudget(sit->first,vn,charged,budget,remaining_views);
+
             // store
             std::list<L3D::L3DVisualNeighbor>::iterator neigh_lst = vn.begin();
             for(; neigh_lst != vn.end(); ++neigh_lst)
                 visual_neighbors_[sit->first][(*neigh_lst).camID_] = true;
 
+            stats_.num_neighbor_pairs_ += vn.size();
+
             if(verbose_)
                 std::cout << prefix_ << vn.size() << " visual neighbors found" << std::endl;
         }
     }
 
+    //------------------------------------------------------------------------------
+    void Line3D::selectCoverageNeighbors(const unsigned int vID,
+                                         std::list<L3D::L3DVisualNeighbor>& candidates,
+                                         std::map<unsigned int,std::vector<unsigned int> >& view2wps,
+                                         std::list<L3D::L3DVisualNeighbor>& selected)
+    {
+        selected.clear();
+        std::vector<unsigned int>& wps_src = view2wps[vID];
+        if(wps_src.size() == 0)
+            return;
+
+        // common worldpoints per candidate (as indices into wps_src)
+        std::vector<L3D::L3DVisualNeighbor> cand(candidates.begin(),candidates.end());
+        std::vector<std::vector<unsigned int> > common(cand.size());
+        std::vector<Eigen::Vector3d> dirs(cand.size());
+        for(unsigned int i=0; i<cand.size(); ++i)
+        {
+            std::vector<unsigned int>& wps = view2wps[cand[i].camID_];
+            unsigned int a = 0;
+            unsigned int b = 0;
+            while(a < wps_src.size() && b < wps.size())
+            {
+                if(wps_src[a] < wps[b])
+                {
+                    ++a;
+                }
+                else if(wps[b] < wps_src[a])
+                {
+                    ++b;
+                }
+                else
+                {
+                    common[i].push_back(a);
+                    ++a;
+                    ++b;
+                }
+            }
+
+            // viewing direction (relative to the source)
+            dirs[i] = views_[cand[i].camID_]->C()-views_[vID]->C();
+            if(dirs[i].norm() > L3D_EPS)
+                dirs[i].normalize();
+        }
+
+        // greedy selection
+        std::vector<unsigned int> covered(wps_src.size(),0);
+        std::vector<bool> used(cand.size(),false);
+        std::vector<unsigned int> chosen;
+        while(matching_neighbors_ <= 0 || int(chosen.size()) < matching_neighbors_)
+        {
+            int best = -1;
+            float best_score = 0.0f;
+            for(unsigned int i=0; i<cand.size(); ++i)
+            {
+                if(used[i])
+                    continue;
+
+                // baseline w.r.t. selected neighbors
+                bool baseline_valid = true;
+                for(unsigned int k=0; k<chosen.size() && baseline_valid; ++k)
+                {
+                    if(views_[cand[chosen[k]].camID_]->baseline(views_[cand[i].camID_]) <= min_baseline_)
+                        baseline_valid = false;
+                }
+                if(!baseline_valid)
+                {
+                    used[i] = true;
+                    continue;
+                }
+
+                // coverage gain (diminishing returns)
+                float gain = 0.0f;
+                for(unsigned int k=0; k<common[i].size(); ++k)
+                    gain += powf(L3D_COVERAGE_DECAY,float(covered[common[i][k]]));
+                gain /= float(wps_src.size());
+
+                // viewing angle spread
+                float novelty = 1.0f;
+                for(unsigned int k=0; k<chosen.size(); ++k)
+                    novelty = fmin(novelty,0.5f*float(1.0-dirs[i].dot(dirs[chosen[k]])));
+
+                float score = gain*(1.0f-L3D_COVERAGE_ANGLE_WEIGHT+L3D_COVERAGE_ANGLE_WEIGHT*novelty);
+                if(score > best_score)
+                {
+                    best = i;
+                    best_score = score;
+                }
+            }
+
+            if(best < 0 || best_score < coverage_min_gain_)
+                break;
+
+            used[best] = true;
+            chosen.push_back(best);
+            for(unsigned int k=0; k<common[best].size(); ++k)
+                ++covered[common[best][k]];
+
+            selected.push_back(cand[best]);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::applyMatchingBudget(const unsigned int vID, std::list<L3D::L3DVisualNeighbor>& vn,
+                                     std::set<std::pair<unsigned int,unsigned int> >& charged,
+                                     double& budget, unsigned int& remaining_views)
+    {
+        // share of this view (unused budget rolls over to the remaining views)
+        double share = budget/double(std::max(remaining_views,1u));
+        if(remaining_views > 0)
+            --remaining_views;
+
+        double num_src = views_[vID]->seg_coords()->height();
+        double used = 0.0;
+        std::list<L3D::L3DVisualNeighbor> selected;
+        std::list<L3D::L3DVisualNeighbor>::iterator it = vn.begin();
+        for(; it!=vn.end(); ++it)
+        {
+            // pairs which are already charged are matched by the neighbor
+            std::pair<unsigned int,unsigned int> p(std::min(vID,it->camID_),std::max(vID,it->camID_));
+            double cost = 0.0;
+            if(charged.find(p) == charged.end())
+                cost = num_src*double(views_[it->camID_]->seg_coords()->height());
+
+            // at least one neighbor per view
+            if(selected.size() > 0 && used+cost > share)
+                continue;
+
+            used += cost;
+            charged.insert(p);
+            selected.push_back(*it);
+        }
+
+        budget -= used;
+        vn = selected;
+
+        if(verbose_)
+            std::cout << prefix_ << "budget: " << used << "/" << share << " pair tests, " << vn.size() << " VNs" << std::endl;
+    }
+
+    //------------------------------------------------------------------------------
+    bool Line3D::viewInRegion(const unsigned int vID)
+    {
+        if(views_.find(vID) == views_.end())
+            return false;
+
+        if(!roi_.viewSelected(vID))
+            return false;
+
+        float P[12];
+        Eigen::MatrixXd Pv = views_[vID]->P();
+        for(int r=0; r<3; ++r)
+            for(int c=0; c<4; ++c)
+                P[r*4+c] = Pv(r,c);
+
+        return roi_.visibleInView(P,views_[vID]->width(),views_[vID]->height());
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::reattachCulledViews()
+    {
+        if(culled_.size() == 0 || clustered_result_.size() == 0)
+            return;
+
+        std::cout << prefix_ << "re-attaching the segments of " << culled_.size() << " culled views..." << std::endl;
+
+        // 3D segments in the transformed coordinate system (X' = s*R*X + s*t)
+        std::vector<L3D::L3DFinalLine3D*> lines;
+        std::vector<std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> > > lines3D;
+        std::list<L3D::L3DFinalLine3D>::iterator lit = clustered_result_.begin();
+        for(; lit!=clustered_result_.end(); ++lit)
+        {
+            std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> > segs;
+            std::list<std::pair<Eigen::Vector3d,Eigen::Vector3d> >::iterator s3D = lit->segments3D()->begin();
+            for(; s3D!=lit->segments3D()->end(); ++s3D)
+            {
+                segs.push_back(std::pair<Eigen::Vector3d,Eigen::Vector3d>(transf_scale_*(transf_R_*s3D->first+transf_t_),
+                                                                          transf_scale_*(transf_R_*s3D->second+transf_t_)));
+            }
+
+            lines.push_back(&(*lit));
+            lines3D.push_back(segs);
+        }
+
+        float cos_max = cos(L3D_REATTACH_MAX_ANGLE);
+        std::map<unsigned int,unsigned int>::iterator c = culled_.begin();
+        for(; c!=culled_.end(); ++c)
+        {
+            L3D::L3DView* view = views_[c->first];
+            Eigen::MatrixXd P = view->P();
+            L3D::DataArray<float>* segs = view->seg_coords();
+
+            // segment grid (midpoints)
+            int cells_x = view->width()/L3D_REATTACH_GRID_PX+1;
+            int cells_y = view->height()/L3D_REATTACH_GRID_PX+1;
+            std::vector<std::vector<unsigned int> > grid(cells_x*cells_y);
+            for(unsigned int i=0; i<segs->height(); ++i)
+            {
+                int gx = int(0.5f*(segs->dataCPU(0,i)[0]+segs->dataCPU(2,i)[0]))/L3D_REATTACH_GRID_PX;
+                int gy = int(0.5f*(segs->dataCPU(1,i)[0]+segs->dataCPU(3,i)[0]))/L3D_REATTACH_GRID_PX;
+                gx = std::max(0,std::min(gx,cells_x-1));
+                gy = std::max(0,std::min(gy,cells_y-1));
+                grid[gy*cells_x+gx].push_back(i);
+            }
+
+            // closest projected line per segment (max. endpoint distance)
+            std::vector<float> best_dist(segs->height(),L3D_REATTACH_MAX_DIST_PX);
+            std::vector<int> best_line(segs->height(),-1);
+            for(unsigned int l=0; l<lines3D.size(); ++l)
+            {
+                for(unsigned int k=0; k<lines3D[l].size(); ++k)
+                {
+                    // project
+                    Eigen::Vector3d p1 = P*lines3D[l][k].first.homogeneous();
+                    Eigen::Vector3d p2 = P*lines3D[l][k].second.homogeneous();
+                    if(p1.z() < L3D_EPS || p2.z() < L3D_EPS)
+                        continue;
+
+                    Eigen::Vector2d q1(p1.x()/p1.z(),p1.y()/p1.z());
+                    Eigen::Vector2d q2(p2.x()/p2.z(),p2.y()/p2.z());
+                    Eigen::Vector2d d = q2-q1;
+                    double len = d.norm();
+                    if(len < 1.0)
+                        continue;
+
+                    d /= len;
+                    Eigen::Vector2d nrm(-d.y(),d.x());
+
+                    // cells which contain the projected segment
+                    double margin = L3D_REATTACH_MAX_DIST_PX;
+                    double bx_min = std::max(std::min(q1.x(),q2.x())-margin,0.0);
+                    double bx_max = std::min(std::max(q1.x(),q2.x())+margin,double(view->width()));
+                    double by_min = std::max(std::min(q1.y(),q2.y())-margin,0.0);
+                    double by_max = std::min(std::max(q1.y(),q2.y())+margin,double(view->height()));
+                    if(bx_max < bx_min || by_max < by_min)
+                        continue;
+
+                    int x_min = int(bx_min)/L3D_REATTACH_GRID_PX;
+                    int x_max = std::min(int(bx_max)/L3D_REATTACH_GRID_PX,cells_x-1);
+                    int y_min = int(by_min)/L3D_REATTACH_GRID_PX;
+                    int y_max = std::min(int(by_max)/L3D_REATTACH_GRID_PX,cells_y-1);
+
+                    for(int gy=y_min; gy<=y_max; ++gy)
+                    {
+                        for(int gx=x_min; gx<=x_max; ++gx)
+                        {
+                            std::vector<unsigned int>& cell = grid[gy*cells_x+gx];
+                            for(unsigned int j=0; j<cell.size(); ++j)
+                            {
+                                unsigned int i = cell[j];
+                                Eigen::Vector2d a(segs->dataCPU(0,i)[0],segs->dataCPU(1,i)[0]);
+                                Eigen::Vector2d b(segs->dataCPU(2,i)[0],segs->dataCPU(3,i)[0]);
+
+                                // distance of the endpoints to the projected line
+                                float dist = std::max(fabs(nrm.dot(a-q1)),fabs(nrm.dot(b-q1)));
+                                if(dist > best_dist[i])
+                                    continue;
+
+                                // angle
+                                Eigen::Vector2d u = b-a;
+                                double u_len = u.norm();
+                                if(u_len < L3D_EPS || fabs(u.dot(d))/u_len < cos_max)
+                                    continue;
+
+                                // overlap with the projected segment
+                                double ta = d.dot(a-q1);
+                                double tb = d.dot(b-q1);
+                                double overlap = std::min(std::max(ta,tb),len)-std::max(std::min(ta,tb),0.0);
+                                if(overlap < L3D_REATTACH_MIN_OVERLAP*u_len)
+                                    continue;
+
+                                best_dist[i] = dist;
+                                best_line[i] = l;
+                            }
+                        }
+                    }
+                }
+            }
+
+            // attach
+            for(unsigned int i=0; i<best_line.size(); ++i)
+            {
+                if(best_line[i] >= 0)
+                {
+                    lines[best_line[i]]->segments2D()->push_back(L3D::L3DSegment2D(c->first,i));
+                    ++stats_.num_segments_reattached_;
+                }
+            }
+        }
+
+        if(verbose_)
+            std::cout << prefix_ << stats_.num_segments_reattached_ << " segments re-attached" << std::endl;
+    }
+
     //------------------------------------------------------------------------------
     void Line3D::transformGeometry()
     {
@@ -614,6 +1710,71 @@ namespace L3D
 
         // apply transformation
         applyTransformation();
+
+        // region of interest (X' = s*R*X + s*t)
+        float R[9];
+        for(int r=0; r<3; ++r)
+            for(int c=0; c<3; ++c)
+                R[r*3+c] = transf_R_(r,c);
+
+        roi_transformed_ = roi_.transformed(transf_scale_,R,
+                                            make_float3(transf_t_.x()*transf_scale_,
+                                                        transf_t_.y()*transf_scale_,
+                                                        transf_t_.z()*transf_scale_));
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::estimateDirectionClasses()
+    {
+        L3D_TRACE_ZONE("estimateDirectionClasses");
+
+        // sample: longest segments of all views (segments are sorted by length)
+        unsigned int per_view = std::max(L3D_VD_SAMPLE_SIZE/int(views_.size()),1);
+        std::vector<Eigen::Vector3d> normals;
+        std::vector<double> weights;
+        std::map<unsigned int,L3D::L3DView*>::iterator it = views_.begin();
+        for(; it!=views_.end(); ++it)
+        {
+            L3D::DataArray<float>* segs = it->second->seg_coords();
+            for(unsigned int i=0; i<segs->height() && i<per_view; ++i)
+            {
+                float4 coords = make_float4(segs->dataCPU(0,i)[0],segs->dataCPU(1,i)[0],
+                                            segs->dataCPU(2,i)[0],segs->dataCPU(3,i)[0]);
+                normals.push_back(L3D::L3DDirectionClasses::interpretationPlane(it->second->K(),
+                                                                                it->second->R(),
+                                                                                coords));
+                weights.push_back(segmentLength2D(coords));
+            }
+        }
+
+        directions_.estimate(normals,weights,L3D_VD_MAX_DIRECTIONS,L3D_VD_ANGLE_T,
+                             L3D_VD_MIN_SUPPORT,L3D_VD_RANSAC_ITERATIONS);
+
+        if(directions_.numDirections() == 0)
+        {
+            std::cout << prefix_ << "direction classes: no dominant direction --> disabled" << std::endl;
+            return;
+        }
+
+        // classify
+        unsigned int num_classified = 0;
+        unsigned int num_segments = 0;
+        for(it=views_.begin(); it!=views_.end(); ++it)
+        {
+            std::vector<int>& classes = segment_classes_[it->first];
+            directions_.classify(it->second->K(),it->second->R(),it->second->seg_coords(),
+                                 L3D_VD_ANGLE_T,L3D_VD_SIGMA_PX,classes);
+
+            for(unsigned int i=0; i<classes.size(); ++i)
+            {
+                if(classes[i] != L3D::L3D_CLASS_ANY)
+                    ++num_classified;
+            }
+            num_segments += classes.size();
+        }
+
+        std::cout << prefix_ << "direction classes: " << directions_.numDirections() << " dominant direction(s), ";
+        std::cout << num_classified << "/" << num_segments << " segments classified" << std::endl;
     }
 
     //------------------------------------------------------------------------------
@@ -622,6 +1783,16 @@ namespace L3D
         std::cout << prefix_ << separator_ << std::endl;
         std::cout <<  prefix_ << ">>> MATCHING IMAGES <<<" << std::endl;
 
+        if(numa_aware_ && backend_ == L3D_BACKEND_CPU)
+        {
+            unsigned int nodes = L3D::L3DNumaTopology::system().numNodes();
+            std::cout << prefix_ << "NUMA aware matching: " << nodes << " node(s)";
+            std::cout << ((nodes > 1) ? "" : " --> disabled") << std::endl;
+        }
+
+        // hypothesis cap of this run (the memory budget may lower it)
+        run_max_hypotheses_ = max_hypotheses_;
+
         // match images individually
         std::map<unsigned int,std::map<unsigned int,bool> >::iterator it = visual_neighbors_.begin();
         for(; it!=visual_neighbors_.end(); ++it)
@@ -631,14 +1802,34 @@ namespace L3D
             if(it->second.size() == 0)
                 continue;
 
+            // read the matches of the upcoming views in the background
+            // (files which are rewritten in the meantime are read again)
+            std::map<unsigned int,std::map<unsigned int,bool> >::iterator next = it;
+            unsigned int ahead = 0;
+            for(++next; next!=visual_neighbors_.end() && ahead<L3D_PREFETCH_DEPTH; ++next)
+            {
+                if(next->second.size() > 0)
+                {
+                    prefetcher_->prefetch(views_[next->first]->rawMatchesFile());
+                    ++ahead;
+                }
+            }
+
             // compute fundamental matrices
             computeFundamentals(it->first);
 
+            // degrade: fewer hypotheses for this and the remaining views
+            if(memoryBudgetExceeded() && (run_max_hypotheses_ == 0 || run_max_hypotheses_ > L3D_BUDGET_MAX_HYPOTHESES))
+            {
+                std::cerr << prefix_ << "WARNING: memory budget exceeded, max. " << L3D_BUDGET_MAX_HYPOTHESES << " hypotheses per segment from now on" << std::endl;
+                run_max_hypotheses_ = L3D_BUDGET_MAX_HYPOTHESES;
+            }
+
             // match with visual neighbors
             std::list<L3D::L3DMatchingPair> matches;
             performMatching(it->first,matches);
 
-            if(verbose_)
+            if(verbose_ && backend_ == L3D_BACKEND_CUDA)
             {
                 size_t free_byte ;
                 size_t total_byte ;
@@ -697,6 +1888,8 @@ namespace L3D
     //------------------------------------------------------------------------------
     void Line3D::performMatching(const unsigned int vID, std::list<L3D::L3DMatchingPair>& matches)
     {
+        L3D_TRACE_ZONE("performMatching");
+
         if(visual_neighbors_[vID].size() == 0)
         {
             std::cerr << prefix_ << "no visual neighbors for this image!" << std::endl;
@@ -711,6 +1904,7 @@ namespace L3D
         unsigned int localID = 0;
         unsigned int maxFeatures = 0;
         unsigned int totalFeatures = 0;
+        unsigned long long num_tgt_tests = 0;
 
         // CPU data
         L3D::DataArray<float>* fundamentals = new L3D::DataArray<float>(3,3*visual_neighbors_[vID].size());
@@ -733,6 +1927,7 @@ namespace L3D
             {
                 // not yet matched
                 toBeMatched.push_back(locID);
+                num_tgt_tests += views_[it->first]->seg_coords()->height();
             }
 
             // store fundamental matrix and Rt*Kinv
@@ -780,24 +1975,140 @@ namespace L3D
             totalFeatures += num_features;
         }
 
-        // move features to iu image
-        L3D::DataArray<float4>* features_tgt = new L3D::DataArray<float4>(features_tgt_vec.size(),1,true,features_tgt_vec);
+        // move features to iu image
+        L3D::DataArray<float4>* features_tgt = L3D::target_segments_array(features_tgt_vec,
+                                                                          backend_ == L3D_BACKEND_CUDA);
+
+        // direction classes (same order as the target segments)
+        std::vector<int> classes_tgt_vec;
+        if(segment_classes_.size() > 0)
+        {
+            for(it=visual_neighbors_[vID].begin(); it!=visual_neighbors_[vID].end(); ++it)
+            {
+                std::vector<int>& c = segment_classes_[it->first];
+                classes_tgt_vec.insert(classes_tgt_vec.end(),c.begin(),c.end());
+            }
+        }
+
+        // add source data
+        L3D::DataArray<float>* RtKinv_src = new L3D::DataArray<float>(3,3);
+        for(unsigned int r=0; r<3; ++r)
+            for(unsigned int c=0; c<3; ++c)
+                RtKinv_src->dataCPU(c,r)[0] = (views_[vID]->RtKinv())(r,c);
+
+        // region of interest: only source segments which can see it
+        L3D::DataArray<float>* segments_src = views_[vID]->seg_coords();
+        std::vector<unsigned int> src_local2global;
+        bool compacted = false;
+        if(roi_transformed_.hasRegion())
+        {
+            float P[12];
+            Eigen::MatrixXd Pv = views_[vID]->P();
+            for(int r=0; r<3; ++r)
+                for(int c=0; c<4; ++c)
+                    P[r*4+c] = Pv(r,c);
+
+            std::vector<float2> hull;
+            int state = roi_transformed_.projectedHull(P,hull);
+            if(state <= 0)
+            {
+                for(unsigned int i=0; i<segments_src->height() && state == 0; ++i)
+                {
+                    float2 p1 = make_float2(segments_src->dataCPU(0,i)[0],segments_src->dataCPU(1,i)[0]);
+                    float2 p2 = make_float2(segments_src->dataCPU(2,i)[0],segments_src->dataCPU(3,i)[0]);
+                    if(L3D::L3DRegionOfInterest::visibleSegment(hull,p1,p2))
+                        src_local2global.push_back(i);
+                }
+
+                if(src_local2global.size() < segments_src->height())
+                {
+                    compacted = true;
+                    if(src_local2global.size() > 0)
+                    {
+                        segments_src = new L3D::DataArray<float>(4,src_local2global.size());
+                        for(unsigned int i=0; i<src_local2global.size(); ++i)
+                            for(unsigned int c=0; c<4; ++c)
+                                segments_src->dataCPU(c,i)[0] = views_[vID]->seg_coords()->dataCPU(c,src_local2global[i])[0];
+                    }
+                    else
+                    {
+                        toBeMatched.clear();
+                    }
+                }
+
+                if(verbose_)
+                    std::cout << prefix_ << "segments in ROI:   " << src_local2global.size() << "/" << views_[vID]->seg_coords()->height() << std::endl;
+            }
+        }
+
+        // direction classes of the (compacted) source segments
+        L3D::DataArray<int>* classes_src = NULL;
+        L3D::DataArray<int>* classes_tgt = NULL;
+        unsigned long long num_skipped = 0;
+        if(classes_tgt_vec.size() > 0)
+        {
+            std::vector<int>& c = segment_classes_[vID];
+            std::vector<int> classes_src_vec;
+            if(compacted)
+            {
+                for(unsigned int i=0; i<src_local2global.size(); ++i)
+                    classes_src_vec.push_back(c[src_local2global[i]]);
+            }
+            else
+            {
+                classes_src_vec = c;
+            }
+
+            classes_src = L3D::segment_classes_array(classes_src_vec,backend_ == L3D_BACKEND_CUDA);
+            classes_tgt = L3D::segment_classes_array(classes_tgt_vec,backend_ == L3D_BACKEND_CUDA);
+
+            // skipped pair tests: the CUDA kernel tests all pairs --> class histograms
+            // (the CPU backend counts the rejected epipolar candidates itself)
+            if(backend_ == L3D_BACKEND_CUDA)
+            {
+                std::map<int,unsigned long long> hist_src;
+                for(unsigned int i=0; i<classes_src_vec.size(); ++i)
+                    ++hist_src[classes_src_vec[i]];
 
-        // add source data
-        L3D::DataArray<float>* RtKinv_src = new L3D::DataArray<float>(3,3);
-        for(unsigned int r=0; r<3; ++r)
-            for(unsigned int c=0; c<3; ++c)
-                RtKinv_src->dataCPU(c,r)[0] = (views_[vID]->RtKinv())(r,c);
+                std::list<unsigned int>::iterator tbm = toBeMatched.begin();
+                for(; tbm!=toBeMatched.end(); ++tbm)
+                {
+                    std::map<int,unsigned long long> hist_tgt;
+                    std::vector<int>& ct = segment_classes_[local2global_[*tbm]];
+                    for(unsigned int i=0; i<ct.size(); ++i)
+                        ++hist_tgt[ct[i]];
+
+                    std::map<int,unsigned long long>::iterator hs = hist_src.begin();
+                    for(; hs!=hist_src.end(); ++hs)
+                    {
+                        std::map<int,unsigned long long>::iterator ht = hist_tgt.begin();
+                        for(; ht!=hist_tgt.end(); ++ht)
+                        {
+                            if((hs->first & ht->first) == 0)
+                                num_skipped += hs->second*ht->second;
+                        }
+                    }
+                }
+            }
+        }
 
         // copy to GPU
-        fundamentals->upload();
-        projections->upload();
-        RtKinvs->upload();
-        camCenters->upload();
-        features_tgt->upload();
-        offsets->upload();
-        RtKinv_src->upload();
-        views_[vID]->seg_coords()->upload();
+        if(backend_ == L3D_BACKEND_CUDA)
+        {
+            fundamentals->upload();
+            projections->upload();
+            RtKinvs->upload();
+            camCenters->upload();
+            features_tgt->upload();
+            offsets->upload();
+            RtKinv_src->upload();
+            segments_src->upload();
+            if(classes_src != NULL)
+            {
+                classes_src->upload();
+                classes_tgt->upload();
+            }
+        }
         float3 centerSrc = make_float3(views_[vID]->C().x(),
                                        views_[vID]->C().y(),
                                        views_[vID]->C().z());
@@ -807,19 +2118,81 @@ namespace L3D
         if(verbose_)
             std::cout << prefix_ << "existing matches:  " << matches.size() << std::endl;
 
+        // existing matches: to compacted source IDs
+        if(compacted)
+        {
+            std::vector<int> global2compact(views_[vID]->seg_coords()->height(),-1);
+            for(unsigned int i=0; i<src_local2global.size(); ++i)
+                global2compact[src_local2global[i]] = i;
+
+            std::list<L3D::L3DMatchingPair>::iterator em = matches.begin();
+            while(em != matches.end())
+            {
+                if(global2compact[em->segID1_] < 0)
+                {
+                    em = matches.erase(em);
+                }
+                else
+                {
+                    em->segID1_ = global2compact[em->segID1_];
+                    ++em;
+                }
+            }
+        }
+
         // perform matching
         float median_depth = 1.0f;
-        L3D::compute_pairwise_matches(views_[vID]->seg_coords(),RtKinv_src,features_tgt,
-                                      RtKinvs,camCenters,centerSrc,
-                                      fundamentals,projections,offsets,
-                                      toBeMatched,matches,local2global_,
-                                      maxFeatures,vID,
-                                      views_[vID]->uncertainty_k_upper(),
-                                      views_[vID]->uncertainty_k_lower(),
-                                      sigma_p_,sigma_a_,
-                                      views_[vID]->specificSpatialUncertaintyK(2.0f*sigma_p_),
-                                      median_depth,
-                                      verbose_,prefix_);
+        unsigned int num_raw_matches = 0;
+        if(backend_ == L3D_BACKEND_CPU)
+        {
+            L3D::compute_pairwise_matches_cpu(segments_src,RtKinv_src,features_tgt,
+                                              RtKinvs,camCenters,centerSrc,
+                                              fundamentals,projections,offsets,
+                                              toBeMatched,matches,local2global_,
+                                              vID,
+                                              views_[vID]->uncertainty_k_upper(),
+                                              views_[vID]->uncertainty_k_lower(),
+                                              sigma_p_,sigma_a_,
+                                              views_[vID]->specificSpatialUncertaintyK(2.0f*sigma_p_),
+                                              median_depth,num_raw_matches,
+                                              run_max_hypotheses_,&roi_transformed_,num_threads_,
+                                              verbose_,prefix_,tuning_.index_min_segments_,numa_aware_,
+                                              classes_src,classes_tgt,&stats_.load_balance_,
+                                              tuning_.tasks_per_thread_,&num_skipped);
+        }
+        else
+        {
+            L3D::compute_pairwise_matches(segments_src,RtKinv_src,features_tgt,
+                                          RtKinvs,camCenters,centerSrc,
+                                          fundamentals,projections,offsets,
+                                          toBeMatched,matches,local2global_,
+                                          maxFeatures,vID,
+                                          views_[vID]->uncertainty_k_upper(),
+                                          views_[vID]->uncertainty_k_lower(),
+                                          sigma_p_,sigma_a_,
+                                          views_[vID]->specificSpatialUncertaintyK(2.0f*sigma_p_),
+                                          median_depth,num_raw_matches,
+                                          run_max_hypotheses_,&roi_transformed_,
+                                          verbose_,prefix_,classes_src,classes_tgt);
+        }
+
+        // back to original source IDs
+        if(compacted)
+        {
+            std::list<L3D::L3DMatchingPair>::iterator cm = matches.begin();
+            for(; cm!=matches.end(); ++cm)
+                cm->segID1_ = src_local2global[cm->segID1_];
+        }
+
+        stats_.num_raw_matches_ += num_raw_matches;
+        if(toBeMatched.size() > 0)
+        {
+            // skipped pairs are not tested
+            unsigned long long num_tests = num_tgt_tests*segments_src->height();
+            stats_.num_pair_tests_ += num_tests-std::min(num_skipped,num_tests);
+            stats_.num_pair_tests_skipped_ += num_skipped;
+        }
+        stats_.num_matches_ += matches.size();
 
         // cleanup
         delete fundamentals;
@@ -829,7 +2202,12 @@ namespace L3D
         delete offsets;
         delete RtKinv_src;
         delete camCenters;
-        views_[vID]->seg_coords()->removeFromGPU();
+        delete classes_src;
+        delete classes_tgt;
+        if(segments_src != views_[vID]->seg_coords())
+            delete segments_src;
+        else
+            segments_src->removeFromGPU();
 
         // set median depth
         views_[vID]->setMedianDepth(median_depth);
@@ -861,10 +2239,18 @@ namespace L3D
             L3D::L3DSegment2D ref(vID,mp.segID1_);
             L3D::L3DSegment2D tgt(mp.camID2_,mp.segID2_);
 
-            potential_correspondences_[ref][tgt] = true;
-            potential_correspondences_[tgt][ref] = true;
+            if(potential_correspondences_[ref].insert(std::pair<L3D::L3DSegment2D,bool>(tgt,true)).second)
+                ++num_potential_corrs_;
+            if(potential_correspondences_[tgt].insert(std::pair<L3D::L3DSegment2D,bool>(ref,true)).second)
+                ++num_potential_corrs_;
         }
 
+        // memory (matches are stored on disk)
+        stats_.memory_.set(L3D_MEM_MATCHES,L3D::L3DMemoryTracker::listBytes<L3D::L3DMatchingPair>(matches.size()));
+        stats_.memory_.set(L3D_MEM_CORRESPONDENCES,
+                           L3D::L3DMemoryTracker::mapBytes<L3D::L3DSegment2D,std::map<L3D::L3DSegment2D,bool> >(potential_correspondences_.size())+
+                           L3D::L3DMemoryTracker::mapBytes<L3D::L3DSegment2D,bool>(num_potential_corrs_));
+
         std::map<unsigned int,std::list<L3D::L3DMatchingPair> >::iterator oit = otherViews.begin();
         for(; oit!=otherViews.end(); ++oit)
         {
@@ -898,61 +2284,40 @@ namespace L3D
     //------------------------------------------------------------------------------
     void Line3D::greedySelection()
     {
+        L3D_TRACE_ZONE("greedySelection");
+
         //std::list<L3D::L3DFinalLine3D> tmp;
         //std::list<L3D::L3DSegment2D> segments2D;
 
-        // load correspondences for each image (store per segment)
-        unsigned int clusterable = 0;
-        unsigned int id = 0;
+        // views in fixed order
+        std::vector<L3D::L3DView*> views;
         std::map<unsigned int,L3D::L3DView*>::iterator it = views_.begin();
-        unsigned int total_corrs = 0;
         for(; it!=views_.end(); ++it)
-        {
-            std::list<L3D::L3DMatchingPair> local_matches;
-            it->second->loadExistingMatches(local_matches);
-            total_corrs += local_matches.size();
-
-            // store per segment
-            std::map<L3DSegment2D,std::list<L3D::L3DMatchingPair> > matches;
-            std::list<L3D::L3DMatchingPair>::iterator mit = local_matches.begin();
-            for(; mit!=local_matches.end(); ++mit)
-            {
-                L3DSegment2D seg2D(it->first,(*mit).segID1_);
-                matches[seg2D].push_back(*mit);
-            }
-
-            // sort by score
-            std::map<L3DSegment2D,std::list<L3D::L3DMatchingPair> >::iterator it2 = matches.begin();
-            for(; it2!=matches.end(); ++it2,++id)
-            {
-                L3DSegment2D src = it2->first;
-
-                // sort by confidence
-                it2->second.sort(L3D::sortMatchingPairsByConf);
-
-                // define correspondence
-                L3D::L3DMatchingPair mp = it2->second.front();
-
-                // normalize confidence
-                mp.confidence_ = fmin(mp.confidence_,1.0f);
+            views.push_back(it->second);
 
-                L3DSegment2D tgt(mp.camID2_,mp.segID2_);
-                L3D::L3DSegment3D seg3D = views_[src.camID()]->unprojectSegment(src.segID(),mp.depths_.x,
-                                                                                mp.depths_.y);
-                L3D::L3DCorrespondenceRRW C(id,mp.confidence_,seg3D,src,tgt);
-                C.setScore(mp.confidence_);
+        // read the match files in the background (in processing order)
+        for(unsigned int i=0; i<views.size(); ++i)
+            prefetcher_->prefetch(views[i]->rawMatchesFile());
 
-                // best match
-                best_match_[src] = C;
+        // load correspondences for each image (in parallel, one buffer per view)
+        int num_views = views.size();
+        std::vector<std::list<L3D::L3DCorrespondenceRRW> > selected(num_views);
 
-                /*
-                std::list<std::pair<Eigen::Vector3d,Eigen::Vector3d> > segments3D;
-                segments3D.push_back(std::pair<Eigen::Vector3d,Eigen::Vector3d>(C.src_seg3D().P1_,C.src_seg3D().P2_));
-                L3D::L3DFinalLine3D tmp3D(segments2D,segments3D);
-                tmp.push_back(tmp3D);
-                */
+        #pragma omp parallel for schedule(dynamic,1) num_threads(L3D::cpu_num_threads(num_threads_))
+        for(int i=0; i<num_views; ++i)
+        {
+            selectBestMatches(views[i],selected[i]);
+        }
 
-                ++clusterable;
+        // merge in view order (IDs in merge order)
+        unsigned int clusterable = 0;
+        for(int i=0; i<num_views; ++i)
+        {
+            std::list<L3D::L3DCorrespondenceRRW>::iterator c = selected[i].begin();
+            for(; c!=selected[i].end(); ++c,++clusterable)
+            {
+                c->setID(clusterable);
+                best_match_[c->src()] = *c;
             }
         }
 
@@ -961,25 +2326,80 @@ namespace L3D
             std::cout << prefix_ << "#clusterable_segments:  " << clusterable << std::endl;
         }
 
+        stats_.num_correspondences_ = clusterable;
+        stats_.memory_.set(L3D_MEM_MATCHES,0);
+        stats_.memory_.add(L3D_MEM_CORRESPONDENCES,
+                           L3D::L3DMemoryTracker::mapBytes<L3D::L3DSegment2D,L3D::L3DCorrespondenceRRW>(best_match_.size()));
+
         //save3DLinesAsSTL(tmp,data_directory_+"/unclustered.stl");
     }
 
     //------------------------------------------------------------------------------
-    void Line3D::clusterSegments2D(bool perform_diffusion)
+    void Line3D::selectBestMatches(L3D::L3DView* view, std::list<L3D::L3DCorrespondenceRRW>& selected)
     {
-        std::cout << prefix_ << separator_ << std::endl;
-        std::cout <<  prefix_ << ">>> CLUSTERING 2D SEGMENTS (global) <<<" << std::endl;
-        clustered_result_.clear();
+        std::list<L3D::L3DMatchingPair> local_matches;
+        view->loadExistingMatches(local_matches);
 
-        // create affinity matrix
-        std::list<CLEdge> A;
+        // store per segment
+        std::map<L3DSegment2D,std::list<L3D::L3DMatchingPair> > matches;
+        std::list<L3D::L3DMatchingPair>::iterator mit = local_matches.begin();
+        for(; mit!=local_matches.end(); ++mit)
+        {
+            L3DSegment2D seg2D(view->id(),(*mit).segID1_);
+            matches[seg2D].push_back(*mit);
+        }
+
+        // sort by score
+        std::map<L3DSegment2D,std::list<L3D::L3DMatchingPair> >::iterator it2 = matches.begin();
+        for(; it2!=matches.end(); ++it2)
+        {
+            L3DSegment2D src = it2->first;
+
+            // sort by confidence (ties: explicit key in deterministic mode)
+            if(deterministic_)
+                it2->second.sort(L3D::sortMatchingPairsByConfDet);
+            else
+                it2->second.sort(L3D::sortMatchingPairsByConf);
+
+            // define correspondence
+            L3D::L3DMatchingPair mp = it2->second.front();
+
+            // normalize confidence
+            mp.confidence_ = fmin(mp.confidence_,1.0f);
+
+            L3DSegment2D tgt(mp.camID2_,mp.segID2_);
+            L3D::L3DSegment3D seg3D = view->unprojectSegment(src.segID(),mp.depths_.x,
+                                                             mp.depths_.y);
+            L3D::L3DCorrespondenceRRW C(0,mp.confidence_,seg3D,src,tgt);
+            C.setScore(mp.confidence_);
+
+            // best match
+            selected.push_back(C);
+
+            /*
+            std::list<std::pair<Eigen::Vector3d,Eigen::Vector3d> > segments3D;
+            segments3D.push_back(std::pair<Eigen::Vector3d,Eigen::Vector3d>(C.src_seg3D().P1_,C.src_seg3D().P2_));
+            L3D::L3DFinalLine3D tmp3D(segments2D,segments3D);
+            tmp.push_back(tmp3D);
+            */
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    template<class P>
+    void Line3D::computeAffinities(std::list<CLEdge>& A,
+                                   std::map<unsigned int,L3D::L3DSegment2D>& local2global)
+    {
         unsigned int localID = 0;
         std::map<L3D::L3DSegment2D,unsigned int> global2local;
-        std::map<unsigned int,L3D::L3DSegment2D> local2global;
 
+        // visited pairs (only for segments that are processed later on)
         std::map<L3D::L3DSegment2D,std::map<L3D::L3DSegment2D,bool> > used;
+        size_t num_used = 0;
+        size_t peak_used = 0;
 
-        std::cout << prefix_ << "computing affinity matrix..." << std::endl;
+        // memory budget exceeded: hypotheses are released once their segment is processed
+        bool release = false;
 
         std::map<L3D::L3DSegment2D,L3D::L3DCorrespondenceRRW>::iterator it = best_match_.begin();
         for(; it!=best_match_.end(); ++it)
@@ -990,7 +2410,17 @@ namespace L3D
             L3D::L3DCorrespondenceRRW C = it->second;
 
             if(!C.valid())
+            {
+                // never queried
+                if(used.find(src) != used.end())
+                {
+                    num_used -= used[src].size();
+                    used.erase(src);
+                }
+                if(release)
+                    releaseCorrespondences(src);
                 continue;
+            }
 
             // affinities with segments from other views
             std::map<L3D::L3DSegment2D,bool>::iterator corrs = potential_correspondences_[src].begin();
@@ -1002,7 +2432,13 @@ namespace L3D
                     continue;
 
                 used[src][tgt] = true;
-                used[tgt][src] = true;
+                ++num_used;
+                if(src < tgt)
+                {
+                    // tgt is processed later on
+                    used[tgt][src] = true;
+                    ++num_used;
+                }
 
                 if(best_match_.find(tgt) != best_match_.end())
                 {
@@ -1011,7 +2447,7 @@ namespace L3D
 
                     if(C2.valid())
                     {
-                        float w = 0.5f*(C.score()+C2.score())*similarity_coll3D(C.src_seg3D(),C2.src_seg3D());
+                        float w = 0.5f*(C.score()+C2.score())*similarity_coll3D<typename P::real>(C.src_seg3D(),C2.src_seg3D());
 
                         if(w > L3D_MIN_AFFINITY)
                         {
@@ -1062,7 +2498,7 @@ namespace L3D
                     }
 
                     // collinear segments with tgt
-                    if(views_[tgt.camID()]->seg_collinearities()->find(tgt.segID()) != views_[tgt.camID()]->seg_collinearities()->end())
+                    if(P::collinearity && views_[tgt.camID()]->seg_collinearities()->find(tgt.segID()) != views_[tgt.camID()]->seg_collinearities()->end())
                     {
                         std::map<unsigned int,float>::iterator tgt_coll = views_[tgt.camID()]->seg_collinearities()->at(tgt.segID()).begin();
                         for(; tgt_coll!=views_[tgt.camID()]->seg_collinearities()->at(tgt.segID()).end(); ++tgt_coll)
@@ -1073,7 +2509,13 @@ namespace L3D
                                 continue;
 
                             used[src][tgtc] = true;
-                            used[tgtc][src] = true;
+                            ++num_used;
+                            if(src < tgtc)
+                            {
+                                // tgtc is processed later on
+                                used[tgtc][src] = true;
+                                ++num_used;
+                            }
 
                             if(best_match_.find(tgtc) != best_match_.end())
                             {
@@ -1082,7 +2524,7 @@ namespace L3D
 
                                 if(C3.valid())
                                 {
-                                    float w = 0.5f*(C.score()+C3.score())*similarity_coll3D(C.src_seg3D(),C3.src_seg3D());
+                                    float w = 0.5f*(C.score()+C3.score())*similarity_coll3D<typename P::real>(C.src_seg3D(),C3.src_seg3D());
 
                                     if(w > 0.01f)
                                     {
@@ -1138,7 +2580,7 @@ namespace L3D
             }
 
             // affinites with collinear segments
-            if(views_[src.camID()]->seg_collinearities()->find(src.segID()) != views_[src.camID()]->seg_collinearities()->end())
+            if(P::collinearity && views_[src.camID()]->seg_collinearities()->find(src.segID()) != views_[src.camID()]->seg_collinearities()->end())
             {
                 std::map<unsigned int,float>::iterator c_it = views_[src.camID()]->seg_collinearities()->at(src.segID()).begin();
                 for(; c_it!=views_[src.camID()]->seg_collinearities()->at(src.segID()).end(); ++c_it)
@@ -1151,7 +2593,13 @@ namespace L3D
                         continue;
 
                     used[src][tgt] = true;
-                    used[tgt][src] = true;
+                    ++num_used;
+                    if(src < tgt)
+                    {
+                        // tgt is processed later on
+                        used[tgt][src] = true;
+                        ++num_used;
+                    }
 
                     if(best_match_.find(tgt) != best_match_.end())
                     {
@@ -1160,7 +2608,7 @@ namespace L3D
 
                         if(C2.valid())
                         {
-                            float w = collin_w*0.5f*(C.score()+C2.score())*similarity_coll3D(C.src_seg3D(),C2.src_seg3D());
+                            float w = collin_w*0.5f*(C.score()+C2.score())*similarity_coll3D<typename P::real>(C.src_seg3D(),C2.src_seg3D());
 
                             if(w > 0.01f)
                             {
@@ -1213,15 +2661,72 @@ namespace L3D
                 }
             }
 
+            // pairs with src are not queried anymore
+            peak_used = std::max(peak_used,num_used);
+            num_used -= used[src].size();
+            used.erase(src);
+
             // copy affinites
             if(localAffs.size() > 0)
             {
                 A.splice(A.end(),localAffs,localAffs.begin(),localAffs.end());
             }
+
+            // memory budget: checked while the edges grow
+            if(memory_budget_ > 0.0f)
+            {
+                stats_.memory_.set(L3D_MEM_AFFINITIES,L3D::L3DMemoryTracker::listBytes<CLEdge>(A.size())+
+                                   L3D::L3DMemoryTracker::mapBytes<L3D::L3DSegment2D,bool>(num_used));
+
+                if(!release && memoryBudgetExceeded())
+                {
+                    std::cerr << prefix_ << "WARNING: memory budget exceeded, releasing processed potential correspondences" << std::endl;
+                    release = true;
+                }
+            }
+
+            if(release)
+                releaseCorrespondences(src);
+        }
+
+        // memory (visited pairs at their peak + edges)
+        size_t edge_bytes = L3D::L3DMemoryTracker::listBytes<CLEdge>(A.size());
+        stats_.memory_.recordPeak(L3D_MEM_AFFINITIES,edge_bytes+
+                                  L3D::L3DMemoryTracker::mapBytes<L3D::L3DSegment2D,bool>(peak_used));
+        stats_.memory_.set(L3D_MEM_AFFINITIES,edge_bytes);
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::clusterSegments2D(bool perform_diffusion)
+    {
+        std::cout << prefix_ << separator_ << std::endl;
+        std::cout <<  prefix_ << ">>> CLUSTERING 2D SEGMENTS (global) <<<" << std::endl;
+        clustered_result_.clear();
+
+        // create affinity matrix
+        std::list<CLEdge> A;
+        std::map<unsigned int,L3D::L3DSegment2D> local2global;
+
+        std::cout << prefix_ << "computing affinity matrix..." << std::endl;
+        L3D_TRACE_BEGIN(affinities);
+
+        // precision and collinearity resolved once
+        if(host_precision_ == L3D_PRECISION_FLOAT)
+        {
+            if(use_collinearity_)
+                computeAffinities<L3D::L3DPolicy<float,true> >(A,local2global);
+            else
+                computeAffinities<L3D::L3DPolicy<float,false> >(A,local2global);
+        }
+        else
+        {
+            if(use_collinearity_)
+                computeAffinities<L3D::L3DPolicy<double,true> >(A,local2global);
+            else
+                computeAffinities<L3D::L3DPolicy<double,false> >(A,local2global);
         }
 
-        global2local.clear();
-        used.clear();
+        L3D_TRACE_END(affinities,"affinities");
 
         if(verbose_)
         {
@@ -1229,9 +2734,36 @@ namespace L3D
             std::cout << prefix_ << "A: #num_rows    = " << local2global.size() << std::endl;
         }
 
+        stats_.num_affinities_ = A.size();
+
         if(A.size() == 0)
             return;
 
+        if(affinity_top_k_ > 0)
+        {
+            // keep the strongest affinities per segment
+            L3D::sparsifyAffinities(A,local2global.size(),affinity_top_k_,
+                                    L3D::cpu_num_threads(num_threads_));
+
+            if(verbose_)
+                std::cout << prefix_ << "A: #top_" << affinity_top_k_ << "       = " << A.size() << std::endl;
+
+            stats_.memory_.set(L3D_MEM_AFFINITIES,L3D::L3DMemoryTracker::listBytes<CLEdge>(A.size()));
+        }
+        stats_.num_affinities_kept_ = A.size();
+
+        if(memoryBudgetExceeded())
+        {
+            // degrade: release the hypotheses, cluster without diffusion
+            std::cerr << prefix_ << "WARNING: memory budget exceeded, releasing potential correspondences";
+            std::cerr << (perform_diffusion ? " and skipping diffusion" : "") << std::endl;
+            potential_correspondences_.clear();
+            num_potential_corrs_ = 0;
+            stats_.memory_.set(L3D_MEM_CORRESPONDENCES,
+                               L3D::L3DMemoryTracker::mapBytes<L3D::L3DSegment2D,L3D::L3DCorrespondenceRRW>(best_match_.size()));
+            perform_diffusion = false;
+        }
+
         if(perform_diffusion)
         {
             // diffusion
@@ -1240,9 +2772,25 @@ namespace L3D
         }
 
         // perform clustering
-        std::cout << prefix_ << "graph clustering..." << std::endl;
+        L3D::L3DTimer timer;
+        CLUniverse* U;
+        if(clustering_engine_ == L3D_CLUSTERING_LABEL_PROPAGATION)
+        {
+            std::cout << prefix_ << "label propagation..." << std::endl;
 
-        CLUniverse* U = performClustering(A,local2global.size(),1.0f);
+            unsigned int iterations;
+            U = performLabelPropagation(A,local2global.size(),L3D::cpu_num_threads(num_threads_),
+                                        lp_max_iterations_,deterministic_,&iterations);
+
+            if(verbose_)
+                std::cout << prefix_ << "#iterations: " << iterations << " (max. " << lp_max_iterations_ << ")" << std::endl;
+        }
+        else
+        {
+            std::cout << prefix_ << "graph clustering..." << std::endl;
+            U = performClustering(A,local2global.size(),1.0f,deterministic_);
+        }
+        stats_.time_partitioning_ = timer.elapsedMS();
 
         processClusteredSegments(U,local2global);
 
@@ -1255,10 +2803,14 @@ namespace L3D
     void Line3D::performDiffusion(std::list<CLEdge>& A, const unsigned int num_rows_cols)
     {
         // create sparse GPU matrix
-        L3D::SparseMatrix* W = new L3D::SparseMatrix(A,num_rows_cols);
+        L3D::SparseMatrix* W = new L3D::SparseMatrix(A,num_rows_cols,1.0f,false,false,
+                                                     backend_ == L3D_BACKEND_CUDA);
 
         // perform RDD
-        L3D::replicator_dynamics_diffusion(W,verbose_,prefix_);
+        if(backend_ == L3D_BACKEND_CPU)
+            L3D::replicator_dynamics_diffusion_cpu(W,num_threads_,verbose_,prefix_);
+        else
+            L3D::replicator_dynamics_diffusion(W,verbose_,prefix_);
 
         // update affinities (symmetrify)
         W->download();
@@ -1305,6 +2857,8 @@ namespace L3D
     //------------------------------------------------------------------------------
     void Line3D::processClusteredSegments(L3D::CLUniverse* U, std::map<unsigned int,L3D::L3DSegment2D> &local2global)
     {
+        L3D_TRACE_ZONE("processClusteredSegments");
+
         std::map<unsigned int,std::list<L3D::L3DSegment2D> > cluster2segments;
         std::map<unsigned int,std::map<unsigned int,bool> > cluster2cameras;
 
@@ -1323,6 +2877,11 @@ namespace L3D
         if(verbose_)
             std::cout << prefix_ << "#clusters_total:  " << cluster2segments.size() << std::endl;
 
+        stats_.num_clusters_ = cluster2segments.size();
+        stats_.memory_.set(L3D_MEM_CLUSTERS,
+                           L3D::L3DMemoryTracker::mapBytes<unsigned int,std::list<L3D::L3DSegment2D> >(cluster2segments.size())+
+                           L3D::L3DMemoryTracker::listBytes<L3D::L3DSegment2D>(local2global.size()));
+
         //saveClustersToPly(cluster2segments,cluster2cameras,"clusters_raw",0,true);
 
         // estimate 3D lines for valid clusters (visible in >= 4 cameras)
@@ -1365,6 +2924,8 @@ namespace L3D
 
         if(verbose_)
             std::cout << prefix_ << "#clusters_valid:  " << valid_clusters << std::endl;
+
+        stats_.num_lines_ = valid_clusters;
     }
 
     //------------------------------------------------------------------------------
@@ -1597,97 +3158,13 @@ namespace L3D
     }
 
     //------------------------------------------------------------------------------
-    float Line3D::similarity_coll3D(const L3D::L3DSegment3D seg1_3D, const L3D::L3DSegment3D seg2_3D)
-    {
-        // distances
-        float d1 = distance_point2line_3D(seg2_3D,seg1_3D.P1_);
-        float d2 = distance_point2line_3D(seg2_3D,seg1_3D.P2_);
-        float min_d1 = views_[seg1_3D.camID_]->get_lower_uncertainty(seg1_3D.depth_p1_);
-        float min_d2 = views_[seg1_3D.camID_]->get_lower_uncertainty(seg1_3D.depth_p2_);
-        float sigma_sqr_d1 = views_[seg1_3D.camID_]->get_uncertainty_sigma_squared(seg1_3D.depth_p1_);
-        float sigma_sqr_d2 = views_[seg1_3D.camID_]->get_uncertainty_sigma_squared(seg1_3D.depth_p2_);
-
-        float sim1,sim2;
-        if(d1 < min_d1)
-            sim1 = 1.0f;
-        else
-            sim1 = expf(-(d1-min_d1)*(d1-min_d1)/(2.0f*sigma_sqr_d1));
-
-        if(d2 < min_d2)
-            sim2 = 1.0f;
-        else
-            sim2 = expf(-(d2-min_d2)*(d2-min_d2)/(2.0f*sigma_sqr_d2));
-
-        float w_d = 0.0f;
-        float w_d12 = fmin(sim1,sim2);
-
-        float d3 = distance_point2line_3D(seg1_3D,seg2_3D.P1_);
-        float d4 = distance_point2line_3D(seg1_3D,seg2_3D.P2_);
-        float min_d3 = views_[seg2_3D.camID_]->get_lower_uncertainty(seg2_3D.depth_p1_);
-        float min_d4 = views_[seg2_3D.camID_]->get_lower_uncertainty(seg2_3D.depth_p2_);
-        float sigma_sqr_d3 = views_[seg2_3D.camID_]->get_uncertainty_sigma_squared(seg2_3D.depth_p1_);
-        float sigma_sqr_d4 = views_[seg2_3D.camID_]->get_uncertainty_sigma_squared(seg2_3D.depth_p2_);
-
-        float sim3,sim4;
-        if(d3 < min_d3)
-            sim3 = 1.0f;
-        else
-            sim3 = expf(-(d3-min_d3)*(d3-min_d3)/(2.0f*sigma_sqr_d3));
-
-        if(d4 < min_d4)
-            sim4 = 1.0f;
-        else
-            sim4 = expf(-(d4-min_d4)*(d4-min_d4)/(2.0f*sigma_sqr_d4));
-
-
-        float w_d34 = fmin(sim3,sim4);
-        w_d = fmin(w_d12,w_d34);
-
-        /*
-        // spatial regularizer
-        float d1 = distance_point2line_3D(seg2_3D,seg1_3D.P1_);
-        float d2 = distance_point2line_3D(seg2_3D,seg1_3D.P2_);
-        float max_d1 = views_[seg1_3D.camID_]->get_upper_uncertainty(seg1_3D.depth_p1_);
-        float max_d2 = views_[seg1_3D.camID_]->get_upper_uncertainty(seg1_3D.depth_p2_);
-
-        float d3 = distance_point2line_3D(seg1_3D,seg2_3D.P1_);
-        float d4 = distance_point2line_3D(seg1_3D,seg2_3D.P2_);
-        float max_d3 = views_[seg2_3D.camID_]->get_upper_uncertainty(seg2_3D.depth_p1_);
-        float max_d4 = views_[seg2_3D.camID_]->get_upper_uncertainty(seg2_3D.depth_p2_);
-
-        if(d1 > max_d1 || d2 > max_d2 || d3 > max_d3 || d4 > max_d4)
-            return 0.0f;
-
-        // projective position similarity
-        float sim1 = views_[seg1_3D.camID_]->projective_similarity(seg2_3D,seg1_3D.segID_,uncertainty_lower_2D_);
-        float sim2 = views_[seg2_3D.camID_]->projective_similarity(seg1_3D,seg2_3D.segID_,uncertainty_lower_2D_);
-        float w_d = fmin(sim1,sim2);
-        */
-
-        // angle
-        float angle = acos(fmax(fmin(seg1_3D.dir_.dot(seg2_3D.dir_),1.0),-1.0))/M_PI*180.0f;
-        if(angle > 90.0f)
-            angle = 180.0f-angle;
-
-        float w_a = expf(-angle*angle/(2.0f*sigma_a_*sigma_a_));
-
-        // fuse
-        float sim = fmin(w_d,w_a);
-
-        if(sim <= 0.01f)
-            return 0.0f;
-        else
-            return sim;
-    }
-
-    //------------------------------------------------------------------------------
-    float Line3D::distance_point2line_3D(const L3D::L3DSegment3D seg3D, const Eigen::Vector3d X)
+    template<typename T>
+    float Line3D::similarity_coll3D(const L3D::L3DSegment3D& seg1_3D, const L3D::L3DSegment3D& seg2_3D)
     {
-        Eigen::Vector3d P1 = seg3D.P1_;
-        Eigen::Vector3d dir = seg3D.dir_;
-
-        Eigen::Vector3d proj = P1 + (dir * ((X - P1).transpose()) * dir);
-        return (proj-X).norm();
+        return float(L3D::HK_similarity_coll3D<T>(seg1_3D,seg2_3D,
+                                                  views_[seg1_3D.camID_]->uncertaintyModel<T>(),
+                                                  views_[seg2_3D.camID_]->uncertaintyModel<T>(),
+                                                  T(sigma_a_)));
     }
 
     //------------------------------------------------------------------------------
@@ -1786,18 +3263,39 @@ namespace L3D
     }
 
     //------------------------------------------------------------------------------
-    bool Line3D::detectLineSegments(const cv::Mat& image, std::list<float4> &lineSegments,
+    bool Line3D::detectLineSegments(const cv::Mat& image, const cv::Mat& mask,
+                                    std::list<float4> &lineSegments,
                                     const unsigned int new_width, const unsigned int new_height,
                                     const float min_length)
     {
-        // scale image
-        cv::Mat img_scaled;
+        L3D_TRACE_ZONE("detectLineSegments");
+
+        std::vector<float4> detections;
         float upscale_factor;
+        if(!detectRawSegments(image,mask,detections,new_width,new_height,upscale_factor))
+            return false;
+
+        selectLineSegments(detections,lineSegments,image.cols,image.rows,
+                           upscale_factor,min_length,0.0f);
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    bool Line3D::detectRawSegments(const cv::Mat& image, const cv::Mat& mask,
+                                   std::vector<float4>& detections,
+                                   const unsigned int new_width, const unsigned int new_height,
+                                   float& upscale_factor)
+    {
+        // scale image (and mask)
+        cv::Mat img_scaled;
+        cv::Mat mask_scaled = mask;
         unsigned int original_width = image.cols;
         unsigned int original_height = image.rows;
         if(new_width != original_width || new_height != original_height)
         {
             cv::resize(image,img_scaled,cv::Size(new_width,new_height));
+            if(!mask.empty())
+                cv::resize(mask,mask_scaled,cv::Size(new_width,new_height),0,0,cv::INTER_NEAREST);
             float w_diff = float(img_scaled.cols)/float(image.cols);
             float h_diff = float(img_scaled.rows)/float(image.rows);
             upscale_factor = 1.0f/(0.5f*(w_diff+h_diff));
@@ -1818,14 +3316,16 @@ namespace L3D
         // detect lines
         std::vector<cv::Vec4f> lines;
         std::vector<double> width, prec, nfa;
-        ls_->detect(imgGray, lines, width, prec, nfa);
+        if(mask_scaled.empty())
+            ls_->detect(imgGray, lines, width, prec, nfa);
+        else
+            ls_->detectMasked(imgGray, mask_scaled, lines, width, prec, nfa);
 
         if(lines.size() == 0)
             return false;
 
-        // filter by size
-        std::vector<float4> lines_filtered;
-        std::list<float2> pos_and_length;
+        // valid detections
+        detections.clear();
         for(unsigned int i=0; i<lines.size(); ++i)
         {
             cv::Vec4f pts = lines[i];
@@ -1833,14 +3333,7 @@ namespace L3D
             {
                 float4 coords = make_float4(pts[0],pts[1],pts[2],pts[3]);
                 coords *= upscale_factor;
-
-                float len = segmentLength2D(coords);
-
-                if(len > min_length)
-                {
-                    lines_filtered.push_back(coords);
-                    pos_and_length.push_back(make_float2(lines_filtered.size()-1,len));
-                }
+                detections.push_back(coords);
             }
             else
             {
@@ -1850,24 +3343,57 @@ namespace L3D
             }
         }
 
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::selectLineSegments(std::vector<float4>& detections, std::list<float4>& lineSegments,
+                                    const unsigned int original_width, const unsigned int original_height,
+                                    const float upscale_factor, const float min_length,
+                                    const float min_scaled_length)
+    {
+        // merge fragments (short ones may become long enough)
+        if(merge_fragments_)
+        {
+            float max_gap = L3D_FRAGMENT_MAX_GAP_F*sqrtf(float(original_width*original_width+original_height*original_height));
+            unsigned int merged = L3D::merge_segment_fragments_cpu(detections,L3D_FRAGMENT_MAX_ANGLE,
+                                                                   L3D_FRAGMENT_MAX_OFFSET*upscale_factor,
+                                                                   max_gap,L3D_FRAGMENT_MAX_PASSES);
+            stats_.num_fragments_merged_ += merged;
+
+            if(verbose_)
+                std::cout << prefix_ << "merged fragments: " << merged << std::endl;
+        }
+
+        // filter by size (and by the size in the scaled image)
+        float min_len = std::max(min_length,min_scaled_length*upscale_factor);
+        std::vector<float4> lines_filtered;
+        std::list<float2> pos_and_length;
+        for(unsigned int i=0; i<detections.size(); ++i)
+        {
+            float4 coords = detections[i];
+            float len = segmentLength2D(coords);
+
+            if(len > min_len)
+            {
+                lines_filtered.push_back(coords);
+                pos_and_length.push_back(make_float2(lines_filtered.size()-1,len));
+            }
+        }
+
         // sort by size
         pos_and_length.sort(L3D::sortSegmentsByLength);
 
-        if(pos_and_length.size() > L3D_DEF_MAX_NUM_SEGMENTS)
-            pos_and_length.resize(L3D_DEF_MAX_NUM_SEGMENTS);
+        if(max_num_segments_ > 0 && pos_and_length.size() > max_num_segments_)
+            pos_and_length.resize(max_num_segments_);
 
         // store
         std::list<float2>::iterator fs = pos_and_length.begin();
-        unsigned int i=0;
-        for(; fs!=pos_and_length.end(); ++i,++fs)
+        for(; fs!=pos_and_length.end(); ++fs)
         {
             unsigned int pos = (*fs).x;
-
-            float4 coords = lines_filtered[pos];
-            lineSegments.push_back(coords);
+            lineSegments.push_back(lines_filtered[pos]);
         }
-
-        return true;
     }
 
     //------------------------------------------------------------------------------
@@ -2000,6 +3526,77 @@ namespace L3D
         return sqrtf(x*x+y*y);
     }
 
+    //------------------------------------------------------------------------------
+    unsigned int Line3D::detectSegments2D(const cv::Mat& image, std::list<float4>& segments,
+                                          const int maxImgWidth, const cv::Mat mask)
+    {
+        segments.clear();
+
+        if(image.rows == 0 || image.cols == 0)
+            return 0;
+
+        if(!mask.empty() && (mask.type() != CV_8UC1 || mask.rows != image.rows || mask.cols != image.cols))
+            return 0;
+
+        // compute new image sizes (see addImage)
+        unsigned int new_width = image.cols;
+        unsigned int new_height = image.rows;
+
+        if(maxImgWidth > 0 && std::max(image.rows,image.cols) > maxImgWidth)
+        {
+            float scaleFactor = float(maxImgWidth)/fmax(image.rows,image.cols);
+            new_width = round(float(image.cols)*scaleFactor);
+            new_height = round(float(image.rows)*scaleFactor);
+        }
+
+        float min_length = L3D_DEF_MIN_LINE_LENGTH_F*sqrtf(float(image.rows*image.rows+image.cols*image.cols));
+        detectLineSegments(image,mask,segments,new_width,new_height,min_length);
+
+        return segments.size();
+    }
+
+    //------------------------------------------------------------------------------
+    std::string Line3D::maskSuffix(const cv::Mat& mask)
+    {
+        if(mask.empty())
+            return "";
+
+        // FNV-1a of the mask (zero/non-zero)
+        unsigned long long hash = 14695981039346656037ULL;
+        for(int r=0; r<mask.rows; ++r)
+        {
+            const unsigned char* row = mask.ptr<unsigned char>(r);
+            for(int c=0; c<mask.cols; ++c)
+            {
+                hash ^= (row[c] > 0) ? 1ULL : 0ULL;
+                hash *= 1099511628211ULL;
+            }
+        }
+
+        std::stringstream str;
+        str << "_mask" << std::hex << hash;
+        return str.str();
+    }
+
+    //------------------------------------------------------------------------------
+    std::string Line3D::selectionSuffix()
+    {
+        std::stringstream str;
+        if(merge_fragments_)
+        {
+            str << "_merge" << L3D_FRAGMENT_MAX_ANGLE << "_" << L3D_FRAGMENT_MAX_OFFSET;
+            str << "_" << L3D_FRAGMENT_MAX_GAP_F << "_" << L3D_FRAGMENT_MAX_PASSES;
+        }
+        else
+        {
+            str << "_merge0";
+        }
+
+        // segment cap (0: unlimited)
+        str << "_max" << max_num_segments_;
+        return str.str();
+    }
+
     //------------------------------------------------------------------------------
     float4 Line3D::getSegment2D(L3D::L3DSegment2D& seg2D)
     {
@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 // std
 #include <map>
+#include <set>
 
 // external
 #include "opencv/cv.h"
@@ -37,9 +38,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "serialization.h"
 #include "segments.h"
 #include "cudawrapper.h"
+#include "cpuwrapper.h"
 #include "clustering.h"
 #include "sparsematrix.h"
 #include "dataArray.h"
+#include "associationindex.h"
+#include "timer.h"
+#include "tracing.h"
+#include "hostkernels.h"
+#include "roi.h"
+#include "l3dnuma.h"
+#include "directions.h"
+#include "tuning.h"
+#include "synthetic.h"
 
 /**
  * Line3D - Base Class
@@ -66,18 +77,131 @@ namespace L3D
                bool useCollinearity=L3D_DEF_COLLINEARITY_FOR_CLUSTERING, bool verbose=false);
         ~Line3D();
 
-        // add a new image to the system
+        // select compute backend (L3D_BACKEND_CUDA/L3D_BACKEND_CPU),
+        // has to be called before images are added! (num_threads <= 0:
+        // tuned number of threads if a profile exists, otherwise all cores)
+        void setComputeBackend(const int backend, const int num_threads=L3D_DEF_NUM_THREADS);
+
+        // auto tuning (CPU backend): short matching runs on a synthetic scene for
+        // the number of threads, tasks per thread and the epipolar index threshold,
+        // the best configuration is stored in the profile of this host (see tuning.h)
+        // and used by this and all later Line3D objects, has to be called before
+        // images are added!
+        void autoTune();
+
+        // tuning profile in use (valid_ = false: compile-time defaults)
+        L3D::L3DTuningProfile getTuningProfile(){return tuning_;}
+
+        // precision of the 3D similarities (L3D_PRECISION_DOUBLE/L3D_PRECISION_FLOAT)
+        void setHostPrecision(const int precision){host_precision_ = precision;}
+
+        // max. number of hypotheses per segment after verification (0 = no limit)
+        void setHypothesisCap(const unsigned int max_hypotheses){max_hypotheses_ = max_hypotheses;}
+
+        // deterministic mode: bit-identical results for any number of threads
+        // (explicit tie-breaking, ordered merges)
+        void setDeterministic(const bool deterministic){deterministic_ = deterministic;}
+
+        // NUMA aware CPU matching: threads are pinned to the nodes (contiguous
+        // blocks) and read node local copies of the segment data (no effect
+        // on single node systems)
+        void setNumaAware(const bool numa_aware){numa_aware_ = numa_aware;}
+
+        // direction classes: dominant 3D directions are estimated from the
+        // segments and the camera rotations, only segments which point at a
+        // common vanishing point are matched (man-made scenes)
+        void setDirectionClasses(const bool direction_classes){direction_classes_ = direction_classes;}
+
+        // memory budget [MB] for the host data structures (0 = unlimited),
+        // stages degrade gracefully when it is exceeded (see getStatistics().memory_)
+        void setMemoryBudget(const float budget_MB){memory_budget_ = budget_MB;}
+
+        // max. number of segments per image (longest ones, 0 = unlimited),
+        // has to be called before images are added! For high resolution images
+        // use maxImgWidth <= 0 (full resolution) in addImage
+        void setMaxNumSegments(const unsigned int max_segments){max_num_segments_ = max_segments;}
+
+        // joins nearly collinear, nearly touching LSD fragments of the same edge
+        // into longer segments (before the segment cap is applied),
+        // has to be called before images are added!
+        void setFragmentMerging(const bool merge){merge_fragments_ = merge;}
+
+        // visual neighbor selection (L3D_NEIGHBORS_SIMILARITY/L3D_NEIGHBORS_COVERAGE),
+        // coverage: greedy, maximizes the covered worldpoints and the viewing angle
+        // spread, stops when an additional neighbor gains less than min_gain
+        void setNeighborSelection(const int mode, const float min_gain=L3D_DEF_COVERAGE_MIN_GAIN){
+            neighbor_selection_ = mode;
+            coverage_min_gain_ = min_gain;
+        }
+
+        // adaptive matching budget: each view gets a share of the pair tests
+        // (source x target segments) which fit into the time target [s],
+        // neighbors are added in priority order until the share is used up
+        // (pair_tests_per_s <= 0 --> backend default, 0 target --> disabled)
+        void setMatchingBudget(const float time_target_s, const double pair_tests_per_s=0.0){
+            matching_time_target_ = time_target_s;
+            pair_tests_per_s_ = pair_tests_per_s;
+        }
+
+        // clustering engine (L3D_CLUSTERING_GRAPH/L3D_CLUSTERING_LABEL_PROPAGATION),
+        // label propagation is multithreaded (CPU) and meant for affinity graphs
+        // which are too large for the sequential graph clustering
+        void setClusteringEngine(const int engine, const unsigned int max_iterations=L3D_DEF_LP_MAX_ITERATIONS){
+            clustering_engine_ = engine;
+            lp_max_iterations_ = max_iterations;
+        }
+
+        // sparsification of the affinity matrix: each segment keeps its k strongest
+        // affinities (union over both segments, 0 = all), reduces hub segments in
+        // repetitive regions before diffusion and clustering
+        void setAffinityTopK(const unsigned int k){affinity_top_k_ = k;}
+
+        // match file I/O: files of upcoming views are read and decoded by
+        // num_threads background threads (0 = synchronous), at most buffer_MB of
+        // file data is prefetched (decoded matches take more memory than that)
+        void setPrefetching(const unsigned int num_threads, const float buffer_MB=L3D_DEF_PREFETCH_BUFFER_MB){
+            prefetch_threads_ = num_threads;
+            prefetch_buffer_MB_ = buffer_MB;
+        }
+
+        // redundant view culling (L3D_CULLING_OFF/L3D_CULLING_ON/L3D_CULLING_REATTACH):
+        // near-duplicate views (camera center within the min. baseline, similar viewing
+        // direction, high worldpoint overlap) are represented by a single view during
+        // matching, with L3D_CULLING_REATTACH their segments are attached to the final
+        // 3D lines by projection (video and hovering drone sequences)
+        void setViewCulling(const int mode){view_culling_ = mode;}
+
+        // restrict the reconstruction to a 3D region and/or a subset of the views
+        // (input coordinate system, see roi.h), has to be set before compute3Dmodel!
+        void setRegionOfInterest(const L3D::L3DRegionOfInterest& roi){roi_ = roi;}
+        void clearRegionOfInterest(){roi_ = L3D::L3DRegionOfInterest();}
+
+        // add a new image to the system (optional mask: CV_8UC1, image size,
+        // segments are only detected where it is non-zero; for a rectangular
+        // ROI use e.g. mask = cv::Mat::zeros(image.size(),CV_8UC1); mask(roi) = 255;)
         void addImage(const unsigned int imageID, const cv::Mat image,
                       const Eigen::Matrix3d K, const Eigen::Matrix3d R,
                       const Eigen::Vector3d t, std::list<unsigned int>& worldpointIDs,
                       const int maxImgWidth=L3D_DEF_MAX_IMG_WIDTH,
-                      const bool loadAndStoreSegments=L3D_DEF_LOAD_AND_STORE_SEGMENTS);
+                      const bool loadAndStoreSegments=L3D_DEF_LOAD_AND_STORE_SEGMENTS,
+                      const cv::Mat mask=cv::Mat());
 
         void addImage_fixed_sim(const unsigned int imageID, const cv::Mat image,
                                 const Eigen::Matrix3d K, const Eigen::Matrix3d R,
                                 const Eigen::Vector3d t, std::map<unsigned int,float>& viewSimilarity,
                                 const int maxImgWidth=L3D_DEF_MAX_IMG_WIDTH,
-                                const bool loadAndStoreSegments=L3D_DEF_LOAD_AND_STORE_SEGMENTS);
+                                const bool loadAndStoreSegments=L3D_DEF_LOAD_AND_STORE_SEGMENTS,
+                                const cv::Mat mask=cv::Mat());
+
+        // add a view with externally detected segments (no image decoding and
+        // no detection): segments are num_segments endpoints (p1x,p1y,p2x,p2y)
+        // in the coordinates of the width x height image, used as they are
+        // (no merging, length filtering or segment cap)
+        void addImageSegments(const unsigned int imageID,
+                              const unsigned int width, const unsigned int height,
+                              const Eigen::Matrix3d K, const Eigen::Matrix3d R,
+                              const Eigen::Vector3d t, std::list<unsigned int>& worldpointIDs,
+                              const float4* segments, const unsigned int num_segments);
 
         // reconstructs 3D model
         void compute3Dmodel(bool perform_diffusion=L3D_DEF_PERFORM_RDD);
@@ -85,6 +209,21 @@ namespace L3D
         // get resulting 3D model
         void getResult(std::list<L3D::L3DFinalLine3D>& result);
 
+        // get selected correspondences (best match per 2D segment)
+        void getSelectedCorrespondences(std::map<L3D::L3DSegment2D,L3D::L3DSegment2D>& corrs);
+
+        // statistics of the last run
+        L3D::L3DStatistics getStatistics(){return stats_;}
+
+        // detect 2D line segments (same as in addImage, without adding a view),
+        // returns the number of segments
+        unsigned int detectSegments2D(const cv::Mat& image, std::list<float4>& segments,
+                                      const int maxImgWidth=L3D_DEF_MAX_IMG_WIDTH,
+                                      const cv::Mat mask=cv::Mat());
+
+        // line segment detector (e.g. for per-phase timing)
+        cv::Ptr<cv::LineSegmentDetector> lineSegmentDetector(){return ls_;}
+
         // get coordinates of a 2D segment (float4: p1x, p1y, p2x, p2y)
         float4 getSegment2D(L3D::L3DSegment2D& seg2D);
 
@@ -94,6 +233,9 @@ namespace L3D
         // save model as txt file
         void save3DLinesAsTXT(std::list<L3D::L3DFinalLine3D>& result, std::string filename);
 
+        // save 2D-3D association index as binary file (see associationindex.h)
+        void save2D3DAssociationIndex(std::list<L3D::L3DFinalLine3D>& result, std::string filename);
+
         // number of cameras
         unsigned int numCameras(){return views_.size();}
 
@@ -108,6 +250,62 @@ namespace L3D
         std::string data_directory_;
         bool computation_;
 
+        // compute backend
+        int backend_;
+        int num_threads_;
+
+        // tuned kernel parameters (per host)
+        L3D::L3DTuningProfile tuning_;
+
+        // kernel policies
+        int host_precision_;
+        unsigned int max_hypotheses_;
+        unsigned int run_max_hypotheses_; // of the current run (memory budget)
+        bool deterministic_;
+        bool numa_aware_;
+
+        // direction classes (per view and segment)
+        bool direction_classes_;
+        L3D::L3DDirectionClasses directions_;
+        std::map<unsigned int,std::vector<int> > segment_classes_;
+
+        // memory budget [MB]
+        float memory_budget_;
+        size_t num_potential_corrs_;
+
+        // max. segments per image
+        unsigned int max_num_segments_;
+        bool merge_fragments_;
+
+        // visual neighbor selection
+        int neighbor_selection_;
+        float coverage_min_gain_;
+
+        // clustering engine
+        int clustering_engine_;
+        unsigned int lp_max_iterations_;
+        unsigned int affinity_top_k_;
+
+        // match file prefetching (during compute3Dmodel)
+        unsigned int prefetch_threads_;
+        float prefetch_buffer_MB_;
+        L3D::L3DMatchPrefetcher* prefetcher_;
+
+        // adaptive matching budget
+        float matching_time_target_;
+        double pair_tests_per_s_;
+
+        // redundant view culling (culled view --> representative)
+        int view_culling_;
+        std::map<unsigned int,unsigned int> culled_;
+
+        // region of interest (input/transformed coordinates)
+        L3D::L3DRegionOfInterest roi_;
+        L3D::L3DRegionOfInterest roi_transformed_;
+
+        // statistics
+        L3D::L3DStatistics stats_;
+
         // view neighborhood information
         std::map<unsigned int,unsigned int> num_wps_;
         std::map<unsigned int,std::map<unsigned int,unsigned int> > common_wps_;
@@ -153,11 +351,53 @@ namespace L3D
         // views
         std::map<unsigned int,L3D::L3DView*> views_;
 
+        // memory accounting
+        bool memoryBudgetExceeded();
+        bool collinearityWithinBudget(const unsigned int viewID);
+        void releaseCorrespondences(const L3D::L3DSegment2D& src);
+        void accountSegments(const unsigned int viewID, L3D::L3DSegments* segments);
+        void printMemoryReport();
+
+        // auto tuning: matching time [ms] of the synthetic scene with the given
+        // kernel parameters (and the resulting pair test throughput)
+        double tuningRun(L3D::L3DSyntheticScene& scene, const L3D::L3DTuningProfile& profile,
+                         double& pair_tests_per_s);
+
+        // match file I/O (time blocked on reads vs. stage time)
+        void printIOStatistics(const double io_ms, const double stage_ms);
+
         // detect line segments using the LSD algorithm
-        bool detectLineSegments(const cv::Mat& image, std::list<float4> &lineSegments,
+        bool detectLineSegments(const cv::Mat& image, const cv::Mat& mask,
+                                std::list<float4> &lineSegments,
                                 const unsigned int new_width, const unsigned int new_height,
                                 const float min_length);
 
+        // segments of an image: stored ones, derived from the cached (finest)
+        // detections if they are fine enough, otherwise detected (NULL: none)
+        L3D::L3DSegments* imageSegments(const unsigned int imageID, const cv::Mat& image,
+                                        const cv::Mat& mask,
+                                        const unsigned int new_width, const unsigned int new_height,
+                                        const bool loadAndStoreSegments);
+
+        // LSD on the scaled image, masked pixels are skipped (detections in
+        // original image coordinates)
+        bool detectRawSegments(const cv::Mat& image, const cv::Mat& mask,
+                               std::vector<float4>& detections,
+                               const unsigned int new_width, const unsigned int new_height,
+                               float& upscale_factor);
+
+        // cache file suffix of a detection mask ("" if there is none)
+        std::string maskSuffix(const cv::Mat& mask);
+
+        // cache file suffix of the segment selection (fragment merging and its tolerances, segment cap)
+        std::string selectionSuffix();
+
+        // fragment merging, length filter (original and scaled image) and segment cap
+        void selectLineSegments(std::vector<float4>& detections, std::list<float4>& lineSegments,
+                                const unsigned int original_width, const unsigned int original_height,
+                                const float upscale_factor, const float min_length,
+                                const float min_scaled_length);
+
         // computes the length of a 2D line segment
         float segmentLength2D(const float4 coords);
 
@@ -167,9 +407,29 @@ namespace L3D
         // for pmvs_data: set view similarity (according to overlap.txt)
         void setViewSimilarity(const unsigned int viewID, std::map<unsigned int,float>& sim);
 
+        // redundant views --> representative (culled_)
+        void cullRedundantViews();
+
         // find visually nearest neighbors among views
         void findVisualNeighbors();
 
+        // greedy coverage selection (candidates sorted by similarity)
+        void selectCoverageNeighbors(const unsigned int vID,
+                                     std::list<L3D::L3DVisualNeighbor>& candidates,
+                                     std::map<unsigned int,std::vector<unsigned int> >& view2wps,
+                                     std::list<L3D::L3DVisualNeighbor>& selected);
+
+        // neighbors (priority order) which fit into the pair test budget
+        void applyMatchingBudget(const unsigned int vID, std::list<L3D::L3DVisualNeighbor>& vn,
+                                 std::set<std::pair<unsigned int,unsigned int> >& charged,
+                                 double& budget, unsigned int& remaining_views);
+
+        // view selected and (possibly) sees the region of interest
+        bool viewInRegion(const unsigned int vID);
+
+        // attach the segments of the culled views to the final 3D lines
+        void reattachCulledViews();
+
         // transform geometry to avoid numerical imprecision
         void transformGeometry();
         Eigen::Vector3d inverseTransform(Eigen::Vector3d P);
@@ -185,6 +445,15 @@ namespace L3D
         // applies found transformation to all cameras
         void applyTransformation();
 
+        // dominant directions and segment classes (all views)
+        void estimateDirectionClasses();
+
+        // reset, neighbors, geometry and pairwise matching (first part of compute3Dmodel)
+        void computeMatches();
+
+        // detach and delete the match file prefetcher
+        void releasePrefetcher();
+
         // match views with visual neighbors
         void matchViews();
         void performMatching(const unsigned int vID, std::list<L3D::L3DMatchingPair>& matches);
@@ -192,9 +461,13 @@ namespace L3D
         // optimize correspondences
         void optimizeLocalMatches();
         void greedySelection();
+        void selectBestMatches(L3D::L3DView* view, std::list<L3D::L3DCorrespondenceRRW>& selected);
 
         // cluster 2D segments to obtain final 3D model
         void clusterSegments2D(bool perform_diffusion);
+        template<class P>
+        void computeAffinities(std::list<CLEdge>& A,
+                               std::map<unsigned int,L3D::L3DSegment2D>& local2global);
         void performDiffusion(std::list<CLEdge>& A, const unsigned int num_rows_cols);
         void processClusteredSegments(L3D::CLUniverse* U, std::map<unsigned int,L3D::L3DSegment2D> &local2global);
         void untransformClusteredSegments(std::list<L3D::L3DSegment2D>& seg2D,
@@ -209,9 +482,9 @@ namespace L3D
                            const L3D::L3DSegment3D line3D);
 
 
-        // 2D similarity based on collinearity
-        float similarity_coll3D(const L3D::L3DSegment3D seg1_3D, const L3D::L3DSegment3D seg2_3D);
-        float distance_point2line_3D(const L3D::L3DSegment3D seg3D, const Eigen::Vector3d X);
+        // 2D similarity based on collinearity (T: float/double)
+        template<typename T>
+        float similarity_coll3D(const L3D::L3DSegment3D& seg1_3D, const L3D::L3DSegment3D& seg2_3D);
 
         // compute fundamental matrices among visual neighbors
         void computeFundamentals(const unsigned int vID);
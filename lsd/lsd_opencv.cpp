@@ -42,6 +42,7 @@
 // #include "precomp.hpp"
 #include <vector>
 
+#include <stdint.h>
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
@@ -73,8 +74,15 @@
 
 #define NOTDEF      double(-1024.0) // Label for pixels with undefined gradient.
 
-#define NOTUSED     0   // Label for pixels not used in yet.
-#define USED        1   // Label for pixels already used in detection.
+// Quantized gradient angles (8 bit bins over 2 pi). The angle difference of two
+// pixels is the uchar difference of their bins, a tolerance table per precision
+// decides aligned/not aligned, only differences close to the precision are
+// tested exactly (same result as the double comparison).
+#define ANGLE_BINS      256
+#define ALIGN_NO        0   // Angle difference is certainly above the precision.
+#define ALIGN_YES       1   // Angle difference is certainly within the precision.
+#define ALIGN_CHECK     2   // Close to the precision, compare the exact angles.
+#define TOLERANCE_SLOTS 8   // Cached tolerance tables (slot 0: precision of flsd).
 
 #define RELATIVE_ERROR_FACTOR 100.0
 
@@ -222,6 +230,13 @@ public:
                 OutputArray width = noArray(), OutputArray prec = noArray(),
                 OutputArray nfa = noArray());
 
+/**
+ * Detect lines only where the mask is non-zero (see LineSegmentDetector::detectMasked).
+ */
+    void detectMasked(InputArray _image, InputArray _mask, OutputArray _lines,
+                      OutputArray width = noArray(), OutputArray prec = noArray(),
+                      OutputArray nfa = noArray());
+
 /**
  * Draw lines on the given canvas.
  *
@@ -312,6 +327,16 @@ public:
  */
     bool intersection(InputArray line1, InputArray line2, Point& P);
 
+/**
+ * Enable or disable the per-phase timing of detect().
+ */
+    void setPhaseTiming(bool enable);
+
+/**
+ * Per-phase timing of the last detect() call in ms.
+ */
+    LSDPhaseTimes getPhaseTimes() const;
+
 private:
     Mat image;
     Mat_<double> scaled_image;
@@ -320,7 +345,19 @@ private:
     double *angles_data;
     Mat_<double> modgrad;
     double *modgrad_data;
-    Mat_<uchar> used;
+    // The double angles stay: region points keep the exact angle (region angle, get_theta)
+    // and ALIGN_CHECK compares it. Growth reads them only for accepted and CHECK pixels,
+    // the candidate test itself touches the bit planes and the 1 byte bins.
+    std::vector<uchar> angle_bins;      // quantized angles (see ANGLE_BINS)
+    std::vector<uint64_t> defined_bits; // bit planes, one bit per pixel, plane_stride words per row
+    std::vector<uint64_t> used_bits;
+    int plane_stride;
+    mutable double tolerance_precs[TOLERANCE_SLOTS]; // precision of each slot (< 0: empty)
+    mutable uchar tolerance_tables[TOLERANCE_SLOTS][ANGLE_BINS];
+    mutable int tolerance_next;
+    Mat_<uchar> mask;        // non-zero: detect (scaled image size)
+    uchar *mask_data;
+    bool masked;
 
     int img_width;
     int img_height;
@@ -330,6 +367,9 @@ private:
     bool p_needed;
     bool n_needed;
 
+    bool time_phases;
+    LSDPhaseTimes phase_times;
+
     const double SCALE;
     const int doRefine;
     const double SIGMA_SCALE;
@@ -342,7 +382,6 @@ private:
     struct RegionPoint {
         int x;
         int y;
-        uchar* used;
         double angle;
         double modgrad;
     };
@@ -371,6 +410,11 @@ private:
     enum {RETAIN_IN  = 0,
           RETAIN_OUT = 1
          };
+/**
+ * Current time in ms (only queried when the phase timing is enabled).
+ */
+    double phase_clock() const;
+
 /**
  * Detect lines in the whole input image.
  *
@@ -473,6 +517,45 @@ private:
  */
     bool isAligned(const int& address, const double& theta, const double& prec) const;
 
+/**
+ * Same as isAligned for a defined pixel, using the quantized angles and the tolerance table
+ * of 'prec' (see angle_tolerance). Only differences close to 'prec' are compared exactly.
+ * @return      Whether the point is aligned.
+ */
+    bool isAlignedQuantized(const int& address, const double& theta, const double& prec,
+                            const uchar* tolerance) const;
+
+/**
+ * Builds the tolerance table of a precision, indexed by the uchar difference of two angle bins.
+ *
+ * @param prec      The precision (angle tolerance).
+ * @param table     Return: ANGLE_BINS entries ALIGN_NO/ALIGN_YES/ALIGN_CHECK.
+ */
+    void angle_tolerance(const double& prec, uchar* table) const;
+
+/**
+ * Cached tolerance table of a precision (built on first use, slot 0 is kept for the
+ * precision of flsd, the others are replaced round robin).
+ */
+    const uchar* tolerance_table(const double& prec) const;
+
+/**
+ * Angle bin of an angle (any range).
+ */
+    uchar angle_bin(const double& angle) const;
+
+/**
+ * The n <= 3 bits of a bit plane starting at (x, y), bit 0 is pixel x.
+ */
+    uint64_t plane_bits(const std::vector<uint64_t>& plane, const int& x, const int& y, const int& n) const;
+
+/**
+ * Set/clear/test a bit of a bit plane.
+ */
+    void set_bit(std::vector<uint64_t>& plane, const int& x, const int& y);
+    void clear_bit(std::vector<uint64_t>& plane, const int& x, const int& y);
+    bool test_bit(const std::vector<uint64_t>& plane, const int& x, const int& y) const;
+
 /**
  * A helper funciton for filterOutAngle and retainAngle.
  */
@@ -503,6 +586,11 @@ LineSegmentDetectorImpl::LineSegmentDetectorImpl(int _refine, double _scale, dou
         :SCALE(_scale), doRefine(_refine), SIGMA_SCALE(_sigma_scale), QUANT(_quant),
         ANG_TH(_ang_th), LOG_EPS(_log_eps), DENSITY_TH(_density_th), N_BINS(_n_bins)
 {
+    time_phases = false;
+    masked = false;
+    mask_data = 0;
+    tolerance_next = 0;
+    for(int i = 0; i < TOLERANCE_SLOTS; ++i) { tolerance_precs[i] = -1; }
     CV_Assert(_scale > 0 && _sigma_scale > 0 && _quant >= 0 &&
               _ang_th > 0 && _ang_th < 180 && _density_th >= 0 && _density_th < 1 &&
               _n_bins > 0);
@@ -510,10 +598,24 @@ LineSegmentDetectorImpl::LineSegmentDetectorImpl(int _refine, double _scale, dou
 
 void LineSegmentDetectorImpl::detect(const InputArray _image, OutputArray _lines,
                 OutputArray _width, OutputArray _prec, OutputArray _nfa)
+{
+    detectMasked(_image, noArray(), _lines, _width, _prec, _nfa);
+}
+
+void LineSegmentDetectorImpl::detectMasked(const InputArray _image, const InputArray _mask, OutputArray _lines,
+                OutputArray _width, OutputArray _prec, OutputArray _nfa)
 {
     Mat_<double> img = _image.getMat();
     CV_Assert(!img.empty() && img.channels() == 1);
 
+    Mat mask_full = _mask.getMat();
+    masked = !mask_full.empty();
+    if(masked)
+    {
+        CV_Assert(mask_full.type() == CV_8UC1 && mask_full.size() == img.size());
+        mask_full.copyTo(mask);
+    }
+
     // Convert image to double
     img.convertTo(image, CV_64FC1);
 
@@ -522,6 +624,7 @@ void LineSegmentDetectorImpl::detect(const InputArray _image, OutputArray _lines
     w_needed = _width.needed();
     p_needed = _prec.needed();
     n_needed = _nfa.needed();
+    phase_times = LSDPhaseTimes();
 
     CV_Assert((!_nfa.needed()) ||                              // NFA InputArray will be filled _only_ when
               (_nfa.needed() && doRefine >= LSD_REFINE_ADV));  // REFINE_ADV type LineSegmentDetectorImpl object is created.
@@ -534,6 +637,21 @@ void LineSegmentDetectorImpl::detect(const InputArray _image, OutputArray _lines
     if(n_needed) Mat(n).copyTo(_nfa);
 }
 
+void LineSegmentDetectorImpl::setPhaseTiming(bool enable)
+{
+    time_phases = enable;
+}
+
+LSDPhaseTimes LineSegmentDetectorImpl::getPhaseTimes() const
+{
+    return phase_times;
+}
+
+double LineSegmentDetectorImpl::phase_clock() const
+{
+    return double(getTickCount()) * 1000.0 / getTickFrequency();
+}
+
 void LineSegmentDetectorImpl::flsd(std::vector<Vec4f>& lines,
     std::vector<double>& widths, std::vector<double>& precisions,
     std::vector<double>& nfas)
@@ -543,7 +661,12 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4f>& lines,
     const double p = ANG_TH / 180;
     const double rho = QUANT / sin(prec);    // gradient magnitude threshold
 
+    // Tolerance table of the region growing precision, once per call
+    angle_tolerance(prec, tolerance_tables[0]);
+    tolerance_precs[0] = prec;
+
     std::vector<coorlist> list;
+    double t_phase = (time_phases) ? phase_clock() : 0;
     if(SCALE != 1)
     {
         Mat gaussian_img;
@@ -554,6 +677,14 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4f>& lines,
         GaussianBlur(image, gaussian_img, ksize, sigma);
         // Scale image to needed size
         resize(gaussian_img, scaled_image, Size(), SCALE, SCALE);
+        if(masked)
+        {
+            // a scaled pixel is unmasked if any of its source pixels is
+            Mat mask_scaled;
+            resize(mask, mask_scaled, scaled_image.size(), 0, 0, INTER_AREA);
+            mask = mask_scaled > 0;
+        }
+        if(time_phases) phase_times.gradient += phase_clock() - t_phase;
         ll_angle(rho, N_BINS, list);
     }
     else
@@ -567,7 +698,7 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4f>& lines,
 
     // // Initialize region only when needed
     // Mat region = Mat::zeros(scaled_image.size(), CV_8UC1);
-    used = Mat_<uchar>::zeros(scaled_image.size()); // zeros = NOTUSED
+    used_bits.assign(defined_bits.size(), 0); // no pixel used
     std::vector<RegionPoint> reg(img_width * img_height);
 
     // Search for line segments
@@ -575,30 +706,41 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4f>& lines,
     unsigned int list_size = list.size();
     for(unsigned int i = 0; i < list_size; ++i)
     {
-        unsigned int adx = list[i].p.x + list[i].p.y * img_width;
-        if((used.data[adx] == NOTUSED) && (angles_data[adx] != NOTDEF))
+        const Point2i& pt = list[i].p;
+        if(test_bit(defined_bits, pt.x, pt.y) && !test_bit(used_bits, pt.x, pt.y))
         {
             int reg_size;
             double reg_angle;
+            if(time_phases) t_phase = phase_clock();
             region_grow(list[i].p, reg, reg_size, reg_angle, prec);
 
             // Ignore small regions
-            if(reg_size < min_reg_size) { continue; }
+            if(reg_size < min_reg_size)
+            {
+                if(time_phases) phase_times.region_growing += phase_clock() - t_phase;
+                continue;
+            }
 
             // Construct rectangular approximation for the region
             rect rec;
             region2rect(reg, reg_size, reg_angle, prec, p, rec);
+            if(time_phases) phase_times.region_growing += phase_clock() - t_phase;
 
             double log_nfa = -1;
             if(doRefine > LSD_REFINE_NONE)
             {
                 // At least REFINE_STANDARD lvl.
-                if(!refine(reg, reg_size, reg_angle, prec, p, rec, DENSITY_TH)) { continue; }
+                if(time_phases) t_phase = phase_clock();
+                bool refined = refine(reg, reg_size, reg_angle, prec, p, rec, DENSITY_TH);
+                if(time_phases) phase_times.refinement += phase_clock() - t_phase;
+                if(!refined) { continue; }
 
                 if(doRefine >= LSD_REFINE_ADV)
                 {
                     // Compute NFA
+                    if(time_phases) t_phase = phase_clock();
                     log_nfa = rect_improve(rec);
+                    if(time_phases) phase_times.nfa += phase_clock() - t_phase;
                     if(log_nfa <= LOG_EPS) { continue; }
                 }
             }
@@ -637,6 +779,8 @@ void LineSegmentDetectorImpl::ll_angle(const double& threshold,
                                    const unsigned int& n_bins,
                                    std::vector<coorlist>& list)
 {
+    double t_phase = (time_phases) ? phase_clock() : 0;
+
     //Initialize data
     angles = Mat_<double>(scaled_image.size());
     modgrad = Mat_<double>(scaled_image.size());
@@ -657,11 +801,27 @@ void LineSegmentDetectorImpl::ll_angle(const double& threshold,
               modgrad.isContinuous() &&
               angles.isContinuous());   // Accessing image data linearly
 
+    // Quantized angles and defined pixels (bit plane)
+    plane_stride = (img_width + 63) / 64;
+    angle_bins.assign(img_width * img_height, 0);
+    defined_bits.assign(plane_stride * img_height, 0);
+
+    // Masked pixels: no gradient
+    mask_data = (masked) ? mask.ptr<uchar>(0) : 0;
+    if(masked)
+    {
+        CV_Assert(mask.isContinuous() && mask.size() == scaled_image.size());
+        angles.setTo(NOTDEF);
+        modgrad.setTo(0);
+    }
+
     double max_grad = -1;
     for(int y = 0; y < img_height - 1; ++y)
     {
         for(int addr = y * img_width, addr_end = addr + img_width - 1; addr < addr_end; ++addr)
         {
+            if(masked && !mask_data[addr]) { continue; }
+
             double DA = scaled_image_data[addr + img_width + 1] - scaled_image_data[addr];
             double BC = scaled_image_data[addr + 1] - scaled_image_data[addr + img_width];
             double gx = DA + BC;    // gradient x component
@@ -677,12 +837,21 @@ void LineSegmentDetectorImpl::ll_angle(const double& threshold,
             else
             {
                 angles_data[addr] = fastAtan2(float(gx), float(-gy)) * DEG_TO_RADS;  // gradient angle computation
+                angle_bins[addr] = angle_bin(angles_data[addr]);
+                set_bit(defined_bits, addr - y * img_width, y);
                 if (norm > max_grad) { max_grad = norm; }
             }
 
         }
     }
 
+    if(time_phases)
+    {
+        double t_now = phase_clock();
+        phase_times.gradient += t_now - t_phase;
+        t_phase = t_now;
+    }
+
     // Compute histogram of gradient values
     list = std::vector<coorlist>(img_width * img_height);
     std::vector<coorlist*> range_s(n_bins);
@@ -693,8 +862,11 @@ void LineSegmentDetectorImpl::ll_angle(const double& threshold,
     for(int y = 0; y < img_height - 1; ++y)
     {
         const double* norm = modgrad_data + y * img_width;
+        const uchar* valid = (masked) ? mask_data + y * img_width : 0;
         for(int x = 0; x < img_width - 1; ++x, ++norm)
         {
+            if(masked && !valid[x]) { continue; }
+
             // Store the point in the right bin according to its norm
             int i = int((*norm) * bin_coef);
             if(!range_e[i])
@@ -730,24 +902,30 @@ void LineSegmentDetectorImpl::ll_angle(const double& threshold,
             }
         }
     }
+
+    // Masked pixels are not in the list (no pointer into the list is invalidated)
+    if(masked) { list.resize(count); }
+
+    if(time_phases) phase_times.ordering += phase_clock() - t_phase;
 }
 
 void LineSegmentDetectorImpl::region_grow(const Point2i& s, std::vector<RegionPoint>& reg,
                                       int& reg_size, double& reg_angle, const double& prec)
 {
+    const uchar* tolerance = tolerance_table(prec);
+
     // Point to this region
     reg_size = 1;
     reg[0].x = s.x;
     reg[0].y = s.y;
     int addr = s.x + s.y * img_width;
-    reg[0].used = used.data + addr;
     reg_angle = angles_data[addr];
     reg[0].angle = reg_angle;
     reg[0].modgrad = modgrad_data[addr];
 
     float sumdx = float(std::cos(reg_angle));
     float sumdy = float(std::sin(reg_angle));
-    *reg[0].used = USED;
+    set_bit(used_bits, s.x, s.y);
 
     //Try neighboring regions
     for(int i = 0; i < reg_size; ++i)
@@ -755,20 +933,23 @@ void LineSegmentDetectorImpl::region_grow(const Point2i& s, std::vector<RegionPo
         const RegionPoint& rpoint = reg[i];
         int xx_min = std::max(rpoint.x - 1, 0), xx_max = std::min(rpoint.x + 1, img_width - 1);
         int yy_min = std::max(rpoint.y - 1, 0), yy_max = std::min(rpoint.y + 1, img_height - 1);
+        int n = xx_max - xx_min + 1;
         for(int yy = yy_min; yy <= yy_max; ++yy)
         {
-            int c_addr = xx_min + yy * img_width;
-            for(int xx = xx_min; xx <= xx_max; ++xx, ++c_addr)
+            // Defined and not yet used neighbors (word level)
+            uint64_t candidates = plane_bits(defined_bits, xx_min, yy, n) & ~plane_bits(used_bits, xx_min, yy, n);
+            for(; candidates; candidates &= candidates - 1)
             {
-                if((used.data[c_addr] != USED) &&
-                   (isAligned(c_addr, reg_angle, prec)))
+                int xx = xx_min;
+                if(!(candidates & 1)) { xx += (candidates & 2) ? 1 : 2; }
+                int c_addr = xx + yy * img_width;
+                if(isAlignedQuantized(c_addr, reg_angle, prec, tolerance))
                 {
                     // Add point
-                    used.data[c_addr] = USED;
+                    set_bit(used_bits, xx, yy);
                     RegionPoint& region_point = reg[reg_size];
                     region_point.x = xx;
                     region_point.y = yy;
-                    region_point.used = &(used.data[c_addr]);
                     region_point.modgrad = modgrad_data[c_addr];
                     const double& angle = angles_data[c_addr];
                     region_point.angle = angle;
@@ -897,7 +1078,7 @@ bool LineSegmentDetectorImpl::refine(std::vector<RegionPoint>& reg, int& reg_siz
 
     for (int i = 0; i < reg_size; ++i)
     {
-        *(reg[i].used) = NOTUSED;
+        clear_bit(used_bits, reg[i].x, reg[i].y);
         if (dist(xc, yc, reg[i].x, reg[i].y) < rec.width)
         {
             const double& angle = reg[i].angle;
@@ -948,7 +1129,7 @@ bool LineSegmentDetectorImpl::reduce_region_radius(std::vector<RegionPoint>& reg
             if(distSq(xc, yc, double(reg[i].x), double(reg[i].y)) > radSq)
             {
                 // Remove point from the region
-                *(reg[i].used) = NOTUSED;
+                clear_bit(used_bits, reg[i].x, reg[i].y);
                 std::swap(reg[i], reg[reg_size - 1]);
                 --reg_size;
                 --i; // To avoid skipping one point
@@ -1074,6 +1255,8 @@ double LineSegmentDetectorImpl::rect_improve(rect& rec) const
 
 double LineSegmentDetectorImpl::rect_nfa(const rect& rec) const
 {
+    const uchar* tolerance = tolerance_table(rec.prec);
+
     int total_pts = 0, alg_pts = 0;
     double half_width = rec.width / 2.0;
     double dyhw = rec.dy * half_width;
@@ -1179,7 +1362,7 @@ double LineSegmentDetectorImpl::rect_nfa(const rect& rec) const
             if (x < 0 || x >= img_width) continue;
 
             ++total_pts;
-            if(isAligned(adx, rec.theta, rec.prec))
+            if(test_bit(defined_bits, x, y) && isAlignedQuantized(adx, rec.theta, rec.prec, tolerance))
             {
                 ++alg_pts;
             }
@@ -1251,6 +1434,76 @@ inline bool LineSegmentDetectorImpl::isAligned(const int& address, const double&
     return n_theta <= prec;
 }
 
+inline bool LineSegmentDetectorImpl::isAlignedQuantized(const int& address, const double& theta, const double& prec,
+                                                    const uchar* tolerance) const
+{
+    uchar state = tolerance[uchar(angle_bins[address] - angle_bin(theta))];
+    if(state == ALIGN_CHECK) { return isAligned(address, theta, prec); }
+    return state == ALIGN_YES;
+}
+
+void LineSegmentDetectorImpl::angle_tolerance(const double& prec, uchar* table) const
+{
+    // Each bin is within half a bin of its angle --> the bin difference is within
+    // one bin of the angle difference. For the angles in [0, 2 pi) and theta in
+    // [0, 3 pi) isAligned compares the circular difference, except in (pi, 3/2 pi]
+    // (not wrapped), which only matters for a precision close to pi/2.
+    const double bin_width = M_2__PI / ANGLE_BINS;
+    const bool quantized = (prec < CV_PI / 2 - 2 * bin_width);
+    for(int d = 0; d < ANGLE_BINS; ++d)
+    {
+        int q = std::min(d, ANGLE_BINS - d); // circular bin difference
+        if(!quantized)                                         { table[d] = ALIGN_CHECK; }
+        else if(double(q + 1) * bin_width * (1 + 1e-9) < prec) { table[d] = ALIGN_YES; }
+        else if(double(q - 1) * bin_width * (1 - 1e-9) > prec) { table[d] = ALIGN_NO; }
+        else                                                   { table[d] = ALIGN_CHECK; }
+    }
+}
+
+const uchar* LineSegmentDetectorImpl::tolerance_table(const double& prec) const
+{
+    for(int i = 0; i < TOLERANCE_SLOTS; ++i)
+    {
+        if(tolerance_precs[i] == prec) { return tolerance_tables[i]; }
+    }
+
+    // refine (tau) and rect_improve (halved precisions) use a few other values
+    int slot = 1 + tolerance_next;
+    tolerance_next = (tolerance_next + 1) % (TOLERANCE_SLOTS - 1);
+    angle_tolerance(prec, tolerance_tables[slot]);
+    tolerance_precs[slot] = prec;
+    return tolerance_tables[slot];
+}
+
+inline uchar LineSegmentDetectorImpl::angle_bin(const double& angle) const
+{
+    return uchar(int(std::floor(angle * (ANGLE_BINS / M_2__PI) + 0.5)) & (ANGLE_BINS - 1));
+}
+
+inline uint64_t LineSegmentDetectorImpl::plane_bits(const std::vector<uint64_t>& plane, const int& x,
+                                                    const int& y, const int& n) const
+{
+    const uint64_t* row = &plane[y * plane_stride];
+    int w = x >> 6, b = x & 63;
+    uint64_t bits = row[w] >> b;
+    if(b + n > 64) { bits |= row[w + 1] << (64 - b); }
+    return bits & ((uint64_t(1) << n) - 1);
+}
+
+inline void LineSegmentDetectorImpl::set_bit(std::vector<uint64_t>& plane, const int& x, const int& y)
+{
+    plane[y * plane_stride + (x >> 6)] |= uint64_t(1) << (x & 63);
+}
+
+inline void LineSegmentDetectorImpl::clear_bit(std::vector<uint64_t>& plane, const int& x, const int& y)
+{
+    plane[y * plane_stride + (x >> 6)] &= ~(uint64_t(1) << (x & 63));
+}
+
+inline bool LineSegmentDetectorImpl::test_bit(const std::vector<uint64_t>& plane, const int& x, const int& y) const
+{
+    return (plane[y * plane_stride + (x >> 6)] >> (x & 63)) & 1;
+}
 
 void LineSegmentDetectorImpl::drawSegments(InputOutputArray _image, const InputArray lines)
 {
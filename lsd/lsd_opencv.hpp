@@ -55,6 +55,19 @@ enum {LSD_NO_SIZE_LIMIT = -1,
 
 };
 
+// Time spent in the individual phases of the last detect() call [ms].
+// Only measured when enabled via setPhaseTiming(true).
+struct LSDPhaseTimes
+{
+    double gradient;        // smoothing, scaling and gradient computation
+    double ordering;        // pseudo-ordering of the pixels by gradient magnitude
+    double region_growing;  // region growing and rectangular approximation
+    double refinement;      // region refinement (LSD_REFINE_STD and above)
+    double nfa;             // NFA computation and rectangle improvement (LSD_REFINE_ADV)
+
+    LSDPhaseTimes() : gradient(0), ordering(0), region_growing(0), refinement(0), nfa(0) {}
+};
+
 class LineSegmentDetector : public Algorithm
 {
 public:
@@ -83,6 +96,23 @@ public:
                         OutputArray width = noArray(), OutputArray prec = noArray(),
                         OutputArray nfa = noArray()) = 0;
 
+/**
+ * Detect lines only in the unmasked part of the input image.
+ * Masked pixels get no gradient, are not ordered and never join a region,
+ * so the detection time scales with the unmasked area.
+ *
+ * @param _image    A grayscale(CV_8UC1) input image.
+ * @param _mask     A CV_8UC1 mask of the same size, lines are detected where it is non-zero.
+ *                  An empty mask is the same as detect().
+ * @param _lines    Return: see detect().
+ * @param width     Return: see detect().
+ * @param prec      Return: see detect().
+ * @param nfa       Return: see detect().
+ */
+    virtual void detectMasked(InputArray _image, InputArray _mask, OutputArray _lines,
+                              OutputArray width = noArray(), OutputArray prec = noArray(),
+                              OutputArray nfa = noArray()) = 0;
+
 /**
  * Draw lines on the given canvas.
  *
@@ -151,6 +181,20 @@ public:
  */
     CV_WRAP virtual bool intersection(InputArray line1, InputArray line2, Point& P) = 0;
 
+/**
+ * Enable or disable the per-phase timing of detect() (disabled by default).
+ *
+ * @param enable        Measure the phases of subsequent detect() calls.
+ */
+    virtual void setPhaseTiming(bool enable) = 0;
+
+/**
+ * Per-phase timing of the last detect() call.
+ *
+ * @return              The phase times in ms (all zero if the timing is disabled).
+ */
+    virtual LSDPhaseTimes getPhaseTimes() const = 0;
+
     virtual ~LineSegmentDetector() {};
 };
 
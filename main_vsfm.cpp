@@ -77,6 +77,42 @@ int main(int argc, char *argv[])
     TCLAP::ValueArg<float> minBaselineArg("x", "min_image_baseline", "minimum baseline between matching images (world space)", false, L3D_DEF_MIN_BASELINE_T, "float");
     cmd.add(minBaselineArg);
 
+    TCLAP::ValueArg<float> memoryArg("u", "memory_budget", "memory budget [MB] for the host data structures (0 --> unlimited)", false, L3D_DEF_MEMORY_BUDGET_MB, "float");
+    cmd.add(memoryArg);
+
+    TCLAP::ValueArg<std::string> roiArg("r", "roi_box", "axis-aligned region of interest 'cx cy cz hx hy hz' (center, half size; empty --> everything)", false, "", "string");
+    cmd.add(roiArg);
+
+    TCLAP::ValueArg<float> budgetArg("q", "matching_time_target", "adaptive number of matching neighbors per view, to finish the matching in ~t seconds (0 --> fixed)", false, L3D_DEF_MATCHING_TIME_TARGET, "float");
+    cmd.add(budgetArg);
+
+    TCLAP::ValueArg<int> segmentsArg("s", "max_num_segments", "max. number of line segments per image (0 --> unlimited)", false, L3D_DEF_MAX_NUM_SEGMENTS, "int");
+    cmd.add(segmentsArg);
+
+    TCLAP::ValueArg<int> clusteringArg("y", "clustering", "clustering engine (0: graph clustering, 1: label propagation, for very large datasets)", false, L3D_DEF_CLUSTERING, "int");
+    cmd.add(clusteringArg);
+
+    TCLAP::ValueArg<int> topkArg("k", "affinity_top_k", "max. number of affinities per segment before clustering (strongest ones, 0 --> all)", false, L3D_DEF_AFFINITY_TOP_K, "int");
+    cmd.add(topkArg);
+
+    TCLAP::ValueArg<int> ioArg("j", "io_threads", "background threads which prefetch the match files (0 --> synchronous reads)", false, L3D_DEF_PREFETCH_THREADS, "int");
+    cmd.add(ioArg);
+
+    TCLAP::ValueArg<bool> numaArg("f", "numa_aware", "CPU matching: pin threads to the NUMA nodes, node local segment data", false, L3D_DEF_NUMA_AWARE, "bool");
+    cmd.add(numaArg);
+
+    TCLAP::ValueArg<bool> mergeArg("c", "merge_fragments", "join nearly collinear, nearly touching segment fragments before matching", false, L3D_DEF_MERGE_FRAGMENTS, "bool");
+    cmd.add(mergeArg);
+
+    TCLAP::ValueArg<bool> directionsArg("t", "direction_classes", "only match segments which point at a common vanishing point (man-made scenes)", false, L3D_DEF_DIRECTION_CLASSES, "bool");
+    cmd.add(directionsArg);
+
+    TCLAP::ValueArg<int> cullingArg("z", "view_culling", "redundant view culling (0: off, 1: near-duplicate views are not matched, 2: 1 + their segments are re-attached by projection)", false, L3D_DEF_VIEW_CULLING, "int");
+    cmd.add(cullingArg);
+
+    TCLAP::ValueArg<bool> tuneArg("T", "auto_tune", "measure the CPU matching parameters of this host (synthetic scene) and store them as its tuning profile", false, false, "bool");
+    cmd.add(tuneArg);
+
     // read arguments
     cmd.parse(argc,argv);
     std::string inputFolder = imgArg.getValue().c_str();
@@ -96,6 +132,18 @@ int main(int argc, char *argv[])
     float sigma_a = fabs(sigma_A_Arg.getValue());
     float sigma_p = fabs(sigma_P_Arg.getValue());
     float min_baseline = fabs(minBaselineArg.getValue());
+    float memory_budget = fabs(memoryArg.getValue());
+    std::string roi_box = roiArg.getValue();
+    float matching_time_target = fabs(budgetArg.getValue());
+    int max_segments = std::max(segmentsArg.getValue(),0);
+    int clustering = clusteringArg.getValue();
+    int top_k = std::max(topkArg.getValue(),0);
+    int io_threads = std::max(ioArg.getValue(),0);
+    bool numa_aware = numaArg.getValue();
+    bool merge_fragments = mergeArg.getValue();
+    bool direction_classes = directionsArg.getValue();
+    int view_culling = cullingArg.getValue();
+    bool auto_tune = tuneArg.getValue();
 
     std::string prefix = "[SYS] ";
 
@@ -117,6 +165,39 @@ int main(int argc, char *argv[])
                                           max_uncertainty,min_uncertainty,
                                           sigma_p,sigma_a,min_baseline,
                                           collinearity,verbose);
+    line3D->setMemoryBudget(memory_budget);
+    line3D->setMatchingBudget(matching_time_target);
+    line3D->setMaxNumSegments(max_segments);
+    line3D->setClusteringEngine(clustering);
+    line3D->setAffinityTopK(top_k);
+    line3D->setPrefetching(io_threads);
+    line3D->setNumaAware(numa_aware);
+    line3D->setFragmentMerging(merge_fragments);
+    line3D->setDirectionClasses(direction_classes);
+    line3D->setViewCulling(view_culling);
+
+    // CPU tuning profile (before the images are added)
+    if(auto_tune)
+        line3D->autoTune();
+
+    // region of interest
+    if(roi_box.length() > 0)
+    {
+        std::stringstream roi_stream(roi_box);
+        float cx,cy,cz,hx,hy,hz;
+        if(roi_stream >> cx >> cy >> cz >> hx >> hy >> hz)
+        {
+            line3D->setRegionOfInterest(L3D::L3DRegionOfInterest::box(make_float3(cx,cy,cz),
+                                                                      make_float3(1,0,0),
+                                                                      make_float3(0,1,0),
+                                                                      make_float3(0,0,1),
+                                                                      make_float3(fabs(hx),fabs(hy),fabs(hz))));
+        }
+        else
+        {
+            std::cerr << "invalid region of interest: " << roi_box << std::endl;
+        }
+    }
 
     // read NVM file
     std::ifstream nvm_file;
@@ -312,6 +393,9 @@ int main(int argc, char *argv[])
     // save as txt
     line3D->save3DLinesAsTXT(result,outputFolder+str.str()+".txt");
 
+    // save 2D-3D association index
+    line3D->save2D3DAssociationIndex(result,outputFolder+str.str()+"_assoc.bin");
+
     unsigned int num_indiv_segments = 0;
     std::list<L3D::L3DFinalLine3D>::iterator rit = result.begin();
     for(; rit!=result.end(); ++rit)
@@ -324,6 +408,9 @@ int main(int argc, char *argv[])
     std::cout << prefix << "3D segments:     " << num_indiv_segments << std::endl;
     std::cout << prefix << "#images:         " << line3D->numCameras() << std::endl;
 
+    // save trace (only if compiled with L3D_ENABLE_TRACING)
+    L3D_TRACE_DUMP(outputFolder+"/line3D_trace.json");
+
     // cleanup
     delete line3D;
 }
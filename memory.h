@@ -0,0 +1,129 @@
+#ifndef I3D_LINE3D_MEMORY_H_
+#define I3D_LINE3D_MEMORY_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// std
+#include <cstddef>
+#include <string>
+#include <algorithm>
+
+/**
+ * Line3D - Memory Tracker
+ * ====================
+ * Host memory accounting for the major data
+ * structures (estimated from the number of
+ * elements, incl. the node overhead of the
+ * STL containers). Current and peak usage
+ * per structure and in total.
+ * ====================
+ */
+
+namespace L3D
+{
+    // tracked structures
+    #define L3D_MEM_SEGMENTS 0
+    #define L3D_MEM_COLLINEARITY 1
+    #define L3D_MEM_MATCHES 2
+    #define L3D_MEM_CORRESPONDENCES 3
+    #define L3D_MEM_AFFINITIES 4
+    #define L3D_MEM_CLUSTERS 5
+    #define L3D_MEM_NUM_STRUCTURES 6
+
+    // heap overhead per node (pointers, color, allocator header)
+    #define L3D_MEM_MAP_NODE_OVERHEAD 48
+    #define L3D_MEM_LIST_NODE_OVERHEAD 32
+
+    class L3DMemoryTracker
+    {
+    public:
+        L3DMemoryTracker(){
+            reset();
+        }
+
+        void reset(){
+            for(unsigned int i=0; i<L3D_MEM_NUM_STRUCTURES; ++i)
+            {
+                current_[i] = 0;
+                peak_[i] = 0;
+            }
+            peak_total_ = 0;
+        }
+
+        // set/add/remove usage of a structure [bytes]
+        void set(const unsigned int structure, const size_t bytes){
+            current_[structure] = bytes;
+            peak_[structure] = std::max(peak_[structure],bytes);
+            peak_total_ = std::max(peak_total_,total());
+        }
+        void add(const unsigned int structure, const size_t bytes){
+            set(structure,current_[structure]+bytes);
+        }
+        void remove(const unsigned int structure, const size_t bytes){
+            set(structure,current_[structure]-std::min(current_[structure],bytes));
+        }
+
+        // transient usage of a structure [bytes] (peak only, current is unchanged)
+        void recordPeak(const unsigned int structure, const size_t bytes){
+            peak_[structure] = std::max(peak_[structure],bytes);
+            peak_total_ = std::max(peak_total_,total()-current_[structure]+bytes);
+        }
+
+        // data access [bytes]
+        size_t current(const unsigned int structure){return current_[structure];}
+        size_t peak(const unsigned int structure){return peak_[structure];}
+        size_t peak_total(){return peak_total_;}
+        size_t total(){
+            size_t sum = 0;
+            for(unsigned int i=0; i<L3D_MEM_NUM_STRUCTURES; ++i)
+                sum += current_[i];
+            return sum;
+        }
+
+        static std::string name(const unsigned int structure){
+            switch(structure)
+            {
+            case L3D_MEM_SEGMENTS: return "segments";
+            case L3D_MEM_COLLINEARITY: return "collinearity";
+            case L3D_MEM_MATCHES: return "matches";
+            case L3D_MEM_CORRESPONDENCES: return "correspondences";
+            case L3D_MEM_AFFINITIES: return "affinities";
+            case L3D_MEM_CLUSTERS: return "clusters";
+            default: return "unknown";
+            }
+        }
+
+        // size estimates for STL containers
+        template<typename K, typename V>
+        static size_t mapBytes(const size_t entries){
+            return entries*(sizeof(K)+sizeof(V)+L3D_MEM_MAP_NODE_OVERHEAD);
+        }
+        template<typename T>
+        static size_t listBytes(const size_t entries){
+            return entries*(sizeof(T)+L3D_MEM_LIST_NODE_OVERHEAD);
+        }
+
+    private:
+        size_t current_[L3D_MEM_NUM_STRUCTURES];
+        size_t peak_[L3D_MEM_NUM_STRUCTURES];
+        size_t peak_total_;
+    };
+}
+
+#endif //I3D_LINE3D_MEMORY_H_
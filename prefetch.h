@@ -0,0 +1,356 @@
+#ifndef I3D_LINE3D_PREFETCH_H_
+#define I3D_LINE3D_PREFETCH_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// std
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <sstream>
+#include <map>
+#include <list>
+#include <vector>
+
+// internal
+#include "serialization.h"
+#include "timer.h"
+
+/**
+ * Line3D - Prefetcher
+ * ====================
+ * Reads and decodes serialized files (e.g. the
+ * raw matches of upcoming views) in background
+ * threads (pread), so that the I/O overlaps with
+ * the computation on the current view.
+ * Prefetched data is bounded by the bytes read from
+ * disk (file sizes, not the decoded size of T, which
+ * can be larger), requests which do not fit are
+ * dropped and read synchronously by load(). Files which are rewritten have to be
+ * invalidated, stale reads are discarded. Files
+ * which fail to decode in the background are read
+ * again by load() (errors reach the caller there).
+ * ====================
+ */
+
+namespace L3D
+{
+    template <typename T>
+    class L3DPrefetcher
+    {
+    public:
+        L3DPrefetcher(const unsigned int num_threads, const size_t max_bytes) :
+            max_bytes_(max_bytes), bytes_(0), stop_(false),
+            wait_ms_(0.0), num_loads_(0), num_hits_(0)
+        {
+            pthread_mutex_init(&mutex_,NULL);
+            pthread_cond_init(&work_,NULL);
+            pthread_cond_init(&done_,NULL);
+
+            for(unsigned int i=0; i<num_threads; ++i)
+            {
+                pthread_t t;
+                if(pthread_create(&t,NULL,&L3DPrefetcher<T>::worker,this) == 0)
+                    threads_.push_back(t);
+            }
+        }
+
+        ~L3DPrefetcher()
+        {
+            pthread_mutex_lock(&mutex_);
+            stop_ = true;
+            pthread_cond_broadcast(&work_);
+            pthread_mutex_unlock(&mutex_);
+
+            for(unsigned int i=0; i<threads_.size(); ++i)
+                pthread_join(threads_[i],NULL);
+
+            typename std::map<std::string,Entry*>::iterator it = entries_.begin();
+            for(; it!=entries_.end(); ++it)
+                delete it->second;
+
+            pthread_cond_destroy(&done_);
+            pthread_cond_destroy(&work_);
+            pthread_mutex_destroy(&mutex_);
+        }
+
+        // request a file (no-op if it is already requested, does not
+        // exist or its file size does not fit into the buffer)
+        void prefetch(const std::string& file)
+        {
+            if(threads_.size() == 0)
+                return;
+
+            struct stat st;
+            if(stat(file.c_str(),&st) != 0)
+                return;
+
+            pthread_mutex_lock(&mutex_);
+            if(entries_.find(file) == entries_.end() &&
+                    bytes_+size_t(st.st_size) <= max_bytes_)
+            {
+                Entry* e = new Entry();
+                e->state_ = L3D_PREFETCH_QUEUED;
+                e->bytes_ = st.st_size;
+                e->stale_ = false;
+                e->failed_ = false;
+                entries_[file] = e;
+                bytes_ += e->bytes_;
+                queue_.push_back(file);
+                pthread_cond_signal(&work_);
+            }
+            pthread_mutex_unlock(&mutex_);
+        }
+
+        // get the content of a file (prefetched, or read synchronously),
+        // returns false if the file does not exist (thread safe)
+        bool load(const std::string& file, T& data)
+        {
+            L3DTimer timer;
+            bool exists = false;
+            bool prefetched = false;
+
+            pthread_mutex_lock(&mutex_);
+            typename std::map<std::string,Entry*>::iterator it = entries_.find(file);
+            while(it != entries_.end() && it->second->state_ == L3D_PREFETCH_LOADING)
+            {
+                // wait for the read in progress
+                pthread_cond_wait(&done_,&mutex_);
+                it = entries_.find(file);
+            }
+
+            if(it != entries_.end())
+            {
+                Entry* e = it->second;
+                if(e->state_ == L3D_PREFETCH_READY && !e->failed_)
+                {
+                    exists = e->exists_;
+                    std::swap(data,e->data_);
+                    prefetched = true;
+                }
+                else
+                {
+                    // still queued or decoding failed --> read here
+                    queue_.remove(file);
+                }
+                release(it);
+            }
+            pthread_mutex_unlock(&mutex_);
+
+            if(!prefetched)
+                exists = readFile(file,data);
+
+            pthread_mutex_lock(&mutex_);
+            wait_ms_ += timer.elapsedMS();
+            ++num_loads_;
+            if(prefetched)
+                ++num_hits_;
+            pthread_mutex_unlock(&mutex_);
+
+            return exists;
+        }
+
+        // file is going to be rewritten (drops buffered data, reads
+        // in progress are discarded)
+        void invalidate(const std::string& file)
+        {
+            pthread_mutex_lock(&mutex_);
+            typename std::map<std::string,Entry*>::iterator it = entries_.find(file);
+            if(it != entries_.end())
+            {
+                if(it->second->state_ == L3D_PREFETCH_LOADING)
+                {
+                    it->second->stale_ = true;
+                }
+                else
+                {
+                    queue_.remove(file);
+                    release(it);
+                }
+            }
+            pthread_mutex_unlock(&mutex_);
+        }
+
+        // time spent in load() [ms] (summed over all calling threads)
+        double waitMS()
+        {
+            pthread_mutex_lock(&mutex_);
+            double ms = wait_ms_;
+            pthread_mutex_unlock(&mutex_);
+            return ms;
+        }
+
+        unsigned int numLoads(){return num_loads_;}
+        unsigned int numHits(){return num_hits_;}
+
+        void resetStatistics()
+        {
+            pthread_mutex_lock(&mutex_);
+            wait_ms_ = 0.0;
+            num_loads_ = 0;
+            num_hits_ = 0;
+            pthread_mutex_unlock(&mutex_);
+        }
+
+    private:
+        enum {L3D_PREFETCH_QUEUED, L3D_PREFETCH_LOADING, L3D_PREFETCH_READY};
+
+        struct Entry
+        {
+            int state_;
+            size_t bytes_;
+            bool stale_;
+            bool failed_;
+            bool exists_;
+            T data_;
+        };
+
+        // remove entry (mutex locked)
+        void release(typename std::map<std::string,Entry*>::iterator it)
+        {
+            bytes_ -= it->second->bytes_;
+            delete it->second;
+            entries_.erase(it);
+        }
+
+        // synchronous read
+        static bool readFile(const std::string& file, T& data)
+        {
+            struct stat st;
+            if(stat(file.c_str(),&st) != 0)
+                return false;
+
+            L3D::serializeFromFile(file,data);
+            return true;
+        }
+
+        // read the whole file (pread)
+        static bool readBytes(const std::string& file, std::string& buffer)
+        {
+            int fd = open(file.c_str(),O_RDONLY);
+            if(fd < 0)
+                return false;
+
+            struct stat st;
+            if(fstat(fd,&st) != 0)
+            {
+                close(fd);
+                return false;
+            }
+
+            buffer.resize(st.st_size);
+            size_t pos = 0;
+            while(pos < buffer.size())
+            {
+                ssize_t n = pread(fd,&buffer[pos],buffer.size()-pos,pos);
+                if(n <= 0)
+                    break;
+                pos += n;
+            }
+            close(fd);
+
+            buffer.resize(pos);
+            return (pos == size_t(st.st_size));
+        }
+
+        static void* worker(void* arg)
+        {
+            L3DPrefetcher<T>* self = static_cast<L3DPrefetcher<T>*>(arg);
+            pthread_mutex_lock(&self->mutex_);
+            while(true)
+            {
+                while(!self->stop_ && self->queue_.size() == 0)
+                    pthread_cond_wait(&self->work_,&self->mutex_);
+
+                if(self->stop_)
+                    break;
+
+                std::string file = self->queue_.front();
+                self->queue_.pop_front();
+
+                typename std::map<std::string,Entry*>::iterator it = self->entries_.find(file);
+                if(it == self->entries_.end())
+                    continue;
+
+                Entry* e = it->second;
+                e->state_ = L3D_PREFETCH_LOADING;
+                pthread_mutex_unlock(&self->mutex_);
+
+                // read and decode (unlocked)
+                T data;
+                std::string buffer;
+                bool exists = readBytes(file,buffer);
+                bool failed = false;
+                if(exists)
+                {
+                    try
+                    {
+                        std::istringstream is(buffer);
+                        boost::archive::binary_iarchive ar(is);
+                        ar & boost::serialization::make_nvp("data",data);
+                    }
+                    catch(...)
+                    {
+                        // corrupt/truncated archive --> load() reads it synchronously
+                        data = T();
+                        failed = true;
+                    }
+                }
+
+                pthread_mutex_lock(&self->mutex_);
+                if(e->stale_)
+                {
+                    // rewritten in the meantime
+                    self->release(self->entries_.find(file));
+                }
+                else
+                {
+                    std::swap(e->data_,data);
+                    e->exists_ = exists;
+                    e->failed_ = failed;
+                    e->state_ = L3D_PREFETCH_READY;
+                }
+                pthread_cond_broadcast(&self->done_);
+            }
+            pthread_mutex_unlock(&self->mutex_);
+            return NULL;
+        }
+
+        std::vector<pthread_t> threads_;
+        pthread_mutex_t mutex_;
+        pthread_cond_t work_;
+        pthread_cond_t done_;
+
+        std::map<std::string,Entry*> entries_;
+        std::list<std::string> queue_;
+        // bound and current sum of the file sizes (encoded bytes)
+        size_t max_bytes_;
+        size_t bytes_;
+        bool stop_;
+
+        // statistics
+        double wait_ms_;
+        unsigned int num_loads_;
+        unsigned int num_hits_;
+    };
+}
+
+#endif //I3D_LINE3D_PREFETCH_H_
@@ -0,0 +1,360 @@
+#ifndef I3D_LINE3D_ROI_H_
+#define I3D_LINE3D_ROI_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// std
+#include <vector>
+#include <set>
+#include <cmath>
+#include <algorithm>
+
+// external
+#include "cuda.h"
+#include "helper_math.h"
+
+/**
+ * Line3D - Region of Interest
+ * ====================
+ * Restricts the reconstruction to a 3D region
+ * and/or a subset of the views. The region is a
+ * prism: a polygon in the xy-plane of a local
+ * frame, extruded along its z-axis (an oriented
+ * box is a prism with a rectangular polygon).
+ * All visibility tests are conservative (they
+ * never reject something that could hit the region).
+ * Host code only, no Eigen (used in the .cu files).
+ * ====================
+ */
+
+namespace L3D
+{
+    class L3DRegionOfInterest
+    {
+    public:
+        L3DRegionOfInterest() : has_region_(false), z_min_(0.0f), z_max_(0.0f){
+            axes_[0] = make_float3(1,0,0);
+            axes_[1] = make_float3(0,1,0);
+            axes_[2] = make_float3(0,0,1);
+            origin_ = make_float3(0,0,0);
+        }
+
+        // oriented box (axes orthonormal, half_size along the axes)
+        static L3DRegionOfInterest box(const float3 center, const float3 axis_x,
+                                       const float3 axis_y, const float3 axis_z,
+                                       const float3 half_size)
+        {
+            std::vector<float2> rect;
+            rect.push_back(make_float2(-half_size.x,-half_size.y));
+            rect.push_back(make_float2(half_size.x,-half_size.y));
+            rect.push_back(make_float2(half_size.x,half_size.y));
+            rect.push_back(make_float2(-half_size.x,half_size.y));
+
+            return prism(center,axis_x,axis_y,axis_z,rect,-half_size.z,half_size.z);
+        }
+
+        // polygon (local xy-coordinates, any orientation) extruded from z_min to z_max
+        static L3DRegionOfInterest prism(const float3 origin, const float3 axis_x,
+                                         const float3 axis_y, const float3 axis_z,
+                                         const std::vector<float2>& polygon,
+                                         const float z_min, const float z_max)
+        {
+            L3DRegionOfInterest roi;
+            roi.has_region_ = (polygon.size() >= 3);
+            roi.origin_ = origin;
+            roi.axes_[0] = normalize(axis_x);
+            roi.axes_[1] = normalize(axis_y);
+            roi.axes_[2] = normalize(axis_z);
+            roi.polygon_ = polygon;
+            roi.z_min_ = std::min(z_min,z_max);
+            roi.z_max_ = std::max(z_min,z_max);
+            return roi;
+        }
+
+        // view subset (empty --> all views)
+        void setViews(const std::set<unsigned int>& views){
+            views_ = views;
+        }
+
+        bool hasRegion() const {return has_region_;}
+        bool hasViews() const {return views_.size() > 0;}
+        bool active() const {return hasRegion() || hasViews();}
+
+        bool viewSelected(const unsigned int id) const {
+            return (!hasViews() || views_.find(id) != views_.end());
+        }
+
+        // region in a transformed coordinate system (X' = s*R*X + t, R row-major)
+        L3DRegionOfInterest transformed(const float s, const float* R, const float3 t) const
+        {
+            L3DRegionOfInterest roi = *this;
+            roi.origin_ = s*rotate(R,origin_)+t;
+            for(unsigned int i=0; i<3; ++i)
+                roi.axes_[i] = rotate(R,axes_[i]);
+
+            for(unsigned int i=0; i<roi.polygon_.size(); ++i)
+                roi.polygon_[i] *= s;
+
+            roi.z_min_ *= s;
+            roi.z_max_ *= s;
+            return roi;
+        }
+
+        // point inside the region
+        bool contains(const float3 X) const
+        {
+            if(!has_region_)
+                return true;
+
+            float3 q = toLocal(X);
+            return (q.z >= z_min_ && q.z <= z_max_ && insidePolygon(make_float2(q.x,q.y)));
+        }
+
+        // 3D segment intersects the region
+        bool intersectsSegment(const float3 P1, const float3 P2) const
+        {
+            if(!has_region_)
+                return true;
+
+            float3 q1 = toLocal(P1);
+            float3 q2 = toLocal(P2);
+
+            // clip to the z-range
+            float t0 = 0.0f;
+            float t1 = 1.0f;
+            float dz = q2.z-q1.z;
+            if(fabs(dz) < 1e-12f)
+            {
+                if(q1.z < z_min_ || q1.z > z_max_)
+                    return false;
+            }
+            else
+            {
+                float ta = (z_min_-q1.z)/dz;
+                float tb = (z_max_-q1.z)/dz;
+                t0 = std::max(t0,std::min(ta,tb));
+                t1 = std::min(t1,std::max(ta,tb));
+                if(t0 > t1)
+                    return false;
+            }
+
+            float2 a = make_float2(q1.x+t0*(q2.x-q1.x),q1.y+t0*(q2.y-q1.y));
+            float2 b = make_float2(q1.x+t1*(q2.x-q1.x),q1.y+t1*(q2.y-q1.y));
+
+            if(insidePolygon(a) || insidePolygon(b))
+                return true;
+
+            for(unsigned int i=0; i<polygon_.size(); ++i)
+            {
+                if(segmentsIntersect2D(a,b,polygon_[i],polygon_[(i+1)%polygon_.size()]))
+                    return true;
+            }
+            return false;
+        }
+
+        // region (possibly) inside the view frustum [P: 3x4, row-major]
+        bool visibleInView(const float* P, const float width, const float height) const
+        {
+            if(!has_region_)
+                return true;
+
+            std::vector<float2> hull;
+            int state = projectedHull(P,hull);
+            if(state != 0)
+                return (state > 0);
+
+            std::vector<float2> image;
+            image.push_back(make_float2(0.0f,0.0f));
+            image.push_back(make_float2(width,0.0f));
+            image.push_back(make_float2(width,height));
+            image.push_back(make_float2(0.0f,height));
+
+            return convexOverlap(hull,image);
+        }
+
+        // 2D segment (possibly) sees the region, i.e. a ray through one of
+        // its points can hit it (hull: see projectedHull)
+        static bool visibleSegment(const std::vector<float2>& hull,
+                                   const float2 p1, const float2 p2)
+        {
+            std::vector<float2> seg;
+            seg.push_back(p1);
+            seg.push_back(p2);
+
+            return convexOverlap(hull,seg);
+        }
+
+        // convex hull of the projected region [P: 3x4, row-major]
+        // (returns +1: region (partly) behind the camera --> no test possible,
+        //          -1: region completely behind the camera, 0: hull computed)
+        int projectedHull(const float* P, std::vector<float2>& hull) const
+        {
+            std::vector<float2> pts;
+            unsigned int behind = 0;
+            for(unsigned int i=0; i<polygon_.size(); ++i)
+            {
+                for(unsigned int k=0; k<2; ++k)
+                {
+                    float z = (k == 0) ? z_min_ : z_max_;
+                    float3 X = origin_+polygon_[i].x*axes_[0]+polygon_[i].y*axes_[1]+z*axes_[2];
+
+                    float x = P[0]*X.x+P[1]*X.y+P[2]*X.z+P[3];
+                    float y = P[4]*X.x+P[5]*X.y+P[6]*X.z+P[7];
+                    float w = P[8]*X.x+P[9]*X.y+P[10]*X.z+P[11];
+
+                    if(w <= 1e-6f)
+                        ++behind;
+                    else
+                        pts.push_back(make_float2(x/w,y/w));
+                }
+            }
+
+            if(!has_region_ || (behind > 0 && pts.size() > 0))
+                return 1;
+            if(pts.size() == 0)
+                return -1;
+
+            convexHull(pts,hull);
+            return 0;
+        }
+
+    private:
+        static float3 rotate(const float* R, const float3 X)
+        {
+            return make_float3(R[0]*X.x+R[1]*X.y+R[2]*X.z,
+                               R[3]*X.x+R[4]*X.y+R[5]*X.z,
+                               R[6]*X.x+R[7]*X.y+R[8]*X.z);
+        }
+
+        float3 toLocal(const float3 X) const
+        {
+            float3 d = X-origin_;
+            return make_float3(dot(d,axes_[0]),dot(d,axes_[1]),dot(d,axes_[2]));
+        }
+
+        // even-odd rule (non-convex polygons allowed)
+        bool insidePolygon(const float2 p) const
+        {
+            bool inside = false;
+            unsigned int n = polygon_.size();
+            for(unsigned int i=0,j=n-1; i<n; j=i++)
+            {
+                float2 a = polygon_[i];
+                float2 b = polygon_[j];
+                if(((a.y > p.y) != (b.y > p.y)) &&
+                        (p.x < (b.x-a.x)*(p.y-a.y)/(b.y-a.y)+a.x))
+                    inside = !inside;
+            }
+            return inside;
+        }
+
+        static float cross2D(const float2 o, const float2 a, const float2 b)
+        {
+            return (a.x-o.x)*(b.y-o.y)-(a.y-o.y)*(b.x-o.x);
+        }
+
+        static bool segmentsIntersect2D(const float2 p1, const float2 p2,
+                                        const float2 q1, const float2 q2)
+        {
+            float d1 = cross2D(q1,q2,p1);
+            float d2 = cross2D(q1,q2,p2);
+            float d3 = cross2D(p1,p2,q1);
+            float d4 = cross2D(p1,p2,q2);
+            return (((d1 > 0.0f) != (d2 > 0.0f)) && ((d3 > 0.0f) != (d4 > 0.0f)));
+        }
+
+        static bool sortPoints2D(const float2 a, const float2 b)
+        {
+            return (a.x < b.x || (a.x == b.x && a.y < b.y));
+        }
+
+        // monotone chain
+        static void convexHull(std::vector<float2> pts, std::vector<float2>& hull)
+        {
+            std::sort(pts.begin(),pts.end(),sortPoints2D);
+            hull.assign(2*pts.size(),make_float2(0,0));
+
+            unsigned int k = 0;
+            for(unsigned int i=0; i<pts.size(); ++i)
+            {
+                while(k >= 2 && cross2D(hull[k-2],hull[k-1],pts[i]) <= 0.0f)
+                    --k;
+                hull[k++] = pts[i];
+            }
+            for(int i=int(pts.size())-2, t=k+1; i>=0; --i)
+            {
+                while(int(k) >= t && cross2D(hull[k-2],hull[k-1],pts[i]) <= 0.0f)
+                    --k;
+                hull[k++] = pts[i];
+            }
+            hull.resize(std::max(int(k)-1,1));
+        }
+
+        // separating axis test for two convex point sets
+        static bool separated(const std::vector<float2>& A, const std::vector<float2>& B,
+                              const std::vector<float2>& edges_of)
+        {
+            unsigned int n = edges_of.size();
+            for(unsigned int i=0; i<n; ++i)
+            {
+                float2 e = edges_of[(i+1)%n]-edges_of[i];
+                float2 axis = make_float2(-e.y,e.x);
+                if(fabs(axis.x)+fabs(axis.y) < 1e-12f)
+                    continue;
+
+                float minA = dot(axis,A[0]), maxA = minA;
+                for(unsigned int k=1; k<A.size(); ++k)
+                {
+                    float d = dot(axis,A[k]);
+                    minA = std::min(minA,d);
+                    maxA = std::max(maxA,d);
+                }
+                float minB = dot(axis,B[0]), maxB = minB;
+                for(unsigned int k=1; k<B.size(); ++k)
+                {
+                    float d = dot(axis,B[k]);
+                    minB = std::min(minB,d);
+                    maxB = std::max(maxB,d);
+                }
+
+                if(maxA < minB || maxB < minA)
+                    return true;
+            }
+            return false;
+        }
+
+        static bool convexOverlap(const std::vector<float2>& A, const std::vector<float2>& B)
+        {
+            return (!separated(A,B,A) && !separated(A,B,B));
+        }
+
+        // region
+        bool has_region_;
+        float3 origin_;
+        float3 axes_[3];
+        std::vector<float2> polygon_;
+        float z_min_;
+        float z_max_;
+
+        // views
+        std::set<unsigned int> views_;
+    };
+}
+
+#endif //I3D_LINE3D_ROI_H_
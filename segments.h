@@ -29,15 +29,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // internal
 #include "commons.h"
 #include "cudawrapper.h"
+#include "cpuwrapper.h"
 #include "serialization.h"
 #include "dataArray.h"
+#include "tracing.h"
 
 /**
  * Line3D - Segments
  * ====================
  * Class that holds all segments and
  * collinearity/intersection information
- * for one specific view.
+ * for one specific view, and the raw
+ * detections of an image (cache).
  * ====================
  * Author: M.Hofer, 2015
  */
@@ -57,8 +60,12 @@ namespace L3D
         }
 
         // data constructor
-        L3DSegments(std::list<float4>& segments, const bool collin)
+        L3DSegments(std::list<float4>& segments, const bool collin,
+                    const int backend=L3D_DEF_BACKEND,
+                    const int num_threads=L3D_DEF_NUM_THREADS)
         {
+            L3D_TRACE_ZONE("L3DSegments");
+
             // store segments
             segments_ = new L3D::DataArray<float>(4,segments.size());
             std::list<float4>::iterator it = segments.begin();
@@ -70,17 +77,76 @@ namespace L3D
                 segments_->dataCPU(3,i)[0] = (*it).w;
             }
 
-            if(collin)
+            computeCollinearities(collin,backend,num_threads);
+        }
+
+        // external segments (span of num_segments endpoints p1x,p1y,p2x,p2y),
+        // copied once into the segment array, no detection
+        L3DSegments(const float4* segments, const unsigned int num_segments,
+                    const bool collin, const int backend=L3D_DEF_BACKEND,
+                    const int num_threads=L3D_DEF_NUM_THREADS)
+        {
+            L3D_TRACE_ZONE("L3DSegments (external)");
+
+            segments_ = new L3D::DataArray<float>(4,num_segments);
+            for(unsigned int i=0; i<num_segments; ++i)
             {
-                // compute collinearity
-                L3D::DataArray<float>* relation = new L3D::DataArray<float>(segments_->height(),segments_->height(),true);
-                segments_->upload();
-                L3D::compute_collinearity(segments_,relation,L3D_DEF_COLLINEARITY_S);
-                segments_->removeFromGPU();
+                float* dst = segments_->dataCPU(0,i);
+                dst[0] = segments[i].x;
+                dst[1] = segments[i].y;
+                dst[2] = segments[i].z;
+                dst[3] = segments[i].w;
+            }
+
+            computeCollinearities(collin,backend,num_threads);
+        }
+
+        // data access
+        unsigned int num_segments(){
+            if(segments_ != NULL)
+                return segments_->height();
+            else
+                return 0;
+        }
+        L3D::DataArray<float>* segments(){
+            return segments_;
+        }
 
-                // download
-                relation->download();
-                relation->removeFromGPU();
+        std::map<unsigned int,std::map<unsigned int,float> >* collinearities(){
+            return &segment2collinearities_;
+        }
+
+    private:
+        // collinearity between the segments
+        void computeCollinearities(const bool collin, const int backend, const int num_threads)
+        {
+            if(collin && segments_->height() > L3D_DENSE_COLLINEARITY_MAX)
+            {
+                // many segments: no dense matrix
+                L3D::compute_collinearity_cpu_indexed(segments_,L3D_DEF_COLLINEARITY_S,
+                                                      num_threads,segment2collinearities_);
+            }
+            else if(collin)
+            {
+                // compute collinearity
+                L3D::DataArray<float>* relation;
+                if(backend == L3D_BACKEND_CPU)
+                {
+                    relation = new L3D::DataArray<float>(segments_->height(),segments_->height());
+                    L3D::compute_collinearity_cpu(segments_,relation,L3D_DEF_COLLINEARITY_S,
+                                                  num_threads);
+                }
+                else
+                {
+                    relation = new L3D::DataArray<float>(segments_->height(),segments_->height(),true);
+                    segments_->upload();
+                    L3D::compute_collinearity(segments_,relation,L3D_DEF_COLLINEARITY_S);
+                    segments_->removeFromGPU();
+
+                    // download
+                    relation->download();
+                    relation->removeFromGPU();
+                }
 
                 for(unsigned int i=0; i<relation->width()-1; ++i)
                 {
@@ -101,32 +167,78 @@ namespace L3D
             }
         }
 
-        // data access
-        unsigned int num_segments(){
-            if(segments_ != NULL)
-                return segments_->height();
-            else
-                return 0;
+        // segment data
+        L3D::DataArray<float>* segments_;
+        std::map<unsigned int,std::map<unsigned int,float> > segment2collinearities_;
+
+        // serialization
+        friend class boost::serialization::access;
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version)
+        {
+            ar & boost::serialization::make_nvp("segment2collinearities_", segment2collinearities_);
+            ar & boost::serialization::make_nvp("segments_", segments_);
         }
-        L3D::DataArray<float>* segments(){
-            return segments_;
+    };
+
+    // raw LSD detections of one image (original image coordinates, before
+    // merging, length filtering and the segment cap) and the size of the
+    // scaled image they were detected in
+    class L3DDetections
+    {
+    public:
+        L3DDetections() : width_(0), height_(0){
+            segments_ = NULL;
+        }
+        ~L3DDetections(){
+            delete segments_;
         }
 
-        std::map<unsigned int,std::map<unsigned int,float> >* collinearities(){
-            return &segment2collinearities_;
+        L3DDetections(const std::vector<float4>& detections,
+                      const unsigned int width, const unsigned int height) :
+            width_(width), height_(height)
+        {
+            segments_ = new L3D::DataArray<float>(4,detections.size());
+            for(unsigned int i=0; i<detections.size(); ++i)
+            {
+                segments_->dataCPU(0,i)[0] = detections[i].x;
+                segments_->dataCPU(1,i)[0] = detections[i].y;
+                segments_->dataCPU(2,i)[0] = detections[i].z;
+                segments_->dataCPU(3,i)[0] = detections[i].w;
+            }
+        }
+
+        // data access
+        unsigned int width(){return width_;}
+        unsigned int height(){return height_;}
+
+        void detections(std::vector<float4>& detections)
+        {
+            detections.clear();
+            if(segments_ == NULL)
+                return;
+
+            for(unsigned int i=0; i<segments_->height(); ++i)
+            {
+                detections.push_back(make_float4(segments_->dataCPU(0,i)[0],
+                                                 segments_->dataCPU(1,i)[0],
+                                                 segments_->dataCPU(2,i)[0],
+                                                 segments_->dataCPU(3,i)[0]));
+            }
         }
 
     private:
-        // segment data
+        unsigned int width_;
+        unsigned int height_;
         L3D::DataArray<float>* segments_;
-        std::map<unsigned int,std::map<unsigned int,float> > segment2collinearities_;
 
         // serialization
         friend class boost::serialization::access;
         template<class Archive>
         void serialize(Archive & ar, const unsigned int version)
         {
-            ar & boost::serialization::make_nvp("segment2collinearities_", segment2collinearities_);
+            ar & boost::serialization::make_nvp("width_", width_);
+            ar & boost::serialization::make_nvp("height_", height_);
             ar & boost::serialization::make_nvp("segments_", segments_);
         }
     };
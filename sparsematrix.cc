@@ -5,7 +5,8 @@ namespace L3D
     //------------------------------------------------------------------------------
     SparseMatrix::SparseMatrix(std::list<float4>& entries, const unsigned int num_rows_cols,
                                const float normalization_factor,
-                               const bool sort_by_row, const bool already_sorted)
+                               const bool sort_by_row, const bool already_sorted,
+                               const bool use_GPU)
     {
         // init
         entries_ = NULL;
@@ -55,14 +56,18 @@ namespace L3D
         }
 
         // copy to GPU
-        entries_->upload();
-        start_indices_->upload();
+        if(use_GPU)
+        {
+            entries_->upload();
+            start_indices_->upload();
+        }
     }
 
     //------------------------------------------------------------------------------
     SparseMatrix::SparseMatrix(std::list<L3D::CLEdge>& entries, const unsigned int num_rows_cols,
                                const float normalization_factor,
-                               const bool sort_by_row, const bool already_sorted)
+                               const bool sort_by_row, const bool already_sorted,
+                               const bool use_GPU)
     {
         // init
         entries_ = NULL;
@@ -112,12 +117,16 @@ namespace L3D
         }
 
         // copy to GPU
-        entries_->upload();
-        start_indices_->upload();
+        if(use_GPU)
+        {
+            entries_->upload();
+            start_indices_->upload();
+        }
     }
 
     //------------------------------------------------------------------------------
-    SparseMatrix::SparseMatrix(SparseMatrix* M, const bool change_sorting)
+    SparseMatrix::SparseMatrix(SparseMatrix* M, const bool change_sorting,
+                               const bool use_GPU)
     {
         // init
         entries_ = NULL;
@@ -186,8 +195,11 @@ namespace L3D
         }
 
         // copy to GPU
-        entries_->upload();
-        start_indices_->upload();
+        if(use_GPU)
+        {
+            entries_->upload();
+            start_indices_->upload();
+        }
     }
 
     //------------------------------------------------------------------------------
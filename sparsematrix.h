@@ -26,7 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 /**
  * Line3D - Sparsematrix
  * ====================
- * Sparse GPU matrix.
+ * Sparse GPU matrix (optionally CPU only).
  * ====================
  * Author: M.Hofer, 2015
  */
@@ -84,6 +84,22 @@ static bool sortMatchingPairsByConf(const L3DMatchingPair mp1,
     return (mp1.confidence_ > mp2.confidence_);
 }
 
+// same as above, ties broken by the target segment (total order)
+static bool sortMatchingPairsByConfDet(const L3DMatchingPair mp1,
+                                       const L3DMatchingPair mp2)
+{
+    if(mp1.confidence_ > mp2.confidence_)
+        return true;
+    else if(mp1.confidence_ == mp2.confidence_ && mp1.camID2_ < mp2.camID2_)
+        return true;
+    else if(mp1.confidence_ == mp2.confidence_ && mp1.camID2_ == mp2.camID2_ && mp1.segID2_ < mp2.segID2_)
+        return true;
+    else if(mp1.confidence_ == mp2.confidence_ && mp1.camID2_ == mp2.camID2_ && mp1.segID2_ == mp2.segID2_ && mp1.segID1_ < mp2.segID1_)
+        return true;
+    else
+        return false;
+}
+
 // sort entries for sparse affinity matrix
 static bool sortAffEntriesByCol(const float4 a1, const float4 a2)
 {
@@ -127,11 +143,14 @@ struct L3DBestMatch
     public:
         SparseMatrix(std::list<float4>& entries, const unsigned int num_rows_cols,
                      const float normalization_factor=1.0f,
-                     const bool sort_by_row=false, const bool already_sorted=false);
+                     const bool sort_by_row=false, const bool already_sorted=false,
+                     const bool use_GPU=true);
         SparseMatrix(std::list<L3D::CLEdge>& entries, const unsigned int num_rows_cols,
                      const float normalization_factor=1.0f,
-                     const bool sort_by_row=false, const bool already_sorted=false);
-        SparseMatrix(SparseMatrix* M, const bool change_sorting=false);
+                     const bool sort_by_row=false, const bool already_sorted=false,
+                     const bool use_GPU=true);
+        SparseMatrix(SparseMatrix* M, const bool change_sorting=false,
+                     const bool use_GPU=true);
         ~SparseMatrix();
 
         // check element sorting
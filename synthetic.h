@@ -0,0 +1,334 @@
+#ifndef I3D_LINE3D_SYNTHETIC_H_
+#define I3D_LINE3D_SYNTHETIC_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// std
+#include <vector>
+#include <list>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+// external
+#include "opencv/cv.h"
+#include "eigen3/Eigen/Eigen"
+
+// internal
+#include "helper_math.h"
+#include "commons.h"
+
+/**
+ * Line3D - Synthetic Scenes
+ * ====================
+ * Generates a simple "city block" scene (boxes on
+ * a ground plane) observed by cameras on a circle.
+ * The box edges are rendered into the images,
+ * worldpoints are sampled on the box surfaces.
+ * Deterministic for a given seed, the image
+ * noise has its own random numbers (the scene
+ * does not depend on the render flag).
+ * ====================
+ */
+
+namespace L3D
+{
+    // synthetic view (input for Line3D::addImage)
+    struct L3DSyntheticView
+    {
+        unsigned int id_;
+        cv::Mat image_;
+        Eigen::Matrix3d K_;
+        Eigen::Matrix3d R_;
+        Eigen::Vector3d t_;
+        std::list<unsigned int> worldpoints_;
+    };
+
+    class L3DSyntheticScene
+    {
+    public:
+        L3DSyntheticScene(const unsigned int num_views, const unsigned int num_boxes,
+                          const unsigned int width, const unsigned int height,
+                          const unsigned int seed=42, const bool render=true)
+        {
+            seed_ = seed;
+            noise_seed_ = seed^0x9e3779b9u;
+
+            generateBoxes(num_boxes);
+            generateViews(num_views,width,height,render);
+        }
+
+        // data access
+        std::vector<L3D::L3DSyntheticView>* views(){
+            return &views_;
+        }
+        std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> >* lines(){
+            return &lines_;
+        }
+        std::vector<Eigen::Vector3d>* worldpoints(){
+            return &worldpoints_;
+        }
+        unsigned int width(){return width_;}
+        unsigned int height(){return height_;}
+
+        // projected 3D lines of a view which are completely inside the image
+        // (input for Line3D::addImageSegments, no detection)
+        void segments(const unsigned int v, std::vector<float4>& segments)
+        {
+            segments.clear();
+            if(v >= views_.size())
+                return;
+
+            L3D::L3DSyntheticView& view = views_[v];
+            for(unsigned int l=0; l<lines_.size(); ++l)
+            {
+                Eigen::Vector3d p1 = view.K_*(view.R_*lines_[l].first+view.t_);
+                Eigen::Vector3d p2 = view.K_*(view.R_*lines_[l].second+view.t_);
+
+                if(p1.z() < 0.1 || p2.z() < 0.1)
+                    continue;
+
+                float4 seg = make_float4(p1.x()/p1.z(),p1.y()/p1.z(),
+                                         p2.x()/p2.z(),p2.y()/p2.z());
+
+                if(seg.x >= 0.0f && seg.y >= 0.0f && seg.x < float(width_) && seg.y < float(height_) &&
+                        seg.z >= 0.0f && seg.w >= 0.0f && seg.z < float(width_) && seg.w < float(height_))
+                {
+                    segments.push_back(seg);
+                }
+            }
+        }
+
+        // reproducible random numbers in [a,b] (rand_r state)
+        static double uniform(unsigned int& seed, const double a, const double b)
+        {
+            return a+(b-a)*double(rand_r(&seed))/double(RAND_MAX);
+        }
+
+        // evaluation (benchmarks): point to 3D segment distance
+        static double distancePointSegment3D(const Eigen::Vector3d& P,
+                                             const std::pair<Eigen::Vector3d,Eigen::Vector3d>& seg)
+        {
+            Eigen::Vector3d d = seg.second-seg.first;
+            double len2 = d.squaredNorm();
+            if(len2 < L3D_EPS)
+                return (P-seg.first).norm();
+
+            double t = std::max(0.0,std::min(1.0,(P-seg.first).dot(d)/len2));
+            return (P-(seg.first+t*d)).norm();
+        }
+
+        // evaluation (benchmarks): fraction of ground truth lines which are covered
+        // by the result (a line counts if most of its samples are close to a 3D segment)
+        static float lineRecall(std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> >& gt,
+                                std::list<L3D::L3DFinalLine3D>& lines, const double tolerance)
+        {
+            if(gt.size() == 0)
+                return 1.0f;
+
+            std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> > segs;
+            std::list<L3D::L3DFinalLine3D>::iterator it = lines.begin();
+            for(; it!=lines.end(); ++it)
+            {
+                std::list<std::pair<Eigen::Vector3d,Eigen::Vector3d> >::iterator s = it->segments3D()->begin();
+                for(; s!=it->segments3D()->end(); ++s)
+                    segs.push_back(*s);
+            }
+
+            const unsigned int samples = 10;
+            unsigned int recalled = 0;
+            for(unsigned int i=0; i<gt.size(); ++i)
+            {
+                unsigned int close = 0;
+                for(unsigned int k=0; k<samples; ++k)
+                {
+                    Eigen::Vector3d P = gt[i].first+(double(k)+0.5)/double(samples)*(gt[i].second-gt[i].first);
+                    for(unsigned int j=0; j<segs.size(); ++j)
+                    {
+                        if(distancePointSegment3D(P,segs[j]) < tolerance)
+                        {
+                            ++close;
+                            break;
+                        }
+                    }
+                }
+
+                if(close >= samples*8/10)
+                    ++recalled;
+            }
+            return float(recalled)/float(gt.size());
+        }
+
+    private:
+        // scene random numbers in [a,b]
+        double uniform(const double a, const double b)
+        {
+            return uniform(seed_,a,b);
+        }
+
+        // pixel noise in [a,b] (separate sequence)
+        double noise(const double a, const double b)
+        {
+            return uniform(noise_seed_,a,b);
+        }
+
+        // boxes --> 3D lines (edges) and worldpoints (faces)
+        void generateBoxes(const unsigned int num_boxes)
+        {
+            for(unsigned int b=0; b<num_boxes; ++b)
+            {
+                Eigen::Vector3d C(uniform(-10.0,10.0),uniform(-10.0,10.0),0.0);
+                Eigen::Vector3d S(uniform(1.0,4.0),uniform(1.0,4.0),uniform(2.0,8.0));
+
+                // corners
+                Eigen::Vector3d X[8];
+                for(unsigned int i=0; i<8; ++i)
+                {
+                    X[i] = C+Eigen::Vector3d((i & 1) ? 0.5*S.x() : -0.5*S.x(),
+                                             (i & 2) ? 0.5*S.y() : -0.5*S.y(),
+                                             (i & 4) ? S.z() : 0.0);
+                }
+
+                // edges
+                for(unsigned int i=0; i<8; ++i)
+                {
+                    for(unsigned int k=0; k<3; ++k)
+                    {
+                        unsigned int j = i | (1 << k);
+                        if(j != i)
+                            lines_.push_back(std::pair<Eigen::Vector3d,Eigen::Vector3d>(X[i],X[j]));
+                    }
+                }
+
+                // worldpoints on the faces
+                for(unsigned int i=0; i<40; ++i)
+                {
+                    double u = uniform(-0.5,0.5);
+                    double v = uniform(0.0,1.0);
+                    unsigned int face = rand_r(&seed_)%4;
+
+                    Eigen::Vector3d P = C;
+                    if(face == 0)
+                        P += Eigen::Vector3d(0.5*S.x(),u*S.y(),0.0);
+                    else if(face == 1)
+                        P += Eigen::Vector3d(-0.5*S.x(),u*S.y(),0.0);
+                    else if(face == 2)
+                        P += Eigen::Vector3d(u*S.x(),0.5*S.y(),0.0);
+                    else
+                        P += Eigen::Vector3d(u*S.x(),-0.5*S.y(),0.0);
+
+                    P.z() = v*S.z();
+                    worldpoints_.push_back(P);
+                }
+            }
+        }
+
+        // cameras on a circle around the scene
+        void generateViews(const unsigned int num_views,
+                           const unsigned int width, const unsigned int height,
+                           const bool render)
+        {
+            width_ = width;
+            height_ = height;
+
+            Eigen::Matrix3d K = Eigen::Matrix3d::Identity();
+            K(0,0) = 0.8*double(width);
+            K(1,1) = 0.8*double(width);
+            K(0,2) = 0.5*double(width);
+            K(1,2) = 0.5*double(height);
+
+            for(unsigned int i=0; i<num_views; ++i)
+            {
+                double alpha = 2.0*M_PI*double(i)/double(num_views);
+                Eigen::Vector3d C(30.0*cos(alpha),30.0*sin(alpha),uniform(6.0,12.0));
+                Eigen::Vector3d target(uniform(-1.0,1.0),uniform(-1.0,1.0),2.0);
+
+                // look-at (x: right, y: down, z: viewing direction)
+                Eigen::Vector3d z = (target-C).normalized();
+                Eigen::Vector3d x = z.cross(Eigen::Vector3d(0,0,1)).normalized();
+                Eigen::Vector3d y = z.cross(x);
+
+                Eigen::Matrix3d R;
+                R.row(0) = x.transpose();
+                R.row(1) = y.transpose();
+                R.row(2) = z.transpose();
+
+                L3D::L3DSyntheticView view;
+                view.id_ = i;
+                view.K_ = K;
+                view.R_ = R;
+                view.t_ = -R*C;
+
+                // render
+                if(render)
+                {
+                    view.image_ = cv::Mat(height,width,CV_8UC1,cv::Scalar(200));
+                    for(unsigned int l=0; l<lines_.size(); ++l)
+                    {
+                        Eigen::Vector3d p1 = K*(R*lines_[l].first+view.t_);
+                        Eigen::Vector3d p2 = K*(R*lines_[l].second+view.t_);
+
+                        if(p1.z() < 0.1 || p2.z() < 0.1)
+                            continue;
+
+                        cv::line(view.image_,cv::Point(p1.x()/p1.z(),p1.y()/p1.z()),
+                                 cv::Point(p2.x()/p2.z(),p2.y()/p2.z()),
+                                 cv::Scalar(40),2,CV_AA);
+                    }
+
+                    // pixel noise
+                    for(int r=0; r<view.image_.rows; ++r)
+                    {
+                        for(int c=0; c<view.image_.cols; ++c)
+                        {
+                            int val = int(view.image_.at<unsigned char>(r,c))+int(noise(-6.0,6.0));
+                            view.image_.at<unsigned char>(r,c) = std::max(0,std::min(255,val));
+                        }
+                    }
+                }
+
+                // visible worldpoints
+                for(unsigned int w=0; w<worldpoints_.size(); ++w)
+                {
+                    Eigen::Vector3d p = K*(R*worldpoints_[w]+view.t_);
+
+                    if(p.z() < 0.1)
+                        continue;
+
+                    double px = p.x()/p.z();
+                    double py = p.y()/p.z();
+                    if(px >= 0.0 && py >= 0.0 && px < double(width) && py < double(height))
+                        view.worldpoints_.push_back(w);
+                }
+
+                views_.push_back(view);
+            }
+        }
+
+        unsigned int seed_;
+        unsigned int noise_seed_;
+        unsigned int width_;
+        unsigned int height_;
+        std::vector<L3D::L3DSyntheticView> views_;
+        std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> > lines_;
+        std::vector<Eigen::Vector3d> worldpoints_;
+    };
+}
+
+#endif //I3D_LINE3D_SYNTHETIC_H_
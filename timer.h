@@ -0,0 +1,111 @@
+#ifndef I3D_LINE3D_TIMER_H_
+#define I3D_LINE3D_TIMER_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// std
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+/**
+ * Line3D - Timer
+ * ====================
+ * Simple monotonic wall clock timer and the
+ * load balance of parallel phases (busy time
+ * per thread).
+ * ====================
+ */
+
+namespace L3D
+{
+    class L3DTimer
+    {
+    public:
+        L3DTimer()
+        {
+            start();
+        }
+
+        // (re)start
+        void start()
+        {
+            clock_gettime(CLOCK_MONOTONIC,&start_);
+        }
+
+        // elapsed time since start
+        double elapsedNS()
+        {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC,&now);
+            return double(now.tv_sec-start_.tv_sec)*1e9+
+                    double(now.tv_nsec-start_.tv_nsec);
+        }
+
+        double elapsedMS(){return elapsedNS()*1e-6;}
+        double elapsedS(){return elapsedNS()*1e-9;}
+
+    private:
+        timespec start_;
+    };
+
+    // load balance: busy time [ms] of the busiest and of the average
+    // thread, summed over parallel phases
+    struct L3DLoadBalance
+    {
+        L3DLoadBalance(){
+            reset();
+        }
+
+        void reset(){
+            num_tasks_ = 0;
+            busy_max_ms_ = 0.0;
+            busy_mean_ms_ = 0.0;
+        }
+
+        // one parallel phase (busy time per thread)
+        void add(const std::vector<double>& busy_ms, const unsigned int num_tasks){
+            if(busy_ms.size() == 0)
+                return;
+
+            double sum = 0.0;
+            double max = 0.0;
+            for(unsigned int i=0; i<busy_ms.size(); ++i)
+            {
+                sum += busy_ms[i];
+                max = std::max(max,busy_ms[i]);
+            }
+
+            num_tasks_ += num_tasks;
+            busy_max_ms_ += max;
+            busy_mean_ms_ += sum/double(busy_ms.size());
+        }
+
+        // fraction of the parallel time the threads are idle (0 = balanced)
+        double imbalance() const {
+            return (busy_max_ms_ > 0.0) ? 1.0-busy_mean_ms_/busy_max_ms_ : 0.0;
+        }
+
+        unsigned int num_tasks_;
+        double busy_max_ms_;
+        double busy_mean_ms_;
+    };
+}
+
+#endif //I3D_LINE3D_TIMER_H_
@@ -0,0 +1,212 @@
+#ifndef I3D_LINE3D_TRACING_H_
+#define I3D_LINE3D_TRACING_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Line3D - Tracing
+ * ====================
+ * Scoped trace zones, removed at compile time
+ * unless L3D_ENABLE_TRACING is defined.
+ * Each thread writes into its own ring buffer
+ * (no locks while recording, oldest events are
+ * overwritten). L3D_TRACE_ZONE covers the enclosing
+ * scope, L3D_TRACE_BEGIN/END an explicit span.
+ * L3D_TRACE_DUMP writes all events
+ * as Chrome trace JSON (chrome://tracing, Perfetto).
+ * Dump only when no zones are open!
+ * ====================
+ */
+
+#ifdef L3D_ENABLE_TRACING
+
+// std
+#include <time.h>
+#include <pthread.h>
+#include <vector>
+#include <string>
+#include <fstream>
+
+// events per thread (power of two)
+#define L3D_TRACE_BUFFER_SIZE 65536
+
+#define L3D_TRACE_CONCAT_(a,b) a##b
+#define L3D_TRACE_CONCAT(a,b) L3D_TRACE_CONCAT_(a,b)
+#define L3D_TRACE_ZONE(name) L3D::L3DTraceZone L3D_TRACE_CONCAT(l3d_trace_zone_,__LINE__)(name)
+#define L3D_TRACE_BEGIN(id) unsigned long long l3d_trace_##id = L3D::L3DTracer::start()
+#define L3D_TRACE_END(id,name) L3D::L3DTracer::record(name,l3d_trace_##id,L3D::L3DTracer::now())
+#define L3D_TRACE_DUMP(filename) L3D::L3DTracer::dump(filename)
+
+namespace L3D
+{
+    // single trace event (complete event, name has to be a literal)
+    struct L3DTraceEvent
+    {
+        const char* name_;
+        unsigned long long start_;
+        unsigned long long duration_;
+    };
+
+    // ring buffer (single writer: the owning thread)
+    struct L3DTraceBuffer
+    {
+        unsigned int tid_;
+        volatile unsigned long long count_;
+        L3DTraceEvent events_[L3D_TRACE_BUFFER_SIZE];
+    };
+
+    class L3DTracer
+    {
+    public:
+        // current time [ns]
+        static unsigned long long now()
+        {
+            timespec t;
+            clock_gettime(CLOCK_MONOTONIC,&t);
+            return (unsigned long long)(t.tv_sec)*1000000000ULL+
+                    (unsigned long long)(t.tv_nsec);
+        }
+
+        // start of a zone/span
+        static unsigned long long start()
+        {
+            epoch();
+            return now();
+        }
+
+        // buffer of the calling thread (registered on first use)
+        static L3DTraceBuffer* buffer()
+        {
+            static __thread L3DTraceBuffer* local = NULL;
+            if(local == NULL)
+            {
+                local = new L3DTraceBuffer();
+                local->count_ = 0;
+
+                pthread_mutex_lock(mutex());
+                local->tid_ = buffers()->size();
+                buffers()->push_back(local);
+                pthread_mutex_unlock(mutex());
+            }
+            return local;
+        }
+
+        // stores an event
+        static void record(const char* name, const unsigned long long start,
+                           const unsigned long long end)
+        {
+            L3DTraceBuffer* b = buffer();
+            L3DTraceEvent& e = b->events_[b->count_ & (L3D_TRACE_BUFFER_SIZE-1)];
+            e.name_ = name;
+            e.start_ = start;
+            e.duration_ = end-start;
+            ++b->count_;
+        }
+
+        // writes all buffered events as Chrome trace JSON
+        static bool dump(const std::string filename)
+        {
+            std::ofstream file(filename.c_str());
+            if(!file.is_open())
+                return false;
+
+            pthread_mutex_lock(mutex());
+            unsigned long long t0 = epoch();
+
+            file << "{\"traceEvents\":[" << std::endl;
+            bool first = true;
+            for(unsigned int i=0; i<buffers()->size(); ++i)
+            {
+                L3DTraceBuffer* b = buffers()->at(i);
+
+                // thread name
+                if(!first) file << "," << std::endl;
+                first = false;
+                file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << b->tid_;
+                file << ",\"args\":{\"name\":\"L3D thread " << b->tid_ << "\"}}";
+
+                unsigned long long count = b->count_;
+                unsigned long long start = (count > L3D_TRACE_BUFFER_SIZE) ? count-L3D_TRACE_BUFFER_SIZE : 0;
+                for(unsigned long long k=start; k<count; ++k)
+                {
+                    L3DTraceEvent& e = b->events_[k & (L3D_TRACE_BUFFER_SIZE-1)];
+                    file << "," << std::endl;
+                    file << "{\"name\":\"" << e.name_ << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << b->tid_;
+                    file << ",\"ts\":" << double(e.start_-t0)*1e-3;
+                    file << ",\"dur\":" << double(e.duration_)*1e-3 << "}";
+                }
+            }
+            file << std::endl << "]}" << std::endl;
+            pthread_mutex_unlock(mutex());
+
+            file.close();
+            return true;
+        }
+
+    private:
+        static std::vector<L3DTraceBuffer*>* buffers()
+        {
+            static std::vector<L3DTraceBuffer*> b;
+            return &b;
+        }
+
+        static pthread_mutex_t* mutex()
+        {
+            static pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+            return &m;
+        }
+
+        // time of the first traced event (t=0 in the trace)
+        static unsigned long long epoch()
+        {
+            static unsigned long long t0 = now();
+            return t0;
+        }
+    };
+
+    // scoped zone
+    class L3DTraceZone
+    {
+    public:
+        L3DTraceZone(const char* name) : name_(name)
+        {
+            start_ = L3DTracer::start();
+        }
+
+        ~L3DTraceZone()
+        {
+            L3DTracer::record(name_,start_,L3DTracer::now());
+        }
+
+    private:
+        const char* name_;
+        unsigned long long start_;
+    };
+}
+
+#else
+
+#define L3D_TRACE_ZONE(name)
+#define L3D_TRACE_BEGIN(id)
+#define L3D_TRACE_END(id,name)
+#define L3D_TRACE_DUMP(filename)
+
+#endif //L3D_ENABLE_TRACING
+
+#endif //I3D_LINE3D_TRACING_H_
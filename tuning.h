@@ -0,0 +1,151 @@
+#ifndef I3D_LINE3D_TUNING_H_
+#define I3D_LINE3D_TUNING_H_
+
+/*
+Line3D - Line-based Multi View Stereo
+Copyright (C) 2015  Manuel Hofer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// std
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+#include <fstream>
+#include <iostream>
+
+// external
+#include "boost/filesystem.hpp"
+#include "boost/archive/archive_exception.hpp"
+#include "boost/serialization/serialization.hpp"
+#include "boost/serialization/string.hpp"
+
+// internal
+#include "commons.h"
+#include "serialization.h"
+#include "cpuwrapper.h"
+
+/**
+ * Line3D - Tuning Profile
+ * ====================
+ * Kernel parameters of the CPU backend (threads,
+ * tasks per thread, epipolar index threshold) and
+ * the measured matching throughput of one host.
+ * Written by Line3D::autoTune(), loaded by every
+ * later Line3D object on the same host. Without
+ * a profile the compile-time defaults are used.
+ * ====================
+ */
+
+// profile location: $HOME/.line3D/tuning_<host>.bin
+#define L3D_TUNING_DIRECTORY ".line3D"
+
+namespace L3D
+{
+    class L3DTuningProfile
+    {
+    public:
+        L3DTuningProfile(){
+            reset();
+        }
+
+        // compile-time defaults
+        void reset(){
+            valid_ = false;
+            host_ = "";
+            num_threads_ = L3D_DEF_NUM_THREADS;
+            tasks_per_thread_ = L3D_TASKS_PER_THREAD;
+            index_min_segments_ = L3D_INDEX_MIN_SEGMENTS;
+            pair_tests_per_s_ = 0.0;
+        }
+
+        // name of this host
+        static std::string hostname(){
+            char name[256];
+            if(gethostname(name,sizeof(name)) != 0)
+                return "localhost";
+
+            name[sizeof(name)-1] = '\0';
+            return std::string(name);
+        }
+
+        // profile file of this host (fallback: directory, if $HOME is not set)
+        static std::string defaultFile(const std::string fallback_directory){
+            std::string dir = fallback_directory;
+            const char* home = getenv("HOME");
+            if(home != NULL)
+                dir = std::string(home)+"/"+L3D_TUNING_DIRECTORY;
+
+            return dir+"/tuning_"+hostname()+".bin";
+        }
+
+        // load (false: no profile, one of another host, or a corrupt one)
+        bool load(const std::string file){
+            reset();
+            if(!boost::filesystem::exists(boost::filesystem::path(file)))
+                return false;
+
+            try
+            {
+                L3D::serializeFromFile(file,*this);
+            }
+            catch(boost::archive::archive_exception& e)
+            {
+                std::cerr << "[L3D] WARNING: unreadable tuning profile '" << file << "' (" << e.what() << "), using defaults" << std::endl;
+                reset();
+                return false;
+            }
+
+            if(host_ != hostname())
+            {
+                reset();
+                return false;
+            }
+            return valid_;
+        }
+
+        // save (creates the directory)
+        void save(const std::string file){
+            boost::filesystem::path path(file);
+            if(path.has_parent_path())
+                boost::filesystem::create_directories(path.parent_path());
+
+            L3D::serializeToFile(file,*this);
+        }
+
+        bool valid_;
+        std::string host_;
+        int num_threads_;
+        unsigned int tasks_per_thread_;
+        int index_min_segments_;
+        double pair_tests_per_s_;
+
+    private:
+        // serialization
+        friend class boost::serialization::access;
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version)
+        {
+            ar & boost::serialization::make_nvp("valid_", valid_);
+            ar & boost::serialization::make_nvp("host_", host_);
+            ar & boost::serialization::make_nvp("num_threads_", num_threads_);
+            ar & boost::serialization::make_nvp("tasks_per_thread_", tasks_per_thread_);
+            ar & boost::serialization::make_nvp("index_min_segments_", index_min_segments_);
+            ar & boost::serialization::make_nvp("pair_tests_per_s_", pair_tests_per_s_);
+        }
+    };
+}
+
+#endif //I3D_LINE3D_TUNING_H_
@@ -46,6 +46,7 @@ namespace L3D
         raw_matches_file_ = matchFilename+"_raw.bin";
         final_matches_file_ = matchFilename+"_final.bin";
         prefix_ = prefix;
+        prefetcher_ = NULL;
 
         // remove raw matches (if they exist)
         boost::filesystem::wpath file(raw_matches_file_);
@@ -147,15 +148,34 @@ namespace L3D
     }
 
     //------------------------------------------------------------------------------
-    void L3DView::loadExistingMatches(std::list<L3D::L3DMatchingPair>& matches)
+    bool L3DView::readRawMatches(std::list<L3D::L3DMatchingPair>& matches)
     {
+        if(prefetcher_ != NULL)
+            return prefetcher_->load(raw_matches_file_,matches);
+
         boost::filesystem::wpath file(raw_matches_file_);
-        if(boost::filesystem::exists(file))
-        {
-            std::list<L3D::L3DMatchingPair> M;
-            L3D::serializeFromFile(raw_matches_file_,M);
+        if(!boost::filesystem::exists(file))
+            return false;
+
+        L3D::serializeFromFile(raw_matches_file_,matches);
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    void L3DView::writeRawMatches(const std::list<L3D::L3DMatchingPair>& matches)
+    {
+        if(prefetcher_ != NULL)
+            prefetcher_->invalidate(raw_matches_file_);
+
+        L3D::serializeToFile(raw_matches_file_,matches);
+    }
+
+    //------------------------------------------------------------------------------
+    void L3DView::loadExistingMatches(std::list<L3D::L3DMatchingPair>& matches)
+    {
+        std::list<L3D::L3DMatchingPair> M;
+        if(readRawMatches(M))
             matches.splice(matches.end(), M);
-        }
     }
 
     //------------------------------------------------------------------------------
@@ -182,17 +202,15 @@ namespace L3D
             }
         }
 
-        boost::filesystem::wpath file(raw_matches_file_);
-        if(boost::filesystem::exists(file) && !remove_old)
+        std::list<L3D::L3DMatchingPair> M;
+        if(!remove_old && readRawMatches(M))
         {
-            std::list<L3D::L3DMatchingPair> M;
-            L3D::serializeFromFile(raw_matches_file_,M);
             M.insert(M.end(),matches.begin(),matches.end());
-            L3D::serializeToFile(raw_matches_file_,M);
+            writeRawMatches(M);
         }
         else
         {
-            L3D::serializeToFile(raw_matches_file_,matches);
+            writeRawMatches(matches);
         }
     }
 
@@ -200,12 +218,9 @@ namespace L3D
     void L3DView::loadAndLocalizeExistingMatches(std::list<L3D::L3DMatchingPair>& matches,
                                                  std::map<unsigned int,unsigned int>& global2local)
     {
-        boost::filesystem::wpath file(raw_matches_file_);
-        if(boost::filesystem::exists(file))
+        std::list<L3D::L3DMatchingPair> M;
+        if(readRawMatches(M))
         {
-            std::list<L3D::L3DMatchingPair> M;
-            L3D::serializeFromFile(raw_matches_file_,M);
-
             std::list<L3D::L3DMatchingPair>::iterator it = M.begin();
             for(; it!=M.end(); ++it)
             {
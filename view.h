@@ -26,6 +26,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 // internal
 #include "segments.h"
+#include "hostkernels.h"
+#include "prefetch.h"
 
 /**
  * Line3D - View
@@ -37,6 +39,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace L3D
 {
+    typedef L3D::L3DPrefetcher<std::list<L3D::L3DMatchingPair> > L3DMatchPrefetcher;
+
     class L3DView
     {
     public:
@@ -60,6 +64,10 @@ namespace L3D
         void addMatches(std::list<L3D::L3DMatchingPair>& matches, bool remove_old=false,
                         bool only_best=false);
 
+        // match file I/O through a prefetcher (NULL --> synchronous)
+        void setPrefetcher(L3D::L3DMatchPrefetcher* prefetcher){prefetcher_ = prefetcher;}
+        const std::string& rawMatchesFile() const {return raw_matches_file_;}
+
         // segment data access
         L3D::DataArray<float>* seg_coords();
         std::map<unsigned int,std::map<unsigned int,float> >* seg_collinearities();
@@ -94,6 +102,17 @@ namespace L3D
         float get_upper_uncertainty(const float depth);
         float get_uncertainty_sigma_squared(const float depth);
 
+        // uncertainty estimator (for the host kernels)
+        template<typename T>
+        L3D::L3DUncertaintyModel<T> uncertaintyModel()
+        {
+            L3D::L3DUncertaintyModel<T> model;
+            model.k_lower_ = T(k_lower_);
+            model.k_upper_ = T(k_upper_);
+            model.median_depth_ = T(median_depth_);
+            return model;
+        }
+
         // projective similarity
         float projective_similarity(const L3D::L3DSegment3D seg3D, const unsigned int seg2D_id,
                                     const float sigma);
@@ -118,6 +137,10 @@ namespace L3D
         // define spatial uncertainty
         void defineSpatialUncertainty();
 
+        // raw matches file
+        bool readRawMatches(std::list<L3D::L3DMatchingPair>& matches);
+        void writeRawMatches(const std::list<L3D::L3DMatchingPair>& matches);
+
         // camera data
         Eigen::Matrix3d K_;
         Eigen::Matrix3d Kinv_;
@@ -150,6 +173,7 @@ namespace L3D
         std::string raw_matches_file_;
         std::string final_matches_file_;
         std::string prefix_;
+        L3D::L3DMatchPrefetcher* prefetcher_;
     };
 }
 